@@ -0,0 +1,82 @@
+#include "ADC_Sampler.h"
+#include "SeqLock.h"
+#include "Prof.h"
+#include <avr/interrupt.h>
+
+/*
+  The ADC is auto-triggered by the Timer0 overflow that the Arduino core runs for millis(), that is every 1.024ms.
+  The conversion complete interrupt adds the result to the accumulator of its channel and switches the multiplexer
+  to the other channel before the next trigger arrives. After ADC_OVERSAMPLE samples the sum is decimated to
+  ADC_RES_BITS, a new 12 bit result per channel every ~33ms. Oversampling only gains resolution when there is at least
+  1 LSB of noise on the input, which the bus voltage and the vane pot both have.
+  Reading a result never blocks, analogRead() used to wait ~110us for each conversion.
+*/
+
+#define ADC_DECIMATE 2            // 16 samples of 10 bits sum to 14 bits
+
+static unsigned short ADC_Acc[ADC_NUM_CH];
+static unsigned char ADC_Cnt[ADC_NUM_CH];
+static volatile unsigned short ADC_Res[ADC_NUM_CH];
+static volatile unsigned char ADC_New[ADC_NUM_CH];   // results so far, free running
+static seq_t ADC_Seq;
+static unsigned char ADC_Ch;      // channel of the conversion in progress
+
+ISR(ADC_vect)
+{
+  unsigned char ch = ADC_Ch;
+  PROF_BEGIN( PROF_ISR_ADC );
+
+  // the next conversion is started by the next timer overflow, there is time to switch the channel
+  ADC_Ch = ( ch + 1 ) % ADC_NUM_CH;
+  ADMUX = ( ADMUX & 0xf0 ) | ( ADC_FIRST_CH + ADC_Ch );
+
+  ADC_Acc[ch] += ADC;
+  if ( ++ADC_Cnt[ch] == ADC_OVERSAMPLE )
+  {
+    ADC_Res[ch] = ( ADC_Acc[ch] + ( 1 << ( ADC_DECIMATE - 1 ))) >> ADC_DECIMATE;
+    ADC_Acc[ch] = 0;
+    ADC_Cnt[ch] = 0;
+    ADC_New[ch]++;
+    SeqWrite( &ADC_Seq );
+  }
+  PROF_END( PROF_ISR_ADC );
+}
+
+void
+ADC_Setup( void )
+{
+  unsigned char ch;
+
+  // prime the results with one plain conversion each so the first readings are not 0
+  for ( ch = 0; ch < ADC_NUM_CH; ch++ )
+    ADC_Res[ch] = analogRead( ADC_FIRST_CH + ch ) << ( ADC_RES_BITS - 10 );
+
+  ADC_Ch = 0;
+  ADMUX = ( 1 << REFS0 ) | ADC_FIRST_CH;                 // AVcc reference as analogRead() uses it
+  ADCSRB = ( 1 << ADTS2 );                              // trigger on Timer0 overflow
+  ADCSRA = ( 1 << ADEN ) | ( 1 << ADATE ) | ( 1 << ADIE ) | ( 1 << ADIF )
+         | ( 1 << ADPS2 ) | ( 1 << ADPS1 ) | ( 1 << ADPS0 );  // 125Khz ADC clock
+}
+
+// The latest result of ADC channel ch, 0 .. ADC_FULL_SCALE-1
+unsigned short
+ADC_Result( unsigned char ch )
+{
+  unsigned short v;
+  unsigned char seq;
+
+  do
+  {
+    seq = SeqBegin( &ADC_Seq );
+    v = ADC_Res[ch - ADC_FIRST_CH];
+  } while ( SeqRetry( &ADC_Seq, seq ));
+
+  return v;
+}
+
+// Counts the results of ADC channel ch, a change tells that there is a new one
+unsigned char
+ADC_Count( unsigned char ch )
+{
+  return ADC_New[ch - ADC_FIRST_CH];
+}
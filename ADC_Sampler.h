@@ -0,0 +1,32 @@
+/*
+ * File:   ADC_Sampler.h
+ * Author: Gary Stofer
+ *
+ * Free running, oversampled acquisition of the analog inputs ADC6 and ADC7.
+ * Once ADC_Setup() has run the ADC belongs to this module, analogRead() must not be used anymore.
+ */
+
+#include "Arduino.h"
+
+#ifndef ADC_SAMPLER_H
+#define	ADC_SAMPLER_H
+
+#define ADC_FIRST_CH 6          // ADC6 and ADC7 are sampled in turn
+#define ADC_NUM_CH 2
+#define ADC_OVERSAMPLE 16       // samples per result, 4^n samples give n more bits
+#define ADC_RES_BITS 12
+#define ADC_FULL_SCALE (1 << ADC_RES_BITS)
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+extern void ADC_Setup(void);
+extern unsigned short ADC_Result(unsigned char ch);
+extern unsigned char ADC_Count(unsigned char ch);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* ADC_SAMPLER_H */
@@ -5,6 +5,7 @@
 
 #include "build_opts.h"		// Controls build time features
 #include <LiquidCrystal.h>
+#include "ShadowLCD.h"
 #include <avr/wdt.h>
 #include "BMP085_baro.h"
 #include "SI_7021.h"
@@ -12,14 +13,17 @@
 #include "Atmos.h"
 #include "Wind.h"	
 #include "RPM.h"	
+#include "ADC_Sampler.h"
+#include "SeqLock.h"
+#include "Sched.h"
+#include "Prof.h"
+#include "Mem.h"
+#include "Telem.h"
 #include <EEPROM.h>
 
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  BUILD OPTIONS ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
 
-#define LCD_COLS 8
-#define LCD_ROWS 2
-
 //With a Temp-Dewpoint delta of less that 3degC (~5degF) you can expect fog, so I set the default for the alarm a bit higher than that.
 #define TD_DELTA_ALARM	4.0 // in degC when the alarm is to come on
 #define VOLT_LOW_ALARM 6.5
@@ -37,12 +41,16 @@
 #define LED2_PIN 17			// aka PC3,A3
 
 #define VBUS_ADC 7			// ADC7
-#define VBUS_ADC_BW  (5.0*(14+6.8)/(1024*6.8))		//adc bit weight for voltage divider 14.0K and 6.8k to gnd.
+#define VBUS_ADC_BW  (5.0*(14+6.8)/(ADC_FULL_SCALE*6.8))		//adc bit weight for voltage divider 14.0K and 6.8k to gnd.
 
 
-#define UPDATE_PER 1000   // in ms second, this is the measure interval and also the LCD update interval
+#define UPDATE_PER 1000   // in ms, the LCD update interval
+#define FAST_PER 100      // LCD update interval of the SCR_FAST screens
+#define INPUT_PER 10      // encoder and button poll interval
 
-#define LONGPRESS_TIMEOUT 100000 // Note: not in milli seconds since this is used in a SW while loop timer
+#define LONGPRESS_MS 500     // button held this long is a long press
+#define DOUBLEPRESS_MS 250   // a second press within this time after a short press makes it a double press
+#define BOUNCE_MS 20         // a press this soon after the release continues the previous press
 
 #define KMpMILE 0.62137119
 
@@ -63,28 +71,61 @@ enum Displays {
   Wind_SPD,
   Wind_AVG,
   Wind_GST,
-#else ifdef WITH_RPM
+  Wind_DIR2,
+  Wind_DIR10,
+#elif defined(WITH_RPM)
   RPM,
+#endif
+#ifdef WITH_PROFILE
+  Diag,           // hidden, a double press shows it
 #endif
   DISP_END        // this must be the last entry
  };
 
-// Globals for rotary encoder
-char EncoderCnt = RPM;    // Default startup display
+#ifdef WITH_WIND
+#define DISP_START Wind_SPD
+#elif defined(WITH_RPM)
+#define DISP_START RPM
+#else
+#define DISP_START V_Bus
+#endif
+
+// Globals for rotary encoder, owned by the main loop and brought up to date from the ISR counts by EncoderPoll()
+char EncoderCnt = DISP_START;    // Default startup display
 char EncoderPressedCnt = 0;
 char EncoderDirection = -1; // So that it decremets to a valid display in case the default display is not currently valid due to sensor lacking
 unsigned char ShortPressCnt = 0;
 unsigned char LongPressCnt = 0;
+unsigned char DoublePressCnt = 0;
+
+// Free running counts and button time stamps of the encoder ISRs, only read through Knob_Seq
+static volatile char KnobCnt = 0;
+static volatile char KnobPressedCnt = 0;
+static volatile char KnobDirection = -1;
+static volatile unsigned char BtnPresses = 0;
+static volatile bool BtnDown = false;
+static volatile unsigned long BtnDownT, BtnUpT;
+static seq_t Knob_Seq;
 static bool MetricDisplay = false;
 
+// what the display showed last, a change from the knob or the button updates the display right away
+static char PrevEncCnt = DISP_START;
+static unsigned char PrevShortPressCnt = 0;
+
 
-// Global LCD control class
-LiquidCrystal lcd(9, 8, 6, 7, 4, 5); // in 4 bit interface mode
+// Global LCD control class, everything is printed into the shadow copy and sent by lcd.refresh()
+static LiquidCrystal lcd_hw(9, 8, 6, 7, 4, 5); // in 4 bit interface mode
+ShadowLCD lcd(lcd_hw);
 
 static bool No_Baro = true;
 static bool No_Hygro = true;
 static bool No_TMP100 = true;
 
+// Readings of the current display update, shared by the screens
+static float Vbus_Volt;
+static float Temp_C;
+static float dewptC;
+
 
 /* Note regarding contrast control */
 // Contrast control simply using a PWM doesn't work because the PWM needs to be filtered with a R-C, but the LCD itself is pulling the LCD control
@@ -103,47 +144,631 @@ static bool No_TMP100 = true;
   is 90deg opposed.  RC filtering of the contacts is required. 
 
   Three encoder count variables are being modified by this ISR
-    1) EncoderCnt increments or decrements when the knob is turned without the button being pressed
-    2) EncoderPressCnt increments or decrements when the knob is  turned while the button is also pressed. 
-       This happens only after a LONG press timeout
-    3) EncoderDirection either +1 or -1 depending on the direction the user turned the knob last
+    1) KnobCnt increments or decrements when the knob is turned without the button being pressed
+    2) KnobPressedCnt increments or decrements when the knob is  turned while the button is also pressed. 
+    3) KnobDirection either +1 or -1 depending on the direction the user turned the knob last
+  EncoderPoll() adds the changes to EncoderCnt, EncoderPressedCnt and EncoderDirection.
 */
 void ISR_KnobTurn( void)
 {
+  char dir;
+  PROF_BEGIN( PROF_ISR_KNOB );
+
   if ( digitalRead( Enc_B_PIN ) )
-    EncoderDirection = Enc_DIRECTION;
+    dir = Enc_DIRECTION;
   else 
-    EncoderDirection = -Enc_DIRECTION;
+    dir = -Enc_DIRECTION;
      
   if ( digitalRead( Enc_PRESS_PIN ) )
-       EncoderCnt += EncoderDirection;
+       KnobCnt += dir;
   else
-       EncoderPressedCnt += EncoderDirection;
-  
+       KnobPressedCnt += dir;
+
+  KnobDirection = dir;
+  SeqWrite( &Knob_Seq );
+  PROF_END( PROF_ISR_KNOB );
 }
 
 
 /*
-  ISR to handle the button press interrupt. 
+  ISR to handle the button interrupt on both edges. 
   
-  Two modes of button presses are recognized. A short, momentary press, and a long, timing-out press.
-  While the hardware de bounced button signal is sampled for up to LONGPRESS_TIMEOUT time in this ISR no other code is being executed. If the time-out occurs
-  a long button press-, otherwise a short button press is registered. This timing has to be done by a software counter since interrupts are disabled
-  and function millis() and micros() won't work during this time. 
-  Software timing is CPU clock dependent and therefore has to be adjusted to the clock frequency. 
+  It only records the time of the press and of the release, EncoderPoll() tells the presses apart from that. The ISR
+  used to time the press by spinning in the handler, which stopped millis(), the encoder and the wind or RPM counting
+  for as long as the button was held.
+  The level is checked again since a bounce can be over by the time the handler runs. The hardware de bounces the
+  button signal, a release shorter than BOUNCE_MS is ignored in addition.
 */
 void ISR_ButtonPress(void)
 {
-  volatile unsigned long t = 0;
-  while ( !digitalRead( Enc_PRESS_PIN ))
+  unsigned long t;
+  PROF_BEGIN( PROF_ISR_BUTTON );
+
+  t = millis();
+  if ( !digitalRead( Enc_PRESS_PIN ))
+  {
+    if ( !BtnDown )
+    {
+      BtnDown = true;
+      if ( t - BtnUpT >= BOUNCE_MS )
+      {
+        BtnDownT = t;
+        BtnPresses++;
+      }
+      SeqWrite( &Knob_Seq );
+    }
+  }
+  else if ( BtnDown )
+  {
+    BtnDown = false;
+    BtnUpT = t;
+    SeqWrite( &Knob_Seq );
+  }
+  PROF_END( PROF_ISR_BUTTON );
+}
+
+
+/*
+  Classifies the button presses recorded by the ISR. 
+  A press held for LONGPRESS_MS counts as a long press as soon as the time is up, the button may still be down and the
+  knob be turned while it is held. A shorter press is a short press once DOUBLEPRESS_MS passed without a second press,
+  a second short press within that time makes a double press instead. 
+  Has to be called more often than the button can be pressed and released, every pass of the main or a setup loop.
+*/
+enum { BTN_IDLE, BTN_DOWN, BTN_UP, BTN_HELD };
+
+static void
+ButtonTick( unsigned char presses, bool down, unsigned long down_t, unsigned long up_t )
+{
+  static unsigned char state = BTN_IDLE;
+  static unsigned char presses_seen = 0;
+  static bool second = false;     // second press of a double press
+  unsigned long now = millis();
+
+  if ( presses != presses_seen )  // a new press
+  {
+    presses_seen = presses;
+    second = ( state == BTN_UP );
+    state = BTN_DOWN;
+  }
+
+  switch ( state )
+  {
+    case BTN_DOWN:
+      if ( down ? now - down_t >= LONGPRESS_MS : up_t - down_t >= LONGPRESS_MS )
+      {
+        if ( second )
+          ShortPressCnt++;        // the first press of the pair was a short one
+        LongPressCnt++;
+        state = down ? BTN_HELD : BTN_IDLE;
+      }
+      else if ( !down )
+      {
+        if ( second )
+        {
+          DoublePressCnt++;
+          state = BTN_IDLE;
+        }
+        else
+          state = BTN_UP;
+      }
+      break;
+
+    case BTN_UP:
+      if ( down )                 // bounced, still the same press
+        state = BTN_DOWN;
+      else if ( now - up_t >= DOUBLEPRESS_MS )
+      {
+        ShortPressCnt++;
+        state = BTN_IDLE;
+      }
+      break;
+
+    case BTN_HELD:
+      if ( !down )
+        state = BTN_IDLE;
+      break;
+  }
+}
+
+
+/*
+  Brings the encoder and button globals up to date with the ISR counts. The main loop is free to modify or clear the
+  globals, which used to race with the ISRs and could lose a click or a press.
+*/
+void EncoderPoll(void)
+{
+  static char knob_seen = 0, pressed_seen = 0;
+  char knob, pressed, dir;
+  unsigned char presses, seq;
+  bool down;
+  unsigned long down_t, up_t;
+
+  do
+  {
+    seq = SeqBegin( &Knob_Seq );
+    knob = KnobCnt;
+    pressed = KnobPressedCnt;
+    dir = KnobDirection;
+    presses = BtnPresses;
+    down = BtnDown;
+    down_t = BtnDownT;
+    up_t = BtnUpT;
+  } while ( SeqRetry( &Knob_Seq, seq ));
+
+  EncoderCnt += knob - knob_seen;
+  EncoderPressedCnt += pressed - pressed_seen;
+  EncoderDirection = dir;
+
+  knob_seen = knob;
+  pressed_seen = pressed;
+
+  ButtonTick( presses, down, down_t, up_t );
+}
+
+/*
+  The display screens, one entry per enum Displays and in the same order. The table lives in flash. 
+  The first line shows the label, the second line the value of get() right aligned in front of the unit, or whatever
+  show() prints for screens that aren't a single number. The decimals and the unit are given for metric and imperial
+  display, a negative decimal rounds to 10s. Decimals that don't fit in front of the unit are dropped.
+  A screen is skipped when one of the sensors in needs is missing, a SCR_HIDDEN screen is left out of the rotation
+  until something shows it. A long press calls longpress() of the screen shown, screens without one ignore the long
+  press.
+*/
+#define SENS_BARO 0x01
+#define SENS_HYGRO 0x02
+#define SENS_TEMP 0x04      // any of the temperature sources
+#define SCR_FAST 0x01       // update every FAST_PER, not only every UPDATE_PER
+#define SCR_HIDDEN 0x02     // not in the rotation of the knob
+
+struct tagScreen
+{
+  char label[LCD_COLS + 1];
+  unsigned char needs;
+  unsigned char flags;
+  signed char dec[2];               // decimals, imperial and metric
+  char unit[2][6];                  // unit, imperial and metric
+  float (*get)( unsigned char metric );
+  void (*show)( void );
+  void (*longpress)( void );
+};
+
+static unsigned long ScreenAvail;   // bit n set when screen n can be shown, set up in setup()
+
+static float GetVbus( unsigned char /* metric */ ) { return Vbus_Volt; }
+
+static float GetDensAlt( unsigned char metric )
+{
+  float m = DensityAlt( BaroReading.BaromhPa, BaroReading.TempC );
+
+  return metric ? m : MtoFeet( m );
+}
+
+static float GetAlt( unsigned char metric )
+{
+  float m = Altitude( BaroReading.BaromhPa, AltimeterSetting );
+
+  return metric ? m : MtoFeet( m );
+}
+
+static float GetPressure( unsigned char metric )
+{
+  return metric ? BaroReading.BaromhPa : hPaToInch( BaroReading.BaromhPa );
+}
+
+static float GetRelHum( unsigned char /* metric */ ) { return HygReading.RelHum; }
+static float GetTemp( unsigned char metric ) { return metric ? Temp_C : CtoF( Temp_C ); }
+static float GetDewPt( unsigned char metric ) { return metric ? dewptC : CtoF( dewptC ); }
+
+#ifdef WetBulbTemp
+static float GetWetBulb( unsigned char metric )
+{
+  float t;
+
+  if ( No_Baro )
+    t = T_wetbulb_C( Temp_C, 942.0, HygReading.RelHum ); // in the absence of a Barometer reading I take the pressure at ~2000ft in standard Atmos.  
+  else
+    t = T_wetbulb_C( Temp_C, BaroReading.BaromhPa, HygReading.RelHum );
+  return metric ? t : CtoF( t );
+}
+#endif
+
+static float GetTDSpread( unsigned char metric )
+{
+  return metric ? Temp_C - dewptC : CtoF( Temp_C ) - CtoF( dewptC );
+}
+
+// long press on the Temp screen toggles between imperial and metric display
+static void ToggleUnits( void )
+{
+  MetricDisplay = !MetricDisplay;
+  EEPROM.put( 0, MetricDisplay );
+}
+
+#ifdef WITH_WIND
+static float GetWindSpd( unsigned char metric ) { return metric ? WindSpdMPH * KMpMILE : WindSpdMPH; }
+static float GetWindAvg( unsigned char metric ) { return metric ? WindAvgMPH * KMpMILE : WindAvgMPH; }
+static float GetWindGust( unsigned char metric ) { return metric ? WindGustMPH * KMpMILE : WindGustMPH; }
+static float GetWindDir( unsigned char /* metric */ ) { return WindDir; }
+
+// mean direction and how steady it was, 100% for a constant direction
+static void ShowWindDir( short dir, unsigned char steady )
+{
+  if (dir < 0)
+  {
+    lcd.print("Calm    ");
+    return;
+  }
+  lcd.printFixed( dir, 0, 3 );
+  lcd.print(char(223)); // degree symbol
+  lcd.printFixed( steady, 0, 3 );
+  lcd.print("%");
+}
+
+static void ShowWindDir2( void ) { ShowWindDir( WindDir2, WindSteady2 ); }
+static void ShowWindDir10( void ) { ShowWindDir( WindDir10, WindSteady10 ); }
+#endif
+
+#ifdef WITH_RPM
+static float GetRPM( unsigned char /* metric */ ) { return RPM_; }
+#endif
+
+#ifdef WITH_PROFILE
+static const char ProfPage[3][4] PROGMEM = { "avg", "min", "max" };
+static const char MemPage[3][LCD_COLS + 1] PROGMEM = { "Free now", "Free min", "RAM data" };
+
+// free SRAM now, the least there was and the static data, see Mem.h
+static void ShowMem( unsigned char page )
+{
+  unsigned short v = page == 0 ? Mem_Free() : page == 1 ? Mem_MinFree() : Mem_Static();
+
+  lcd.setCursor( 0, 0 );
+  lcd.print( (const __FlashStringHelper *) MemPage[page] );
+  lcd.setCursor( 0, 1 );
+  if ( v == 0 )           // not on the target
+    lcd.print( "      --" );
+  else
   {
-    if (t++ > LONGPRESS_TIMEOUT)
+    lcd.printFixed( v, 0, 6 );
+    lcd.print( " B" );
+  }
+}
+
+// The diagnostics, one profile region or the memory at a time, name and statistic on the first line, the value on
+// the second. A short press moves on to the next region, every update shows the next of mean, min and max.
+static void ShowDiag( void )
+{
+  static unsigned char region = 0, page = 0;
+  struct tagProf p;
+  unsigned short v;
+
+  if ( ShortPressCnt != PrevShortPressCnt || LongPressCnt )
+  {
+    region = ( region + 1 ) % ( PROF_N + 1 );
+    page = 0;
+  }
+  else
+    page = ( page + 1 ) % 3;
+  if ( region == PROF_N )
+  {
+    ShowMem( page );
+    return;
+  }
+  Prof_Get( region, &p );
+
+  lcd.setCursor( 0, 0 );
+  lcd.print( (const __FlashStringHelper *) ProfName[region] );
+  lcd.print( ' ' );
+  lcd.print( (const __FlashStringHelper *) ProfPage[page] );
+  lcd.setCursor( 0, 1 );
+
+  if ( p.n == 0 )
+  {
+    lcd.print( "      --" );
+    return;
+  }
+  v = page == 0 ? ( p.sum + p.n / 2 ) / p.n : page == 1 ? p.min : p.max;
+  if ( v == PROF_SAT )
+  {
+    lcd.print( "  >30 ms" );
+    return;
+  }
+  lcd.printFixed( v * 5L, 1, 6 );   // 0.5us ticks in 0.1us
+  lcd.print( "us" );
+}
+
+// long press on the diagnostics screen
+static void DumpDiag( void )
+{
+#ifdef WITH_TELEMETRY
+  Telem_Dump();           // the serial port sends frames, the profile goes out as frames too
+#else
+  Prof_Print( Serial );
+  Serial.print( F( "RAM free\t" ));
+  Serial.print( Mem_Free() );
+  Serial.print( F( "\tmin\t" ));
+  Serial.print( Mem_MinFree() );
+  Serial.print( F( "\tdata\t" ));
+  Serial.println( Mem_Static() );
+#endif
+}
+#endif
+
+static const struct tagScreen Screens[DISP_END] PROGMEM = {
+  { "Voltage ", 0, 0, { 2, 2 }, { " V", " V" }, GetVbus, NULL, NULL },
+  { "Dens Alt", SENS_BARO, 0, { -1, 0 }, { " ft", " M" }, GetDensAlt, NULL, NULL },
+  { " Alt *  ", SENS_BARO, 0, { 0, 0 }, { " ft", " M" }, GetAlt, NULL, Alt_Setting_adjust },
+  { "Pressure", SENS_BARO, 0, { 2, 2 }, { "\"Hg", "hPa" }, GetPressure, NULL, NULL },
+  { "Humidity", SENS_HYGRO, 0, { 0, 0 }, { " % RH", " % RH" }, GetRelHum, NULL, NULL },
+  { " Temp * ", SENS_TEMP, 0, { 2, 2 }, { "\xdf" "F", "\xdf" "C" }, GetTemp, NULL, ToggleUnits },
+  { "DewPoint", SENS_HYGRO, 0, { 0, 0 }, { "\xdf" "F", "\xdf" "C" }, GetDewPt, NULL, NULL },
+#ifdef WetBulbTemp
+  { "Wet Bulb", SENS_HYGRO, 0, { 2, 2 }, { "\xdf" "F", "\xdf" "C" }, GetWetBulb, NULL, NULL },
+#endif
+  { "TDspread", SENS_HYGRO, 0, { 0, 0 }, { "\xdf" "F", "\xdf" "C" }, GetTDSpread, NULL, NULL },
+#ifdef WITH_WIND
+  { "Wnd DIR*", 0, SCR_FAST, { 0, 0 }, { " \xdf", " \xdf" }, GetWindDir, NULL, WindDirCal },
+  { "Wind SPD", 0, SCR_FAST, { 0, 2 }, { " MPH", " KMH" }, GetWindSpd, NULL, NULL },
+  { "Wind AVG", 0, 0, { 0, 2 }, { " MPH", " KMH" }, GetWindAvg, NULL, NULL },
+  { "Wind GST", 0, 0, { 0, 2 }, { " MPH", " KMH" }, GetWindGust, NULL, NULL },
+  { "DIR 2min", 0, 0, { 0, 0 }, { "", "" }, NULL, ShowWindDir2, NULL },
+  { "DIR 10mn", 0, 0, { 0, 0 }, { "", "" }, NULL, ShowWindDir10, NULL },
+#elif defined(WITH_RPM)
+  { "  RPM   ", 0, 0, { 0, 0 }, { "", "" }, GetRPM, NULL, NULL },
+#endif
+#ifdef WITH_PROFILE
+  { "", 0, SCR_HIDDEN, { 0, 0 }, { "", "" }, NULL, ShowDiag, DumpDiag },  // ShowDiag() prints both lines
+#endif
+};
+
+// Marks the screens that have all their sensors
+static void
+ScreenSetup( void )
+{
+  unsigned char have = 0;
+  unsigned char i;
+
+  if ( !No_Baro )
+    have |= SENS_BARO;
+  if ( !No_Hygro )
+    have |= SENS_HYGRO;
+  if ( !No_Baro || !No_Hygro || !No_TMP100 )
+    have |= SENS_TEMP;
+
+  ScreenAvail = 0;
+  for ( i = 0; i < DISP_END; i++ )
+    if ( ( pgm_read_byte( &Screens[i].needs ) & ~have ) == 0 && !( pgm_read_byte( &Screens[i].flags ) & SCR_HIDDEN ))
+      ScreenAvail |= 1UL << i;
+}
+
+// Wraps EncoderCnt around the ends and moves it on in the direction the knob was turned last until it lands on a
+// screen that can be shown. The Voltage screen is always there.
+static void
+ScreenSelect( void )
+{
+  do
+  {
+    if (EncoderCnt < 0 ) 
+      EncoderCnt = DISP_END-1;
+    if (EncoderCnt >= DISP_END)
+      EncoderCnt = 0;
+    if ( ScreenAvail & ( 1UL << EncoderCnt ))
+      break;
+    EncoderCnt += EncoderDirection;
+  } while ( 1 );
+}
+
+// Prints the value rounded to dec decimals, to 10s for dec -1, right aligned in width characters. Decimals that
+// don't fit are dropped. The float is turned into a scaled integer, printing a float does float math for every digit.
+static void
+PrintValue( float v, signed char dec, unsigned char width )
+{
+  float s;
+  long n;
+  signed char i;
+
+  if ( dec < 0 )
+  {
+    lcd.printFixed( (long) ( v / 10 + ( v < 0 ? -0.5 : 0.5 )) * 10, 0, width );
+    return;
+  }
+
+  for ( ;; )
+  {
+    for ( s = v, i = 0; i < dec; i++ )
+      s *= 10;
+    n = s + ( s < 0 ? -0.5 : 0.5 );
+    if ( dec == 0 || ShadowLCD::fixedLen( n, dec ) <= width )
+      break;
+    dec--;
+  }
+  lcd.printFixed( n, dec, width );
+}
+
+// Shows screen n, returns the flags of the screen
+static unsigned char
+ScreenShow( unsigned char n )
+{
+  const struct tagScreen *scr = &Screens[n];
+  void (*fn)( void );
+  float (*get)( unsigned char );
+  unsigned char metric;
+
+  if ( LongPressCnt )
+  {
+    fn = (void (*)( void )) pgm_read_word( &scr->longpress );
+    if ( fn )
     {
-      LongPressCnt++;
-      return;
+      fn();
+      lcd.home(  );
+      EncoderCnt = n;    // restore the current display item
     }
+    LongPressCnt = 0;
+  }
+
+  metric = MetricDisplay ? 1 : 0;
+  lcd.print( (const __FlashStringHelper *) scr->label );
+  lcd.setCursor ( 0, 1 );
+
+  fn = (void (*)( void )) pgm_read_word( &scr->show );
+  if ( fn )
+    fn();
+  else
+  {
+    get = (float (*)( unsigned char )) pgm_read_word( &scr->get );
+    PrintValue( get( metric ), (signed char) pgm_read_byte( &scr->dec[metric] ),
+                LCD_COLS - strlen_P( scr->unit[metric] ));
+    lcd.print( (const __FlashStringHelper *) scr->unit[metric] );
+  }
+
+  return pgm_read_byte( &scr->flags );
+}
+
+/*
+  The tasks run by the scheduler from loop(), see Sched.h. Every sensor runs its measure cycle on its own period, a
+  new cycle starts when the task is due and the last one is done. The display shows the latest readings.
+  The table order is the order the tasks run in when several are due at the same time.
+  The setup screens of a long press block the display task, the others overrun for that time.
+*/
+static unsigned short InputTask( void );
+static unsigned short DisplayTask( void );
+
+static unsigned short
+BaroTask( void )
+{
+  unsigned short ms;
+  PROF_BEGIN( PROF_BARO );
+
+  BMP085_startMeasure( );
+  ms = BMP085_Read_Process( );
+  if ( ms == SCHED_DONE && !No_Baro )
+    Telem_Baro();         // the new reading, or the impossible one of a sensor that stopped answering
+  PROF_END( PROF_BARO );
+  return ms;
+}
+
+static unsigned short
+HygroTask( void )
+{
+  unsigned short ms;
+  PROF_BEGIN( PROF_HYGRO );
+
+  SI7021_startMeasure( );
+  ms = SI7021_Read_Process( );
+  if ( ms == SCHED_DONE && !No_Hygro )
+    Telem_Hygro();
+  PROF_END( PROF_HYGRO );
+  return ms;
+}
+
+static unsigned short
+TempTask( void )
+{
+  unsigned short ms;
+  PROF_BEGIN( PROF_TEMP );
+
+  TMP100_startMeasure( );
+  ms = TMP100_Read_Process( );
+  if ( ms == SCHED_DONE && !No_TMP100 )
+    Telem_Temp();
+  PROF_END( PROF_TEMP );
+  return ms;
+}
+
+#ifdef WITH_WIND
+static unsigned short
+WindTask( void )
+{
+  PROF_BEGIN( PROF_WIND_RPM );
+
+  WindRead();
+  Telem_Wind();
+  PROF_END( PROF_WIND_RPM );
+  return SCHED_DONE;
+}
+#elif defined(WITH_RPM)
+static unsigned short
+RPMTask( void )
+{
+  PROF_BEGIN( PROF_WIND_RPM );
+
+  RPM_Read();
+  Telem_RPM();
+  PROF_END( PROF_WIND_RPM );
+  return SCHED_DONE;
+}
+#endif
+
+#ifdef WITH_TELEMETRY
+// The bus voltage as the ADC has a new result, the status every TELEM_STATUS_PER and a pending profile dump
+static unsigned short
+TelemTask( void )
+{
+  static unsigned char cnt;
+  static unsigned long status;
+
+  if ( ADC_Count( VBUS_ADC ) != cnt )
+  {
+    cnt = ADC_Count( VBUS_ADC );
+    Telem_Vbus( ADC_Result( VBUS_ADC ) * VBUS_ADC_BW );
+  }
+  if ( millis() - status >= TELEM_STATUS_PER )
+  {
+    status = millis();
+    Telem_Status();
   }
-  ShortPressCnt++;
+  Telem_Poll();
+  return SCHED_DONE;
+}
+#endif
+
+enum {
+  TASK_INPUT = 0,
+#if defined(WITH_WIND) || defined(WITH_RPM)
+  TASK_WIND_RPM,
+#endif
+  TASK_BARO,
+  TASK_HYGRO,
+  TASK_TEMP,
+#ifdef WITH_TELEMETRY
+  TASK_TELEM,
+#endif
+  TASK_DISPLAY,
+  TASK_END        // this must be the last entry
+};
+
+static struct tagTask Tasks[TASK_END] = {
+  SCHED_TASK( InputTask, INPUT_PER ),
+#ifdef WITH_WIND
+  SCHED_TASK( WindTask, WIND_SAMPLE_PER ),
+#elif defined(WITH_RPM)
+  SCHED_TASK( RPMTask, SAMPLE_PER ),
+#endif
+  SCHED_TASK( BaroTask, BMP085_PERIOD ),
+  SCHED_TASK( HygroTask, SI7021_PERIOD ),
+  SCHED_TASK( TempTask, TMP100_PERIOD ),
+#ifdef WITH_TELEMETRY
+  SCHED_TASK( TelemTask, TELEM_PER ),
+#endif
+  SCHED_TASK( DisplayTask, UPDATE_PER ),
+};
+
+static unsigned short
+InputTask( void )
+{
+  EncoderPoll();
+#ifdef WITH_PROFILE
+  if ( DoublePressCnt )           // a double press shows the diagnostics screen
+  {
+    DoublePressCnt = 0;
+    ScreenAvail |= 1UL << Diag;
+    EncoderCnt = Diag;
+  }
+#endif
+  // a long press is pending until ScreenShow() ran the setup screen of it
+  if ( EncoderCnt != PrevEncCnt || ShortPressCnt != PrevShortPressCnt || LongPressCnt )
+    SchedWake( &Tasks[TASK_DISPLAY], 0 );
+  return SCHED_DONE;
 }
 
 
@@ -152,6 +777,10 @@ void setup()
 {
   unsigned err;
 
+#ifdef WITH_PROFILE
+  Prof_Setup();
+#endif
+
   // Setup the Encoder pins to be inputs with pullups
   pinMode(Enc_A_PIN, INPUT);    // Use external 10K pullup and 100nf to gnd for debounce
   pinMode(Enc_B_PIN, INPUT);    // Use external 10K pullup and 100nf to gnd for debounce
@@ -169,25 +798,35 @@ void setup()
   digitalWrite( 19, LOW);
 
   attachInterrupt(0, ISR_KnobTurn, FALLING);    // for the rotary encoder knob rotating
-  attachInterrupt(1, ISR_ButtonPress, FALLING);    // for the rotary encoder knob push
+  attachInterrupt(1, ISR_ButtonPress, CHANGE);    // for the rotary encoder knob push and release
+
+  ADC_Setup();      // bus voltage and wind vane are sampled in the background from here on
 
 #ifdef WITH_WIND 
   WindSetup() ;
-#else ifdef WITH_RPM
+#elif defined(WITH_RPM)
   RPM_Setup();
 #endif  
 
   wdt_enable(WDTO_2S);
  
-  lcd.begin(LCD_COLS, LCD_ROWS);              // initialize the LCD columns and rows
+  lcd.begin();              // initialize the LCD columns and rows
 
   lcd.home ();                   // go home
   lcd.print("Baro-Hyg");
   lcd.setCursor ( 0, 1 );
   lcd.print("Display");
+  lcd.refresh();
 
   // Serial.begin(57600);
   // Serial.print("Baro-Hyg-Temp-Wind Display\n");
+#ifdef WITH_TELEMETRY
+  Telem_Setup();            // the readings stream out as they come in
+#elif defined(WITH_PROFILE)
+  Serial.begin(57600);      // for the profile dump
+#endif
+
+  i2c_init();     // bus default clock, the sensor inits register their own clock profiles
 
   if ( (err = BMP085_init()) != 0)
   {
@@ -196,7 +835,10 @@ void setup()
     No_Baro = true;
   }
   else
+  {
     No_Baro = false;
+    BMP085_setMode( BARO_OSS, BARO_TEMP_EVERY );
+  }
   
   if ( (err = SI7021_init()) != 0)
   {
@@ -221,16 +863,18 @@ void setup()
     }
   }
 
-#ifndef WITH_WIND ||  WITH_RPM
+  lcd.refresh();
+
+#if !defined(WITH_WIND) && !defined(WITH_RPM)
   if ( No_Baro && No_Hygro && No_TMP100)
       while (1);          // Since there is nothing to measure let the watchdog catch it and reboot, Maybe a sensor gets plugged in soon.
  #endif
- 
-  BMP085_startMeasure( );    // initiate initial measure cycle
-  SI7021_startMeasure( );    // initiate initial measure cycle
-  TMP100_startMeasure( );
 
-  EEPROM.get( 0, MetricDisplay);
+  MetricDisplay = EEPROM.read( 0 ) == 1;   // an erased EEPROM reads 0xff, which isn't a bool
+  ScreenSetup();
+
+  SchedStart( Tasks, TASK_END );      // the sensors start their first measure cycle
+  SchedWake( &Tasks[TASK_DISPLAY], UPDATE_PER );  // the boot screen stays until there are readings
   
   wdt_enable(WDTO_8S);  // set watchdog slower
   digitalWrite( LED1_PIN, LOW);   // Turn LEDs off
@@ -241,41 +885,25 @@ void setup()
 // The Arduino IDE loop function -- Called contineously 
 void loop()
 {
-  short adc_val;
-  float Vbus_Volt;
-  short rounded;
-  float result ;
-  static char PrevEncCnt = EncoderCnt;	// used to indicate that user turned knob
-  static unsigned char PrevShortPressCnt = 0;
-  static char p;
-  float dewptC, TD_deltaC;
-  float Temp_C;
-  static bool REDledAlarm = false;
-  static unsigned long t = millis();
- 
- 
+  PROF_BEGIN( PROF_LOOP );
+
   wdt_reset();
+  SchedRun();
+  PROF_END( PROF_LOOP );
+  SchedIdle();      // sleep until the next task is due, the instrument often runs off a battery
+}
 
-     
-#ifdef WITH_WIND  
-  WindRead();
-#else ifdef WITH_RPM
-  RPM_Read();
-	
-#endif
-  BMP085_Read_Process();
-  SI7021_Read_Process();
-  TMP100_Read_Process();
-  
- 
-  // anything to display ?
-  if ( t + UPDATE_PER > millis() && EncoderCnt == PrevEncCnt && ShortPressCnt == PrevShortPressCnt)
-    return;
 
-  // update every n sec
-  t = millis();
+// Updates the display every UPDATE_PER, or FAST_PER on the SCR_FAST screens, and when woken up by InputTask()
+static unsigned short
+DisplayTask( void )
+{
+  short adc_val;
+  float TD_deltaC;
+  static bool REDledAlarm = false;
+  PROF_BEGIN( PROF_DISPLAY );
 
-  adc_val = analogRead(VBUS_ADC);
+  adc_val = ADC_Result(VBUS_ADC);
   Vbus_Volt = adc_val * VBUS_ADC_BW;
  
  // Note: Temperatur can come from the Barometer or Hygrometer temp reading, but hyg has more resolution
@@ -320,321 +948,25 @@ void loop()
     digitalWrite( LED2_PIN, LOW);
 
   // Start of the individual readings display 
-  lcd.home(  );  // Don't use LCD clear because of screen flicker
-
-  re_eval:
-// Limit this display to valid choices, wrap around if invalid choice is reached
-  if (EncoderCnt < 0 ) 
-        EncoderCnt = DISP_END-1;
-  if (EncoderCnt >= DISP_END)
-        EncoderCnt = 0; 
-  
-  switch (EncoderCnt)
-  {
-    case V_Bus:
-      lcd.print("Voltage ");
-      lcd.setCursor ( 0, 1 );
-      lcd.print( Vbus_Volt ) ;
-      lcd.print(" V  ");
-      if (Vbus_Volt > VOLT_LOW_ALARM  && Vbus_Volt < VOLT_HIGH_ALARM )
-      {
-        REDledAlarm = false;
-      }
-      break;
-      
-    case D_Alt:
-      if (No_Baro)
-      {
-        EncoderCnt += EncoderDirection;
-        goto re_eval;
-      }
-      lcd.print("Dens Alt");
-      lcd.setCursor ( 0, 1 );
-      if (MetricDisplay)
-      {
-        rounded = DensityAlt(BaroReading.BaromhPa, BaroReading.TempC) + 0.5;
-        lcd.print(rounded ) ; 
-        lcd.print(" M     ");      
-      }
-      else
-      {
-        rounded = MtoFeet( DensityAlt(BaroReading.BaromhPa, BaroReading.TempC)) + 0.5;
-        rounded /= 10;
-        lcd.print(rounded * 10) ; // limit to 10ft resolution
-        lcd.print(" ft    ");
-      }
-     
-      break;
-
-    case Alt:
-      if (No_Baro)
-      {
-        EncoderCnt += EncoderDirection;
-        goto re_eval;
-      }
-      
-      if (LongPressCnt)   // entering setup
-      {
-        Alt_Setting_adjust( );
-        LongPressCnt =0;
-        lcd.home (  );
-        EncoderCnt = Alt;    // restore the Alt display item
-      }
-      
-      lcd.print(" Alt *  ");
-      lcd.setCursor ( 0, 1 );
-
-      if (MetricDisplay)
-      {
-        rounded = Altitude(BaroReading.BaromhPa, AltimeterSetting) + 0.5;
-        lcd.print( rounded);
-        lcd.print(" M     ");
-      }
-      else
-      {
-        rounded = MtoFeet(Altitude(BaroReading.BaromhPa, AltimeterSetting)) + 0.5;
-        lcd.print( rounded);
-        lcd.print(" ft    ");
-      }
-      break;
-
-    case Station_P:
-      if (No_Baro)
-      {
-        EncoderCnt += EncoderDirection;
-        goto re_eval;
-      }
-      lcd.print("Pressure");
-      lcd.setCursor ( 0, 1 );
-      
-      if (MetricDisplay)
-      {
-        lcd.print( BaroReading.BaromhPa );
-        lcd.print("hPa");
-      }
-      else
-      {
-        lcd.print( hPaToInch(BaroReading.BaromhPa) );
-        lcd.print("\"Hg");
-      }
-      break;
+  lcd.home(  );  // Don't use LCD clear because of screen flicker, only the changed characters go out with lcd.refresh()
 
-    case Rel_Hum:
-      if (No_Hygro)
-      {
-        EncoderCnt += EncoderDirection;
-        goto re_eval;
-      }
-      lcd.print("Humidity");
-      lcd.setCursor ( 0, 1 );
-      rounded = HygReading.RelHum  + 0.5;
-      lcd.print( rounded  );
-      lcd.print(" % RH  ");
-      break;
-
-    case Temp:
-      if (No_Hygro && No_Baro && No_TMP100)
-      {
-        EncoderCnt += EncoderDirection;
-        goto re_eval;
-      }
-
-      if (LongPressCnt)   // toggle between imperial and metric display
-      {
-        if ( MetricDisplay != 0 )
-          MetricDisplay = 0;
-        else
-          MetricDisplay = 1; 
-         
-        EEPROM.put( 0, MetricDisplay);
-        LongPressCnt =0;
-      }
-      
-      lcd.print(" Temp * ");
-      lcd.setCursor ( 0, 1 );
-      if ( MetricDisplay)
-      {
-        lcd.print( Temp_C);
-        lcd.print(char(223)); // degree symbol
-        lcd.print("C   ");
-      }
-      else
-      {
-        lcd.print( CtoF( Temp_C) );
-        lcd.print(char(223)); // degree symbol
-        lcd.print("F   ");
-      }
-      break;
-
-    case DewPoint:
-      if (No_Hygro)
-      {
-        EncoderCnt += EncoderDirection;
-        goto re_eval;
-      }
-      lcd.print("DewPoint");
-      lcd.setCursor ( 0, 1 );
-      
-      if (MetricDisplay)
-      {
-       rounded = dewptC + 0.5;
-       lcd.print( rounded );
-       lcd.print(char(223)); // degree symbol
-       lcd.print("C   ");
-      }
-      else
-      {
-       rounded = CtoF(dewptC) + 0.5;
-       lcd.print( rounded );
-       lcd.print(char(223)); // degree symbol
-       lcd.print("F   ");
-      }
-      break;
-      
-#ifdef WetBulbTemp
-
-    case  T_WetBulb:
-    
-      if (No_Hygro)
-      {
-        EncoderCnt += EncoderDirection;
-        goto re_eval;
-      }
-      
-      lcd.print("Wet Bulb");
-      lcd.setCursor ( 0, 1 );
-      if ( No_Baro)
-        result = T_wetbulb_C(Temp_C,942.0,HygReading.RelHum); // in the absence of a Barometer reading I take the pressure at ~2000ft in standard Atmos.  
-      else
-        result = T_wetbulb_C(Temp_C,BaroReading.BaromhPa,HygReading.RelHum);
-      if (MetricDisplay)
-      {
-        lcd.print( result);
-        lcd.print(char(223)); // degree symbol
-        lcd.print("C   ");
-      }
-      else
-      {
-        lcd.print( CtoF(result));
-        lcd.print(char(223)); // degree symbol
-        lcd.print("F   ");
-      }
-      break;
-#endif      
-
-    case TD_spread:
-      if (No_Hygro)
-      {
-        EncoderCnt += EncoderDirection;
-        goto re_eval;
-      }
-      lcd.print("TDspread");
-      lcd.setCursor ( 0, 1 );
-  
-      if (MetricDisplay)
-      {
-        rounded = (Temp_C - dewptC) + 0.5; // for deg C
-        lcd.print( rounded );
-        lcd.print(char(223)); // degree symbol
-        lcd.print("C     ");
-      }
-      else
-      {
-        rounded = (CtoF(Temp_C) - CtoF(dewptC)) + 0.5; // for deg F
-        lcd.print( rounded );
-        lcd.print(char(223)); // degree symbol
-        lcd.print("F     ");
-      }
-      if ( TD_deltaC > TD_DELTA_ALARM)
-        REDledAlarm = false;            // turn alarm off
-      break;
-      
-#ifdef WITH_WIND
-    case Wind_SPD:
-      lcd.print("Wind SPD");
-      lcd.setCursor ( 0, 1 );
-      if (MetricDisplay)
-      {
-        lcd.print( WindSpdMPH * KMpMILE);
-        lcd.print(" KMH   ");
-      }
-      else
-      {
-        lcd.print( WindSpdMPH);
-        lcd.print(" MPH   ");
-      }
-      t -= UPDATE_PER;  // fastest readout 
-      break;
-
-    case Wind_GST:
-      lcd.print("Wind GST");
-      lcd.setCursor ( 0, 1 );
-      if (MetricDisplay)
-      {
-        lcd.print( WindGustMPH * KMpMILE);
-        lcd.print(" KMH   ");
-      }
-      else
-      {
-        lcd.print( WindGustMPH);
-        lcd.print(" MPH   ");
-      }
-      break;
-
-    case Wind_AVG:
-      lcd.print("Wind AVG");
-      lcd.setCursor ( 0, 1 );
-      if ( MetricDisplay)
-      {
-        lcd.print( WindAvgMPH * KMpMILE);
-        lcd.print(" KMH   ");
-      }
-      else
-      {
-        lcd.print( WindAvgMPH);
-        lcd.print(" MPH   ");
-      }
-      break;
-
-    case Wind_DIR:
-      if  ( LongPressCnt) 
-      {
-          WindDirCal(  );   // blocking until completed
-          lcd.home (  );
-          LongPressCnt =0;
-          EncoderCnt = Wind_DIR;    // restore the current display item
-      }    
-      
-      lcd.print("Wnd DIR*");
-      lcd.setCursor ( 0, 1 );
-      lcd.print( WindDir);
-      lcd.print(" ");
-      lcd.print(char(223)); // degree symbol
-      lcd.print("     ");
-      t -= UPDATE_PER;  // fastest readout 
-      
-      break;
-      
-#endif    
-#ifdef WITH_RPM
-    case RPM:
-      lcd.print("  RPM   ");
-      lcd.setCursor ( 0, 1 );
-      lcd.print( RPM_);
-      lcd.print("      ");
-	  break;
+  ScreenSelect();
+#ifdef WITH_PROFILE
+  if ( EncoderCnt != Diag )
+    ScreenAvail &= ~( 1UL << Diag );   // hidden again once the knob moved off it
 #endif
-    default:
-      // go in the same direction as last knob input from user and re-evalute again.
-      // will wrap around in re_eval;
-      EncoderCnt += EncoderDirection;
-      goto re_eval;
-      break;
-  }
+  if ( ScreenShow( EncoderCnt ) & SCR_FAST )
+    SchedPeriod( &Tasks[TASK_DISPLAY], FAST_PER );  // fastest readout
+  else
+    SchedPeriod( &Tasks[TASK_DISPLAY], UPDATE_PER );
+
+  // the alarm goes off once the alarming reading is seen back in range
+  if ( EncoderCnt == V_Bus && Vbus_Volt > VOLT_LOW_ALARM  && Vbus_Volt < VOLT_HIGH_ALARM )
+    REDledAlarm = false;
+  if ( EncoderCnt == TD_spread && TD_deltaC > TD_DELTA_ALARM)
+    REDledAlarm = false;            // turn alarm off
 
-  BMP085_startMeasure(  );    // initiate an other measure cycle on the Barometer
-  SI7021_startMeasure(  );    // initiate an other measure cycle on the Hygrometer
-  TMP100_startMeasure(  );    // initiate an other measure cycle on the Stand alone Thermometer
+  lcd.refresh();
 
   PrevEncCnt = EncoderCnt;
   PrevShortPressCnt = ShortPressCnt;
@@ -651,5 +983,7 @@ void loop()
   else
     digitalWrite( LED1_PIN, LOW);
 
+  PROF_END( PROF_DISPLAY );
+  return SCHED_DONE;
 }
 
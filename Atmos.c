@@ -7,14 +7,194 @@
 
 /* Function to calculate standard atmospheric items such as Pressure Altitude, Density Altitude, Dewpoint etc.. */
 #include "math.h"
+#include "build_opts.h"
 #include "Atmos.h"
 
+#ifndef ATMOS_MATH
+#define ATMOS_MATH ATMOS_FLOAT
+#endif
+
+#ifndef WETBULB_SOLVER
+#define WETBULB_SOLVER WETBULB_NEWTON
+#endif
+
+#if ATMOS_MATH == ATMOS_TABLES
+#include "Atmos_tables.h"
+#endif
+
 
 #define Tsl (288.15)		  // standard atmosphere temp in Kelvin at sea level
 #define Psl STD_ALT_SETTING	  // standard atmosphere pressure at sea level, aka QNE
 #define LapsR (0.0065)		// standard atmosphere lapse rate
 #define pwr_da (0.234969245)
 
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  Fixed point versions ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+  The AVR has no FPU and the float pow(), log() and exp() cost several thousand cycles each. These versions use integer
+  Pa, 1/100 degC and decimeters and compute x^a as 2^(a*log2(x)) with short polynomials in fixed point.
+
+  Max error against the float formulas, over 300..1100 hPa, -40..+60 degC and 1..100 %RH:
+	Altitude, PressureAlt   < 0.2 m
+	DensityAlt              < 0.5 m
+	DewPt                   < 0.02 degC, also from +60 up to +80 degC
+  most of it from the 2.5e-5 error of fx_log2(). The results are rounded to 0.1m and 0.01 degC. tools/check/atmos.cpp
+  measures these in the 32 bit arithmetic of the AVR.
+  Pressure ratios are clamped to 0.25 .. 2, temperatures to -60 .. +80 degC and RH to 1 .. 100 %.
+
+  The cost is mostly the 32 bit divisions (~600 cycles each) and 32 bit multiplies (~60 cycles each). Estimated
+  ~2500 cycles for Altitude_dm, ~4000 for DensityAlt_dm and ~2000 for DewPt_centiC, against 6000 .. 9000 for the float code.
+*/
+
+#define LN2_Q12 2839L                // ln(2) in Q12, for log2 -> ln
+#define SQRT2_Q24 23726566L
+
+// log2(1+f) = f * P(f), f in [sqrt(0.5)-1, sqrt(2)-1], coefficients in Q15, max error 1.1e-5
+static const long Log2_Poly[6] = { 47274, -23633, 15718, -11988, 10480, -6932 };
+
+// (2^e - 1) / e = c0 + e*(c1 + e*(c2 + e*c3)), e in [-0.5, 0.25], c0 in Q20, the rest in Q16, max error 3.1e-6
+#define EXP2M1_C0 726817L
+static const long Exp2m1_Poly[3] = { 15746, 3642, 590 };
+
+/* log2 of a Q24 value, result in Q16 */
+static long
+fx_log2( unsigned long x )
+{
+	long n = 0;
+	long f, acc;
+	signed char i;
+
+	if ( x == 0 )
+		x = 1;
+
+	while ( x >= (1UL << 25) )
+	{
+		x >>= 1;
+		n++;
+	}
+	while ( x < (1UL << 24) )
+	{
+		x <<= 1;
+		n--;
+	}
+
+	// center the mantissa on 1 so the polynomial only has to cover [0.707, 1.414)
+	if ( x >= SQRT2_Q24 )
+	{
+		x >>= 1;
+		n++;
+	}
+	f = (long) x - (1L << 24);		// Q24
+
+	// the polynomial only needs Q16, the final multiply by f keeps the full precision
+	acc = Log2_Poly[5];
+	for ( i = 4; i >= 0; i-- )
+		acc = Log2_Poly[i] + ((acc * ((f + 128) >> 8) + 32768) >> 16);
+
+	return (n << 16) + ((acc * (f >> 8) + ((acc * (f & 0xff)) >> 8) + 16384) >> 15);
+}
+
+/* Q24 ratio of a/b, a and b positive and below 2^17, a/b below 128 */
+static unsigned long
+fx_ratio( unsigned long a, unsigned long b )
+{
+	unsigned long q = (a << 14) / b;
+	unsigned long r = (a << 14) - q * b;
+
+	return (q << 10) + ((r << 10) + b / 2) / b;
+}
+
+/*
+  scale * (1 - 2^(pwr * L)), the common form of the altitude formulas, in decimeters.
+  L = log2 of the pressure ratio in Q16, pwr in Q24, scale in meters. 2^e - 1 is evaluated as e * g(e) so the
+  small differences near sea level keep their precision. The products are split into high and low parts to fit 32 bits.
+*/
+static long
+fx_alt_dm( long L, long pwr_q24, unsigned long scale_m )
+{
+	long e, h, g, u;
+	unsigned long m;
+
+	if ( L < -2 * 65536L )
+		L = -2 * 65536L;
+	if ( L >= 65536L )
+		L = 65535L;
+
+	e = (((L >> 8) * pwr_q24) >> 12) + (((L & 0xff) * pwr_q24) >> 20);		// Q20
+
+	h = Exp2m1_Poly[2];
+	h = Exp2m1_Poly[1] + ((h * (e >> 4)) >> 16);
+	h = Exp2m1_Poly[0] + ((h * (e >> 4)) >> 16);								// Q16
+	g = EXP2M1_C0 + ((((e >> 8) * h) + (((e & 0xff) * h) >> 8)) >> 8);		// Q20
+	u = ((e >> 10) * g) + (((e & 0x3ff) * g) >> 10);							// 2^e - 1 in Q30
+
+	// above sea level pressure the result is negative
+	m = u < 0 ? -u : u;
+	m = (m >> 16) * scale_m + (((m & 0xffff) * scale_m) >> 16);				// meters in Q14
+	m = (m * 5 + 4096) >> 13;
+
+	return u > 0 ? -(long) m : (long) m;
+}
+
+// Altitude in dm from pressure and sea level pressure in Pa
+long
+Altitude_dm( long P_Pa, long Psl_Pa )
+{
+	return fx_alt_dm( fx_log2( fx_ratio( P_Pa, Psl_Pa )), 3192396, 44308 );		// pwr 0.190284, 44307.7m
+}
+
+// Pressure altitude in dm from pressure in Pa
+long
+PressureAlt_dm( long P_Pa )
+{
+	return Altitude_dm( P_Pa, (long) (Psl * 100) );
+}
+
+// Density altitude in dm from pressure in Pa and temperature in 1/100 degC
+long
+DensityAlt_dm( long P_Pa, long T_centiC )
+{
+	long L;
+
+	if ( T_centiC < -6000 )
+		T_centiC = -6000;
+	if ( T_centiC > 8000 )
+		T_centiC = 8000;
+
+	// log2( (P/Psl) / (T/Tsl) )
+	L = fx_log2( fx_ratio( P_Pa, (long) (Psl * 100) )) - fx_log2( fx_ratio( T_centiC + 27315, 28815 ));
+
+	return fx_alt_dm( L, 3942164, 44331 );		// pwr_da, Tsl/LapsR = 44330.8m
+}
+
+// Dew point in 1/100 degC from temperature in 1/100 degC and relative humidity in 1/100 %, Magnus formula as in DewPt()
+long
+DewPt_centiC( long T_centiC, unsigned short RH_centi )
+{
+	long Y, d, q;
+
+	if ( RH_centi > 10000 )
+		RH_centi = 10000;
+	if ( RH_centi < 100 )
+		RH_centi = 100;
+	if ( T_centiC < -6000 )
+		T_centiC = -6000;
+	if ( T_centiC > 8000 )
+		T_centiC = 8000;
+
+	// Y = (a*Tc /(b+Tc)) + ln(RH/100), Y * 16000 from quotient and remainder, a*Tc * 16 overflows above 77 degC
+	d = 23770 + T_centiC;
+	Y = 17271L * T_centiC;
+	q = Y / d;
+	Y = q * 16 + ((Y - q * d) * 16) / d;
+	Y = (Y * 512) / 125;										// Q16
+	Y += (fx_log2( fx_ratio( RH_centi, 10000 )) * LN2_Q12) >> 12;
+
+	// Td = b * Y / (a - Y), in Q12 to stay within 32 bits
+	return (23770L * (Y >> 4)) / ((1131872L - Y) >> 4);
+}
+
+
   
  /*	 Calculate DewPoint from Temp and humidity
 
@@ -42,6 +222,160 @@
              Td = b * Y / (a - Y)
 */
  
+#if WETBULB_SOLVER != WETBULB_STULL
+// Saturation vapor pressure in hPa over water at t degC, es(t) = 6.112 * exp(17.67 * t / (t + 243.5)), and its slope in hPa/degC
+static float
+SatVP( float t, float *slope )
+{
+#if ATMOS_MATH == ATMOS_TABLES
+	float i = t - SATVP_T_MIN;
+	unsigned char k;
+	float y0, y1;
+
+	if ( i < 0 )
+		i = 0;
+	if ( i > SATVP_N - 1 )
+		i = SATVP_N - 1;
+
+	k = i;
+	if ( k == SATVP_N - 1 )
+		k--;
+
+	y0 = pgm_read_float( &SatVP_Table[k] );
+	y1 = pgm_read_float( &SatVP_Table[k + 1] );
+	*slope = y1 - y0;
+	return y0 + *slope * (i - k);
+#else
+	float es = 6.112 * exp((17.67 * t) / (t + 243.5));
+
+	*slope = es * (17.67 * 243.5) / ((t + 243.5) * (t + 243.5));
+	return es;
+#endif
+}
+
+#if WETBULB_SOLVER == WETBULB_NEWTON
+// The inverse of SatVP(), the dew point in degC for a vapor pressure e in hPa
+static float
+SatVP_Td( float e )
+{
+#if ATMOS_MATH == ATMOS_TABLES
+	unsigned char lo = 0, hi = SATVP_N - 1, mid;
+	float y0, y1;
+
+	// bisect for the table interval holding e, the table is monotonic
+	while ( hi - lo > 1 )
+	{
+		mid = (lo + hi) / 2;
+		if ( pgm_read_float( &SatVP_Table[mid] ) > e )
+			hi = mid;
+		else
+			lo = mid;
+	}
+
+	y0 = pgm_read_float( &SatVP_Table[lo] );
+	y1 = pgm_read_float( &SatVP_Table[hi] );
+	return SATVP_T_MIN + lo + (e - y0) / (y1 - y0);
+#else
+	float g = log( e / 6.112 );
+
+	return 243.5 * g / (17.67 - g);
+#endif
+}
+#endif
+#endif // WETBULB_SOLVER != WETBULB_STULL
+
+#if ATMOS_MATH == ATMOS_FIXED
+
+float
+DewPt( float Tc, float RH )
+{
+	// SI Hygro sends values >100% for condensing, Limit RH for all cases
+	if (RH >100 )
+		RH = 100;
+	if (RH < 0 )
+		RH = 0;
+
+	return DewPt_centiC( Tc * 100 + (Tc < 0 ? -0.5 : 0.5), RH * 100 + 0.5 ) / 100.0;
+}
+
+float
+Altitude ( float P_hPa, float P_sl)
+{
+	return Altitude_dm( P_hPa * 100 + 0.5, P_sl * 100 + 0.5 ) / 10.0;
+}
+
+float
+PressureAlt( float P_hPa)
+{
+	return PressureAlt_dm( P_hPa * 100 + 0.5 ) / 10.0;
+}
+
+float
+DensityAlt( float P_hPa, float Temp_C)
+{
+	return DensityAlt_dm( P_hPa * 100 + 0.5, Temp_C * 100 + (Temp_C < 0 ? -0.5 : 0.5) ) / 10.0;
+}
+
+#elif ATMOS_MATH == ATMOS_TABLES
+
+// linear interpolation in the Alt_Table / DA_Table tables of ratio ^ pwr
+static float
+pow_lookup( const float *tab, float x )
+{
+	float i;
+	unsigned char k;
+	float y0, y1;
+
+	i = (x - POW_X_MIN) * POW_X_DIV;
+	if ( i < 0 )
+		i = 0;
+	if ( i > POW_N - 1 )
+		i = POW_N - 1;
+
+	k = i;
+	if ( k == POW_N - 1 )
+		k--;
+
+	y0 = pgm_read_float( &tab[k] );
+	y1 = pgm_read_float( &tab[k + 1] );
+	return y0 + (y1 - y0) * (i - k);
+}
+
+// The dew point has no table, the Magnus formula only needs a log of the RH and the fixed point version is cheap
+float
+DewPt( float Tc, float RH )
+{
+	// SI Hygro sends values >100% for condensing, Limit RH for all cases
+	if (RH >100 )
+		RH = 100;
+	if (RH < 0 )
+		RH = 0;
+
+	return DewPt_centiC( Tc * 100 + (Tc < 0 ? -0.5 : 0.5), RH * 100 + 0.5 ) / 100.0;
+}
+
+float
+Altitude ( float P_hPa, float P_sl)
+{
+	return (1.0 - pow_lookup( Alt_Table, P_hPa / P_sl )) * 44307.7;
+}
+
+float
+PressureAlt( float P_hPa)
+{
+	return Altitude(P_hPa, Psl);
+}
+
+float
+DensityAlt( float P_hPa, float Temp_C)
+{
+	float T = Temp_C + 273.15;
+
+	return (Tsl/LapsR) * (1 - pow_lookup( DA_Table, (P_hPa/Psl) / (T/Tsl) ));
+}
+
+#else
+
  float 
  DewPt( float Tc, float RH )
  {
@@ -89,9 +423,74 @@ DensityAlt( float P_hPa, float Temp_C)
 	return D_alt;
 }
 
+#endif // ATMOS_MATH
+
 // Calculate WetBulb temp from Temp_C, Stationpressure_hPa and relative humidity.
 // Formula from   https://www.easycalculation.com/weather/learn-dewpoint-wetbulb.php
+// The wet bulb temperature Twb is the root of
+//      es(Twb) - P * (T - Twb) * 0.00066 * (1 + 0.00115 * Twb) - e = 0
+// with es(t) = 6.112 * exp(17.67 * t / (t + 243.5)) and e the vapor pressure of the air.
+
+#if WETBULB_SOLVER == WETBULB_NEWTON
+
+// Newton-Raphson on the equation above. The function is convex and increasing in Twb, so after the first step
+// the iteration approaches the root from above without overshooting. One SatVP() per iteration, at most 5 for
+// -40..60 degC, 300..1100 hPa and 1..100 %RH.
+float
+T_wetbulb_C(float Temp_C, float Press_hPa, float Rh)
+{
+    float Twb, Td, es, des, e, f, df, step;
+    unsigned char i;
+
+    if (Rh > 100 )
+        Rh = 100;
+    if (Rh < 1 )
+        Rh = 1;
+
+    // Twb lies between the dew point and T and is roughly a third of the way up from Td
+    e = SatVP( Temp_C, &des ) * Rh / 100.0;
+    Td = SatVP_Td( e );
+    Twb = Td + (Temp_C - Td) / 3;
+
+    const float psy = Press_hPa * 0.00066;
+
+    for (i = 0; i < WETBULB_MAX_ITER; i++)
+    {
+        es = SatVP( Twb, &des );
+        f = es - psy * (Temp_C - Twb) * (1 + (0.00115 * Twb)) - e;
+        df = des + psy * (1 + (0.00115 * Twb) - 0.00115 * (Temp_C - Twb));
+
+        step = f / df;
+        Twb -= step;
+
+        if (step < 0.005 && step > -0.005)
+            break;
+    }
+
+    return Twb;
+}
+
+#elif WETBULB_SOLVER == WETBULB_STULL
+
+// Roland Stull, "Wet-Bulb Temperature from Relative Humidity and Air Temperature", J. Appl. Meteor. Climatol. 2011.
+// An empirical fit at 1013 hPa for 5..99 %RH and -20..50 degC, within about 1 degC there. Ignores the pressure.
+float
+T_wetbulb_C(float Temp_C, float Press_hPa, float Rh)
+{
+    (void) Press_hPa;
+
+    if (Rh > 100 )
+        Rh = 100;
+    if (Rh < 1 )
+        Rh = 1;
+
+    return Temp_C * atan( 0.151977 * sqrt( Rh + 8.313659 ))
+           + atan( Temp_C + Rh ) - atan( Rh - 1.676331 )
+           + 0.00391838 * Rh * sqrt( Rh ) * atan( 0.023101 * Rh )
+           - 4.686035;
+}
 
+#else
 float
 T_wetbulb_C(float Temp_C, float Press_hPa, float Rh)
 {
@@ -100,8 +499,10 @@ T_wetbulb_C(float Temp_C, float Press_hPa, float Rh)
     short cursign,previoussign = 1;
     float e_diff = 1;              // Difference in vapor press the itterative code is driving to 0
     float e_guess;                 // The current itterations Vapor pressure calculated from the current itterations Wetbulb temp
+    unsigned char steps = 0;
  
-    const float es = 6.112 * exp((17.67 * Temp_C) / (Temp_C + 243.5));    // Saturated Vapor Pressure
+    float slope;                   // unused
+    const float es = SatVP( Temp_C, &slope );                             // Saturated Vapor Pressure
     const float e  = es * Rh /100.0;                                      // Vapor pressure 
     
    // es =  6.112 * exp(17.67 * Temp_C / (Temp_C + 243.5)); // Saturated Vapor pressure 
@@ -111,9 +512,9 @@ T_wetbulb_C(float Temp_C, float Press_hPa, float Rh)
     // initially aproaching 0 by using 10 deg incrementgs in assumed Twb, then switching to 1/10 of that each time the 
     // sign changes until we are at 0 or close enough (0.005)
     
-    while (abs(e_diff) > 0.005) 
+    while (abs(e_diff) > 0.005 && steps++ < WETBULB_MAX_STEPS) 
     {
-      e_guess = 6.112 * exp((17.67 * Twb) / (Twb + 243.5));
+      e_guess = SatVP( Twb, &slope );
       e_guess = e_guess - Press_hPa * (Temp_C - Twb) * 0.00066 * (1 + (0.00115 * Twb));
       e_diff = e - e_guess; 
       
@@ -140,3 +541,4 @@ T_wetbulb_C(float Temp_C, float Press_hPa, float Rh)
     return Twb;
 }
 
+#endif // WETBULB_SOLVER
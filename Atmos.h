@@ -12,6 +12,19 @@
 #ifndef Atmosphere_H
 #define	Atmosphere_H
 #define STD_ALT_SETTING 1013.25
+
+// Math kernels for ATMOS_MATH in build_opts.h
+#define ATMOS_FLOAT  0
+#define ATMOS_FIXED  1
+#define ATMOS_TABLES 2
+
+// Wet bulb solvers for WETBULB_SOLVER in build_opts.h
+#define WETBULB_SEARCH 0        // the original decade stepping search
+#define WETBULB_NEWTON 1        // Newton-Raphson seeded from the dew point, to 0.005 degC
+#define WETBULB_STULL  2        // Stull's closed form fit, no iteration, ~ +-1 degC at sea level pressure
+#define WETBULB_MAX_ITER 8      // hard limit for the Newton solver
+#define WETBULB_MAX_STEPS 100   // hard limit for the search
+
 #ifdef	__cplusplus
 extern "C" {
 #endif
@@ -22,6 +35,12 @@ extern float DensityAlt( float P_hPa, float Temp_C);
 extern float Altitude ( float P_hPa, float P_sl);
 extern float T_wetbulb_C(float Temp_C,float Press_hPa, float Rh);
 
+// Fixed point versions -- pressure in Pa, temperature in 1/100 degC, humidity in 1/100 %, altitude in decimeters
+extern long Altitude_dm( long P_Pa, long Psl_Pa );
+extern long PressureAlt_dm( long P_Pa );
+extern long DensityAlt_dm( long P_Pa, long T_centiC );
+extern long DewPt_centiC( long T_centiC, unsigned short RH_centi );
+
 #ifdef	__cplusplus
 }
 #endif
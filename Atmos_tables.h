@@ -0,0 +1,103 @@
+/* Generated by tools/atmos_tables.c -- do not edit
+
+  Flash used: 1804 bytes
+  Max relative interpolation error:
+	SatVP_Table   0.003, 0.018 degC in the wet bulb
+	Alt_Table     1.8e-05, below 0.81 m altitude
+	DA_Table      2.1e-05, below 0.94 m density altitude
+*/
+
+#include <avr/pgmspace.h>
+
+#define SATVP_T_MIN -80		// degC, 1 degC per entry
+#define SATVP_N 161
+#define POW_X_MIN 0.25		// pressure ratio of the first entry
+#define POW_X_DIV 128		// entries per unit of the pressure ratio
+#define POW_N 145
+
+static const float SatVP_Table[161] PROGMEM = {
+	0.0010748034, 0.0012612618, 0.0014772088, 0.0017268477, 0.002014914, 0.002346733,
+	0.0027282846, 0.0031662717, 0.0036681971, 0.004242445, 0.004898371, 0.0056463986,
+	0.0064981245, 0.0074664322, 0.0085656139, 0.0098115038, 0.011221619, 0.012815315,
+	0.014613946, 0.016641047, 0.018922518, 0.021486831, 0.024365241, 0.027592024,
+	0.031204719, 0.035244392, 0.039755916, 0.044788273, 0.050394862, 0.056633843,
+	0.063568487, 0.071267557, 0.079805706, 0.089263897, 0.09972985, 0.11129851,
+	0.12407255, 0.13816288, 0.1536892, 0.1707806, 0.18957612, 0.21022544,
+	0.2328895, 0.25774122, 0.28496626, 0.31476373, 0.34734703, 0.38294469,
+	0.42180122, 0.46417803, 0.51035438, 0.56062839, 0.61531803, 0.67476223,
+	0.73932194, 0.80938136, 0.88534907, 0.96765932, 1.0567733, 1.1531804,
+	1.2573999, 1.3699818, 1.4915091, 1.6225985, 1.7639027, 1.9161114,
+	2.0799535, 2.2561986, 2.4456588, 2.6491903, 2.8676959, 3.1021262,
+	3.3534822, 3.6228171, 3.9112384, 4.21991, 4.5500546, 4.9029558,
+	5.2799607, 5.6824818, 6.112, 6.5700667, 7.0583067, 7.5784202,
+	8.1321863, 8.7214652, 9.3482009, 10.014425, 10.722257, 11.473911,
+	12.271696, 13.11802, 14.015393, 14.966429, 15.973851, 17.040495,
+	18.169308, 19.363361, 20.62584, 21.960063, 23.369471, 24.857641,
+	26.428285, 28.085254, 29.832543, 31.674294, 33.614801, 35.658512,
+	37.810033, 40.074135, 42.455754, 44.959999, 47.592151, 50.357672,
+	53.262207, 56.31159, 59.511843, 62.869188, 66.390045, 70.08104,
+	73.949006, 78.000992, 82.244263, 86.686307, 91.33484, 96.197807,
+	101.28339, 106.60002, 112.15635, 117.9613, 124.02405, 130.35403,
+	136.96093, 143.85471, 151.0456, 158.54413, 166.36107, 174.50752,
+	182.99485, 191.83473, 201.03912, 210.6203, 220.59087, 230.96371,
+	241.75204, 252.96943, 264.62973, 276.74716, 289.33626, 302.41192,
+	315.98938, 330.08423, 344.71241, 359.89023, 375.63437, 391.96187,
+	408.89015, 426.43701, 444.62063, 463.45958, 482.97282
+};
+
+static const float Alt_Table[145] PROGMEM = {
+	0.76813511, 0.77264601, 0.77704754, 0.78134548, 0.7855451, 0.7896513,
+	0.7936686, 0.79760119, 0.80145297, 0.80522754, 0.80892829, 0.81255837,
+	0.81612073, 0.81961811, 0.82305313, 0.8264282, 0.82974561, 0.83300753,
+	0.83621599, 0.8393729, 0.84248007, 0.84553924, 0.84855202, 0.85151996,
+	0.85444452, 0.85732709, 0.86016901, 0.86297152, 0.86573583, 0.86846308,
+	0.87115437, 0.87381073, 0.87643318, 0.87902264, 0.88158006, 0.88410628,
+	0.88660216, 0.88906849, 0.89150605, 0.89391557, 0.89629777, 0.89865332,
+	0.9009829, 0.90328712, 0.90556659, 0.90782191, 0.91005363, 0.91226231,
+	0.91444846, 0.9166126, 0.91875521, 0.92087676, 0.92297772, 0.92505852,
+	0.9271196, 0.92916136, 0.9311842, 0.93318852, 0.93517468, 0.93714305,
+	0.93909399, 0.94102783, 0.94294491, 0.94484554, 0.94673004, 0.94859871,
+	0.95045185, 0.95228974, 0.95411266, 0.95592088, 0.95771466, 0.95949425,
+	0.96125991, 0.96301188, 0.96475038, 0.96647566, 0.96818793, 0.96988741,
+	0.97157431, 0.97324884, 0.9749112, 0.97656159, 0.97820019, 0.97982719,
+	0.98144277, 0.98304712, 0.98464041, 0.98622279, 0.98779445, 0.98935554,
+	0.99090621, 0.99244663, 0.99397694, 0.99549729, 0.99700783, 0.99850868,
+	1, 1.0014819, 1.0029546, 1.0044181, 1.0058725, 1.0073181,
+	1.0087549, 1.0101831, 1.0116027, 1.0130139, 1.0144167, 1.0158114,
+	1.017198, 1.0185765, 1.0199472, 1.0213101, 1.0226653, 1.0240129,
+	1.0253529, 1.0266856, 1.0280109, 1.0293291, 1.03064, 1.0319439,
+	1.0332409, 1.0345309, 1.0358142, 1.0370907, 1.0383605, 1.0396238,
+	1.0408806, 1.042131, 1.043375, 1.0446127, 1.0458443, 1.0470696,
+	1.0482889, 1.0495022, 1.0507096, 1.0519111, 1.0531068, 1.0542967,
+	1.055481, 1.0566596, 1.0578326, 1.0590002, 1.0601622, 1.0613189,
+	1.0624703
+};
+
+static const float DA_Table[145] PROGMEM = {
+	0.72199538, 0.72723461, 0.73235375, 0.73735897, 0.74225595, 0.74704995,
+	0.75174582, 0.75634809, 0.76086094, 0.76528829, 0.76963379, 0.77390083,
+	0.77809263, 0.78221216, 0.78626224, 0.79024551, 0.79416446, 0.79802144,
+	0.80181867, 0.80555823, 0.80924211, 0.81287219, 0.81645023, 0.81997795,
+	0.82345692, 0.82688869, 0.83027471, 0.83361635, 0.83691494, 0.84017174,
+	0.84338794, 0.8465647, 0.84970311, 0.85280423, 0.85586906, 0.85889857,
+	0.86189369, 0.86485529, 0.86778424, 0.87068135, 0.87354741, 0.87638317,
+	0.87918937, 0.88196671, 0.88471586, 0.88743748, 0.89013219, 0.89280059,
+	0.89544328, 0.89806082, 0.90065375, 0.9032226, 0.90576788, 0.90829008,
+	0.91078969, 0.91326715, 0.91572293, 0.91815745, 0.92057113, 0.92296438,
+	0.9253376, 0.92769116, 0.93002544, 0.93234079, 0.93463758, 0.93691614,
+	0.93917679, 0.94141987, 0.94364568, 0.94585452, 0.9480467, 0.95022249,
+	0.95238219, 0.95452606, 0.95665436, 0.95876736, 0.9608653, 0.96294843,
+	0.965017, 0.96707122, 0.96911134, 0.97113757, 0.97315013, 0.97514923,
+	0.97713507, 0.97910786, 0.98106779, 0.98301505, 0.98494984, 0.98687233,
+	0.9887827, 0.99068113, 0.99256779, 0.99444284, 0.99630646, 0.99815879,
+	1, 1.0018302, 1.0036497, 1.0054584, 1.0072566, 1.0090444,
+	1.010822, 1.0125894, 1.0143469, 1.0160945, 1.0178323, 1.0195606,
+	1.0212793, 1.0229887, 1.0246889, 1.0263799, 1.0280619, 1.029735,
+	1.0313993, 1.0330549, 1.0347018, 1.0363403, 1.0379704, 1.0395922,
+	1.0412059, 1.0428114, 1.0444089, 1.0459985, 1.0475802, 1.0491543,
+	1.0507206, 1.0522794, 1.0538308, 1.0553747, 1.0569113, 1.0584407,
+	1.0599629, 1.061478, 1.0629861, 1.0644873, 1.0659816, 1.0674691,
+	1.0689499, 1.0704241, 1.0718917, 1.0733527, 1.0748074, 1.0762556,
+	1.0776975
+};
+
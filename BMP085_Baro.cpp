@@ -1,16 +1,20 @@
+#include "build_opts.h"
 #include "BMP085_baro.h"
 #include <avr/wdt.h>
-#include <LiquidCrystal.h>
+#include "ShadowLCD.h"
 
 //////////////////////////////////////////// BMP805 sensor  //////////////////////
 #define BMP085_I2C_Addr 0xEE
+#define BMP085_MAX_SCL 400000L		// fast mode
 
 #define BMP085_EEprom 0xAA
 #define BMP085_Ctrl_Reg 0xF4
 #define BMP085_ReadADC 0xF6
 #define BMP085_ConvTemp 0x2E	// 16 bits, conversion time 4.5ms
-//#define BMP085_ConvPress 0x34   // 16 bits 1 internal sample 4.5Ms
-#define BMP085_ConvPress 0xF4   // 16 bits 8 internal samples 25.5ms
+#define BMP085_ConvPress 0x34   // plus (oss << 6), 16 to 19 bits, 1 to 8 internal samples
+
+// Pressure conversion time in ms for each oversampling setting, max values from the datasheet rounded up
+static const unsigned char BMP085_ConvTime[4] = { 5, 8, 14, 26 };
 
 // Structure to read the on chip calibration values
 union {
@@ -44,6 +48,34 @@ enum _BMP085_READ_SM {
 // the state machine var
 static  int ThisState = SM_NOTFOUND;
 
+// Measurement mode, see BMP085_setMode()
+static unsigned char Oss = BMP085_ULTRA_HIGH_RES;
+static unsigned char TempEvery = 1;     // pressure samples per temperature reading
+static unsigned char TempCnt = 0;       // pressure samples left until the next temperature reading
+
+// Bus transaction used by the state machine -- runs in the background from the TWI interrupt
+static unsigned char BMP085_Res[3];     // ADC result MSB, LSB, XLSB
+static i2c_txn_t BMP085_Txn = I2C_TXN( BMP085_I2C_Addr );
+static unsigned long BMP085_t_bus;     // when the transaction was queued
+
+// queue a write of a single control register
+static void
+BMP085_Write_Ctrl( unsigned char cmd )
+{
+    i2c_txn_write( &BMP085_Txn, BMP085_Ctrl_Reg, cmd );
+    BMP085_t_bus = millis();
+    i2c_submit( &BMP085_Txn );
+}
+
+// queue a burst read of the ADC result, 2 bytes for temperature, 3 bytes for the up to 19 bit pressure
+static void
+BMP085_Read_ADC( unsigned char len )
+{
+    i2c_txn_read( &BMP085_Txn, BMP085_ReadADC, BMP085_Res, len );
+    BMP085_t_bus = millis();
+    i2c_submit( &BMP085_Txn );
+}
+
 unsigned 
 BMP085_init()
 {
@@ -51,147 +83,128 @@ BMP085_init()
     unsigned short BusErr =0;
 
     delay(11);        // Device has a 10 ms startup delay 
-    i2c_init();
+    i2c_register_device( BMP085_I2C_Addr, min( BMP085_MAX_SCL, I2C_MAX_SCL ));
     
-    if ((BusErr = i2c_start( BMP085_I2C_Addr +I2C_WRITE  )) !=0 )
+    // Gather the 11 cal values in one burst -- 1 = device not attached, 3 = no ACK on the EEPROM address
+    if ((BusErr = i2c_read_block( BMP085_I2C_Addr, BMP085_EEprom, (unsigned char *) BMP085_Cal.dat, sizeof(BMP085_Cal.dat) )) != I2C_OK )
     {
         ThisState = SM_NOTFOUND;
-        i2c_stop(); // and finish by transition into stop state
-        return ( BusErr );     // i2c bus could not be opened, or device not attached
+        return ( BusErr );
     }
-    else
-      ThisState = SM_IDLE;
-    
 
-    if (	i2c_write( BMP085_EEprom) == 0) 	// internal register address for calibration coefficients
-    {
-        i2c_rep_start( BMP085_I2C_Addr +I2C_READ ); // restart in Read mode now
-
-        // Gather the 10 cal values
-      	for (i=0; i <= 10; i++)
-  	    {
-              BMP085_Cal.dat[i]=(i2c_readAck() << 8);
-              BMP085_Cal.dat[i]+=i2c_readAck();
-  	    }
-      	i2c_readNak();   // read one more byte to send a Nack 
-    }
-    else
-    {
-          ThisState = SM_NOTFOUND;
-          BusErr = 3; // The device failed to acknowledged an address cycle on the EEPROM address
-    }
-    i2c_stop(); // and finish by transition into stop state
+    for (i=0; i <= 10; i++)     // the device sends MSB first
+        BMP085_Cal.dat[i] = (BMP085_Cal.dat[i] << 8) | (BMP085_Cal.dat[i] >> 8);
 
+    ThisState = SM_IDLE;
     return BusErr ;
 
 }
 
 
+/*
+  Selects the pressure oversampling setting and how many pressure samples share one temperature reading.
+  The temperature only feeds the B5 term of the pressure compensation and changes slowly, so re-using it
+  for several pressure samples saves the 4.5ms temperature conversion and its two bus transfers per cycle.
+  Takes effect with the next measure cycle.
+*/
+void
+BMP085_setMode( unsigned char oss, unsigned char temp_every )
+{
+    Oss = oss & 3;
+    TempEvery = temp_every ? temp_every : 1;
+    TempCnt = 0;                // start over with a fresh temperature
+}
+
 void
 BMP085_startMeasure( void )
 {
     if ( ThisState == SM_IDLE )
         ThisState = SM_START;
 }
-void
+/*
+  Steps the measure cycle, returns the ms until the next step is due or 0 when the cycle is done or the device idle.
+*/
+unsigned short
 BMP085_Read_Process(void )
 {
     static long T;
     static long X1,X2,X3;
     static long B5;
     static long  Up;
+    static unsigned char oss;       // the setting the current pressure conversion was started with
     static unsigned long t;
-    static boolean bus_err = 0;        // in case the device becomes unresponsive - i.e. unplugged
+    unsigned long dt;
+
+    if ( BMP085_Txn.status == I2C_BUSY )    // previous bus transaction still in progress
+    {
+        if ( millis() - BMP085_t_bus > I2C_TXN_TIMEOUT )    // a device is holding the bus
+            i2c_abort();
+        return 1;
+    }
+
+    if ( BMP085_Txn.status != I2C_OK && ThisState < SM_ERROR ) // the device failed to ack
+        ThisState = SM_ERROR;
 
     switch (ThisState)
     {
         case SM_START:
-            // initiate the temperature Reading
-            if ( i2c_start( BMP085_I2C_Addr +I2C_WRITE  ) != 0) // if the device fails to ack the address
+            if ( TempCnt == 0 )
             {
-                ThisState = SM_ERROR;
-                break;
+                // initiate the temperature Reading
+                TempCnt = TempEvery;
+                BMP085_Write_Ctrl( BMP085_ConvTemp );
+                ThisState = SM_Wait_for_Temp;
+                TempCnt--;
+                t = millis();
+                return 6;
             }
-
-            i2c_write( BMP085_Ctrl_Reg); 	// internal register address
-            i2c_write( BMP085_ConvTemp); 	// internal register address
-            i2c_stop();
-
+            // re-use B5 from the last temperature reading and go straight to the pressure
+            oss = Oss;
+            BMP085_Write_Ctrl( BMP085_ConvPress + (oss << 6) );
+            ThisState = SM_Wait_for_Press;
+            TempCnt--;
             t = millis();
-            ThisState++;
-            break;
+            return BMP085_ConvTime[oss] + 1;
 
         case SM_Wait_for_Temp:
-            if (millis() - t > 5 ) // wait for 5 ms for the result to arrive
-                ThisState++;
-            break;
+            if ( (dt = millis() - t) <= 5 ) // wait for 5 ms for the result to arrive
+                return 6 - dt;
+            BMP085_Read_ADC( 2 );
+            ThisState++;
+            return 1;
 
         case SM_Read_Temp:
         {   
             long Ut;
      
-            // get Temp result now
-            if ( i2c_start( BMP085_I2C_Addr +I2C_WRITE  ) != 0) // if the device fails to ack the address
-            {
-                ThisState = SM_ERROR;
-                break;
-            }
-            i2c_write( BMP085_ReadADC); 	// internal command register address
-            i2c_rep_start( BMP085_I2C_Addr +I2C_READ ); // restart in Read mode now
-
-            Ut = (unsigned short)(i2c_readAck() << 8);
-            Ut+=i2c_readNak();
-            
-            i2c_stop();
+            Ut = (unsigned short)((BMP085_Res[0] << 8) | BMP085_Res[1]);
 
-            X1 =(Ut - BMP085_Cal.Coeff.AC6) * BMP085_Cal.Coeff.AC5 / 32768L;
+            // shifts as in the datasheet, a division would round towards 0 below freezing
+            X1 =((Ut - BMP085_Cal.Coeff.AC6) * BMP085_Cal.Coeff.AC5) >> 15;
             X2 = BMP085_Cal.Coeff.MC * 2048L /(X1 + BMP085_Cal.Coeff.MD);
             B5 = X1+X2;
-            T = (B5+8)/16;
+            T = (B5+8) >> 4;
 
             BaroReading.TempC = T/10.0;
            
             // initiate the Pressure reading
-            if ( i2c_start( BMP085_I2C_Addr +I2C_WRITE  ) != 0) // if the device fails to ack the address
-            {
-                ThisState = SM_ERROR;
-                break;
-            }
-                  
-            i2c_write( BMP085_Ctrl_Reg); 	// internal command register address
-            i2c_write( BMP085_ConvPress); 	// Command
-            i2c_stop();
-
+            oss = Oss;
+            BMP085_Write_Ctrl( BMP085_ConvPress + (oss << 6) );
             t = millis();
             ThisState++;
-            break;
+            return BMP085_ConvTime[oss] + 1;
         }
         case SM_Wait_for_Press:
-            // wait for 40ms in this state
-            if (millis() - t > 40 ) // wait for the result to arrive
-                ThisState++;
-            break;
-
-        case SM_Read_Press:      // get Pressure result now
-        {
-            if ( i2c_start( BMP085_I2C_Addr +I2C_WRITE  ) != 0) // if the device fails to ack the address
-            {
-                ThisState = SM_ERROR;
-                break;
-            }
-
-            i2c_write( BMP085_ReadADC); 	// internal register address
-            i2c_rep_start( BMP085_I2C_Addr +I2C_READ ); // restart in Read mode now
-   
-            Up = (unsigned short) (i2c_readAck() << 8);
-            Up +=  i2c_readNak();
-           
-            i2c_stop();
-
+            if ( (dt = millis() - t) <= BMP085_ConvTime[oss] ) // wait for the result to arrive
+                return BMP085_ConvTime[oss] + 1 - dt;
+            BMP085_Read_ADC( 3 );
             ThisState++;
-          }
-            break;
+            return 1;
 
+        case SM_Read_Press:      // get Pressure result now -- 16 bits plus OSS bits from the XLSB register
+            Up = (((unsigned long) BMP085_Res[0] << 16) | ((unsigned short) BMP085_Res[1] << 8) | BMP085_Res[2]) >> (8 - oss);
+            ThisState++;
+            // fall through -- the result is complete
         case SM_Calc_Press:
         {
             long p;
@@ -208,12 +221,12 @@ BMP085_Read_Process(void )
 
             X3=X1+X2;
 
-            B3 = ((BMP085_Cal.Coeff.AC1 *4L + X3) +2) >> 2;
+            B3 = (((BMP085_Cal.Coeff.AC1 *4L + X3) << oss) +2) >> 2;
             X1 = (BMP085_Cal.Coeff.AC3* B6) >> 13;
             X2 = (BMP085_Cal.Coeff.B_1 * ((B6*B6) >> 12) ) >> 16;
             X3 = ((X1 + X2) + 2) >> 2;
             B4 = (BMP085_Cal.Coeff.AC4 * (unsigned long) (X3 + 32768L)) >> 15;
-            B7 = ((unsigned long)(Up - B3) * 50000L );
+            B7 = ((unsigned long)(Up - B3) * (50000L >> oss) );
 
             if (B7 < (unsigned long)0x80000000)
             {
@@ -240,7 +253,10 @@ BMP085_Read_Process(void )
  //    		Serial.print("Baro had i2C error");
 			BaroReading.TempC = -273.0;
 			BaroReading.BaromhPa =0.0;
-			i2c_stop();
+			if ( BMP085_Txn.status == I2C_ERR_START )	// bus error, see i2c_recover()
+				i2c_recover();
+			BMP085_Txn.status = I2C_OK;
+			TempCnt = 0;		// B5 may be stale by the time the device is back
 			ThisState++;
 			break;
 
@@ -254,12 +270,13 @@ BMP085_Read_Process(void )
             break;     
     }
 
-    
+    return 0;
 }
 
 extern unsigned char ShortPressCnt;
 extern char EncoderCnt;        
-extern LiquidCrystal lcd;
+extern void EncoderPoll(void);
+extern ShadowLCD lcd;
 
 void
 Alt_Setting_adjust( void )
@@ -270,6 +287,7 @@ Alt_Setting_adjust( void )
         while ( !ShortPressCnt ) // set QNH
         {
            wdt_reset();
+           EncoderPoll();
   
           if (EncoderCnt > p)
             AltimeterSetting += 0.25;
@@ -281,8 +299,9 @@ Alt_Setting_adjust( void )
           lcd.setCursor ( 0, 0 );
           lcd.print("Set QNH ");
           lcd.setCursor ( 0, 1 );
-          lcd.print( hPaToInch(AltimeterSetting) );
+          lcd.printFixed( hPaToInch(AltimeterSetting) * 100 + 0.5, 2, 5 );
           lcd.print("\"Hg");
+          lcd.refresh();
         }
 
 }
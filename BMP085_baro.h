@@ -17,10 +17,20 @@
 #define CtoF( tC ) ( tC / 0.5555555555 +32)
 #define MtoFeet( meters) (meters *3.28084)
 
+#define BMP085_PERIOD 500     // measure cycle in ms
+
 #ifdef	__cplusplus
 extern "C" {
 #endif
 
+// Pressure oversampling settings for BMP085_setMode()
+enum BMP085_OSS {
+    BMP085_ULTRA_LOW_POWER = 0,     // 1 sample, 4.5ms
+    BMP085_STANDARD,                // 2 samples, 7.5ms
+    BMP085_HIGH_RES,                // 4 samples, 13.5ms
+    BMP085_ULTRA_HIGH_RES           // 8 samples, 25.5ms
+};
+
 struct tag_baroReadings
 {
     float TempC;
@@ -32,8 +42,9 @@ extern  float AltimeterSetting;
 
 
 extern unsigned  BMP085_init(void);
+extern void BMP085_setMode( unsigned char oss, unsigned char temp_every );
 extern void BMP085_startMeasure( void );
-extern void BMP085_Read_Process(void );
+extern unsigned short BMP085_Read_Process(void );
 extern void Alt_Setting_adjust( void );
 
 #ifdef	__cplusplus
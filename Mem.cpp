@@ -0,0 +1,68 @@
+#include "Arduino.h"
+#include "Mem.h"
+
+#ifdef __AVR__
+
+extern uint8_t __data_start, _end, __stack;     // from the linker script
+extern char *__brkval;                          // top of the heap of malloc(), NULL while it was never used
+
+/*
+  Paints from the end of .bss to the top of RAM. Runs from .init1, before the stack pointer is set up and before the
+  startup code clears r1, so it is plain assembler without a stack and falls through into .init2 at the end.
+*/
+void Mem_Paint( void ) __attribute__(( naked, used, section( ".init1" )));
+
+void
+Mem_Paint( void )
+{
+  __asm__ __volatile__ (
+    "    ldi r30, lo8(_end)\n"
+    "    ldi r31, hi8(_end)\n"
+    "    ldi r24, %0\n"
+    "    ldi r25, hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:  st Z+, r24\n"
+    "2:  cpi r30, lo8(__stack)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :: "M" ( MEM_CANARY ));
+}
+
+static uint8_t *
+HeapTop( void )
+{
+  return __brkval ? (uint8_t *) __brkval : &_end;
+}
+
+unsigned short
+Mem_Free( void )
+{
+  return SP - (unsigned short) HeapTop();
+}
+
+unsigned short
+Mem_MinFree( void )
+{
+  uint8_t *top = HeapTop();
+  uint8_t *p = top;
+
+  while ( p < (uint8_t *) SP && *p == MEM_CANARY )
+    p++;
+  return p - top;
+}
+
+unsigned short
+Mem_Static( void )
+{
+  return &_end - &__data_start;
+}
+
+#else
+
+// The host build, tools/sim, has no stack of the target to look at
+unsigned short Mem_Free( void ) { return 0; }
+unsigned short Mem_MinFree( void ) { return 0; }
+unsigned short Mem_Static( void ) { return 0; }
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * File:   Mem.h
+ * Author: Gary Stofer
+ *
+ * Free SRAM and how close the stack came to the static data.
+ *
+ * The 2Kb of the 328P hold the static data from the bottom and the stack from the top, what is left in between is
+ * free. Nothing checks that the two don't meet, a stack that runs into the data corrupts it and shows up as a random
+ * reset by the watchdog at best. Before the C startup code runs, the free area is painted with MEM_CANARY. The stack
+ * overwrites the paint as it grows, the painted bytes left just above the data are the least free SRAM there ever
+ * was, the high water mark of the stack. A local that happens to hold MEM_CANARY right at the edge makes this a few
+ * bytes too optimistic.
+ * malloc() isn't used, the heap of avr-libc would start right above the data and is counted in as well.
+ *
+ * tools/ram_usage.c lists the static data per module from the symbols of the built ELF.
+ */
+
+#ifndef MEM_H
+#define	MEM_H
+
+#define MEM_CANARY 0xc5
+
+extern unsigned short Mem_Free( void );     // free bytes between the data, or the heap, and the stack now
+extern unsigned short Mem_MinFree( void );  // least free bytes since reset, scans the paint, ~0.3ms per Kb
+extern unsigned short Mem_Static( void );   // bytes of .data and .bss
+
+#endif	/* MEM_H */
@@ -0,0 +1,123 @@
+#include "Prof.h"
+#include "SeqLock.h"
+#include "RPM.h"
+
+#ifdef WITH_PROFILE
+
+/*
+  Regions of the handlers are updated in the handler, the ones of the main loop in the main loop, which never runs
+  while it reads them. The min starts out above any time, a region that never ran has n == 0.
+*/
+static volatile struct tagProf Prof[PROF_N];
+static seq_t Prof_Seq;
+
+const char ProfName[PROF_N][5] PROGMEM = {
+  "Loop", "Baro", "Hygr", "Temp", "Disp",
+#ifdef WITH_RPM
+  "RPM ",
+#else
+  "Wind",
+#endif
+  "Knob", "Btn ", "PCI ", "T1ov", "ADC ", "TWI "
+};
+
+// Timer1 free running at clk/8, the same as RPM_Setup() leaves it, without the overflow interrupt
+void
+Prof_Setup( void )
+{
+  unsigned char r;
+
+  if ( !( TCCR1B & 0x07 ))
+  {
+    TCCR1A = 0;
+    TCCR1B = 1 << CS11;
+  }
+  for ( r = 0; r < PROF_N; r++ )
+    Prof[r].min = PROF_SAT;
+}
+
+void
+Prof_Add( unsigned char r, const prof_t *start )
+{
+  volatile struct tagProf *p = &Prof[r];
+  prof_t now;
+  unsigned short dt;
+
+  Prof_Stamp( &now );
+  if ( (unsigned char) ( now.ms - start->ms ) >= PROF_SAT_MS )
+    dt = PROF_SAT;
+  else
+    dt = now.t - start->t;
+
+  if ( dt < p->min )
+    p->min = dt;
+  if ( dt > p->max )
+    p->max = dt;
+  if ( p->sum >= 0x80000000UL )
+  {
+    p->sum >>= 1;
+    p->n >>= 1;
+  }
+  p->sum += dt;
+  p->n++;
+  SeqWrite( &Prof_Seq );
+#ifdef WITH_RPM
+  if ( r >= PROF_ISR_KNOB )     // the stamps of a handler read TCNT1, RPM_Read() may be reading it
+    SeqWrite( &RPM_Seq );
+#endif
+}
+
+void
+Prof_Get( unsigned char r, struct tagProf *p )
+{
+  unsigned char seq;
+
+  do
+  {
+    seq = SeqBegin( &Prof_Seq );
+    p->min = Prof[r].min;
+    p->max = Prof[r].max;
+    p->sum = Prof[r].sum;
+    p->n = Prof[r].n;
+  } while ( SeqRetry( &Prof_Seq, seq ));
+}
+
+// ticks as us with the one decimal they have
+static void
+PrintUs( Print &out, unsigned short ticks )
+{
+  out.print( '\t' );
+  if ( ticks == PROF_SAT )
+  {
+    out.print( F( ">30ms" ));
+    return;
+  }
+  out.print( ticks >> 1 );
+  out.print( ticks & 1 ? F( ".5" ) : F( ".0" ));
+}
+
+// Tab separated, one line per region, times in us
+void
+Prof_Print( Print &out )
+{
+  struct tagProf p;
+  unsigned char r;
+
+  out.println( F( "region\tn\tmin\tmean\tmax" ));
+  for ( r = 0; r < PROF_N; r++ )
+  {
+    Prof_Get( r, &p );
+    out.print( (const __FlashStringHelper *) ProfName[r] );
+    out.print( '\t' );
+    out.print( p.n );
+    if ( p.n )
+    {
+      PrintUs( out, p.min );
+      PrintUs( out, ( p.sum + p.n / 2 ) / p.n );
+      PrintUs( out, p.max );
+    }
+    out.println();
+  }
+}
+
+#endif
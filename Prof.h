@@ -0,0 +1,100 @@
+/*
+ * File:   Prof.h
+ * Author: Gary Stofer
+ *
+ * Execution time profiling of code regions, built in with WITH_PROFILE in build_opts.h.
+ *
+ * PROF_BEGIN(r) and PROF_END(r) bracket region r in one function, the time in between is added to the min, max and
+ * mean of the region. The time stamps come from Timer1 at clk/8, 0.5us per tick, the timer RPM.cpp runs for its
+ * period measurement. Prof_Setup() starts it the same way when RPM isn't built in. The 16 bit timer wraps after
+ * 32ms, millis() tells the longer runs apart, a region that took PROF_SAT_MS or more counts as PROF_SAT ticks.
+ * The time of a region includes the interrupt handlers that ran in between, the time of a handler starts after the
+ * register saves of its vector.
+ *
+ * The handlers update their regions while the main loop may be reading them, Prof_Get() copies a region under
+ * Prof_Seq, see SeqLock.h. A region is only ever updated from one place, either a handler or the main loop.
+ * A handler reading TCNT1 overwrites the TEMP register of a 16 bit read the main loop may be in the middle of, with
+ * WITH_RPM the handler regions bump RPM_Seq so RPM_Read() repeats its read of the timer.
+ * Without WITH_PROFILE the macros are empty and nothing of this is built.
+ */
+
+#ifndef PROF_H
+#define	PROF_H
+
+#include "Arduino.h"
+#include "build_opts.h"
+
+#ifdef WITH_PROFILE
+
+#define PROF_SAT 0xffff         // ticks of a region that ran too long to measure
+#define PROF_SAT_MS 31          // millis() steps by 1 or 2, a 16 bit tick count that wrapped is at least this
+
+enum {
+  PROF_LOOP = 0,        // one pass of the scheduler, without the sleep
+  PROF_BARO,            // one step of a sensor state machine, that is the blocking part
+  PROF_HYGRO,
+  PROF_TEMP,
+  PROF_DISPLAY,
+  PROF_WIND_RPM,        // WindRead() or RPM_Read()
+  PROF_ISR_KNOB,        // the regions of the interrupt handlers from here on
+  PROF_ISR_BUTTON,
+  PROF_ISR_PCINT,       // wind or RPM edges
+  PROF_ISR_T1OVF,
+  PROF_ISR_ADC,
+  PROF_ISR_TWI,
+  PROF_N                // this must be the last entry
+};
+
+typedef struct
+{
+  unsigned short t;     // Timer1
+  unsigned char ms;     // low byte of millis()
+} prof_t;
+
+struct tagProf
+{
+  unsigned short min;   // in ticks of 0.5us
+  unsigned short max;
+  unsigned long sum;    // halved along with n before it can overflow, which keeps the mean
+  unsigned long n;
+};
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+extern const char ProfName[PROF_N][5] PROGMEM;     // 4 characters each
+
+extern void Prof_Setup( void );
+extern void Prof_Add( unsigned char r, const prof_t *start );
+extern void Prof_Get( unsigned char r, struct tagProf *p );
+
+#ifdef	__cplusplus
+}
+
+extern void Prof_Print( Print &out );       // all regions as a table
+#endif
+
+// Timer1 reads through the TEMP register shared with the handlers, the interrupts are off for the read
+static inline void
+Prof_Stamp( prof_t *p )
+{
+  unsigned char s = SREG;
+
+  cli();
+  p->t = TCNT1;
+  SREG = s;
+  p->ms = millis();
+}
+
+#define PROF_BEGIN(r) prof_t prof_ ## r; Prof_Stamp( &prof_ ## r )
+#define PROF_END(r) Prof_Add( r, &prof_ ## r )
+
+#else
+
+#define PROF_BEGIN(r)
+#define PROF_END(r)
+
+#endif	/* WITH_PROFILE */
+
+#endif	/* PROF_H */
@@ -1,25 +1,82 @@
 #include "RPM.h"
+#include "SeqLock.h"
+#include "Prof.h"
 
 #ifdef WITH_RPM
 // The pin definitions are per obfuscated Arduino pin defines -- see aka for ATMEL pin names as found on the MEGA328P spec sheet
 
 #define RPM_PIN 16	// aka PC2 (ADC2)
 
-static volatile unsigned short RPM_Cnt = 0;		// counting variable -- gets incremented on each edge of the rpm sensor , each revolution
-short int RPM_; 
-// Pin change interrupt to capture the edges of the wind speed interrupter
+/*
+  RPM from the period between the sensor pulses instead of counting them for a second.
+  Timer1 runs free at 2Mhz and is extended to 32 bits by its overflow interrupt. The pin change interrupt stamps
+  each rising edge with the timer into a small ring. RPM_Read() computes the mean period of the last RPM_EDGES
+  edges, which gives a resolution well below 1 RPM with a latency of a few revolutions. At high pulse rates, when
+  the ring spans less than RPM_MIN_SPAN, all edges since the last update are averaged instead, which is edge
+  counting with an exact time base.
+  PC2 is not the input capture pin, so the time stamp includes the interrupt latency of a few us.
+  Both handlers bump RPM_Seq, RPM_Read() copies the ring without turning interrupts off, see SeqLock.h. With
+  WITH_PROFILE every profiled handler reads TCNT1 for its time stamps and bumps RPM_Seq as well, see Prof_Add().
+*/
+#define RPM_TICKS_PER_SEC 2000000UL     // Timer1 at clk/8
+#define RPM_EDGES 8                     // ring size, power of 2
+#define RPM_MIN_SPAN ( RPM_TICKS_PER_SEC / 20 )  // below 50ms for the ring the interrupt latency jitter starts to show
+#define RPM_TIMEOUT ( 2 * RPM_TICKS_PER_SEC )   // no edge for 2 seconds is 0 RPM, below 30 RPM at 1 pulse per rev
+#define RPM_K ( 60UL * 16 * RPM_TICKS_PER_SEC / RPM_PULSES_PER_REV )   // RPM = RPM_K / period in 1/16 ticks
+
+static volatile unsigned short RPM_Ovf;                 // upper half of the time stamps
+static volatile unsigned long RPM_Edge[RPM_EDGES];      // time stamps of the last rising edges
+static volatile unsigned short RPM_EdgeCnt = 0;         // counting variable -- gets incremented on each rising edge of the rpm sensor
+seq_t RPM_Seq;
+short int RPM_;
+
+ISR(TIMER1_OVF_vect)
+{
+  PROF_BEGIN( PROF_ISR_T1OVF );
+
+  RPM_Ovf++;
+  SeqWrite( &RPM_Seq );
+  PROF_END( PROF_ISR_T1OVF );
+}
+
+// 32 bit time stamp in ticks, from a handler or inside a RPM_Seq read. A handler running in between also corrupts
+// the TEMP register used to read TCNT1, which the sequence catches as well.
+static unsigned long
+RPM_Ticks( void )
+{
+  unsigned short lo = TCNT1;
+  unsigned short hi = RPM_Ovf;
+
+  if ( ( TIFR1 & ( 1 << TOV1 )) && lo < 0x8000 )    // overflowed but not serviced yet
+    hi++;
+
+  return ( (unsigned long) hi << 16 ) | lo;
+}
+
+// Pin change interrupt to capture the edges of the rpm sensor
 ISR(PCINT1_vect)
 {
-  // check PCINT1 interrupt flags for the wind_count pin if any other pin change interrupts are used in this code
-  RPM_Cnt++;  // count every edge from the wind sensor
+  PROF_BEGIN( PROF_ISR_PCINT );
+
+  if ( PINC & ( 1 << PC2 ))         // rising edge
+  {
+    RPM_Edge[RPM_EdgeCnt & ( RPM_EDGES - 1 )] = RPM_Ticks();
+    RPM_EdgeCnt++;
+    SeqWrite( &RPM_Seq );
+  }
+  PROF_END( PROF_ISR_PCINT );
 }
 
 void RPM_Setup()
 {
-  pinMode(RPM_PIN, INPUT);    // the Windspeed count
+  pinMode(RPM_PIN, INPUT);    // the rpm sensor
+
+  TCCR1A = 0;                   // normal mode, free running
+  TCCR1B = 1 << CS11;           // clk/8
+  TIMSK1 = 1 << TOIE1;
 
   // enable the pin change interrupt for PC2, aka, A0, aka pin14
-  // Note: this enabling of the pinchange interrupt pin has to go hand in hand with the chosen wind speed pin above
+  // Note: this enabling of the pinchange interrupt pin has to go hand in hand with the chosen rpm pin above
 
   PCMSK1 |= 1 << PCINT10 ; // enable PCinterupt10 , aka PC2
   PCICR |= 1 << PCIE1; // enable PCinterupt 1 vector
@@ -29,23 +86,55 @@ void RPM_Setup()
 
 void RPM_Read()
 {
-  unsigned long t_now = 0;
-  unsigned long t_sample = 0;
-  static unsigned long t_next = 0;
+  static unsigned short prev_cnt;
+  static unsigned long prev_last;
+  static unsigned char seen = 0;      // edges since the rotation started, up to 255
+  unsigned short cnt, n;
+  unsigned long now, last, first, per;
+  unsigned char k, seq;
 
-  if ( (t_now = millis()) < t_next) // wait until next update period
+  do
   {
-    // not time yet
+    seq = SeqBegin( &RPM_Seq );
+    cnt = RPM_EdgeCnt;
+    n = cnt - prev_cnt;
+    k = min( min( seen + n, 255 ), RPM_EDGES );     // edges in the ring that belong to this rotation
+    if ( k )
+      k--;                                          // intervals between them
+    last = RPM_Edge[( cnt - 1 ) & ( RPM_EDGES - 1 )];
+    first = RPM_Edge[( cnt - 1 - k ) & ( RPM_EDGES - 1 )];
+    now = RPM_Ticks();
+  } while ( SeqRetry( &RPM_Seq, seq ));
+
+  // fast, average all edges since the last update
+  if ( n >= RPM_EDGES && seen && last - first < RPM_MIN_SPAN && last - prev_last < RPM_TIMEOUT )
+    per = ( ( last - prev_last ) << 4 ) / n;
+  else if ( k > 0 )                                 // mean period of the ring
+    per = ( ( last - first ) << 4 ) / k;
+  else
+    per = 0;
+
+  seen = min( seen + n, 255 );
+  prev_cnt = cnt;
+  prev_last = last;
+
+  if ( !seen || now - last > RPM_TIMEOUT )          // stopped, start over with the next edge
+  {
+    seen = 0;
+    RPM_ = 0;
     return;
   }
 
+  if ( per == 0 )                                   // need two edges for a period
+  {
+    RPM_ = 0;
+    return;
+  }
 
-  // disable the interrupt so we can get a two byte variable without getting interrupted
-  PCICR = 0;  // disable PCinterupt 1 vector
-  RPM_ = RPM_Cnt* 30;     // get the count from the pin change interrupt and compute rpm -- interrupt gets both edges, so only multiply by half
-  RPM_Cnt = 0;
-  t_next = t_now + SAMPLE_PER; // every second we update the display with new data
-  PCICR |= 1 << PCIE1; // enable PCinterupt 1 vector
+  // slowing down -- the time since the last edge is a lower bound for the current period
+  if ( ( ( now - last ) << 4 ) > per )
+    per = ( now - last ) << 4;
 
+  RPM_ = ( RPM_K + per / 2 ) / per;
 }
-#endif
\ No newline at end of file
+#endif
@@ -7,18 +7,20 @@
 
 #include "Arduino.h"
 #include "build_opts.h"
+#include "SeqLock.h"
 #ifdef WITH_RPM
 
 
 #ifndef RMP_H
 #define	RPM_H
-#define SAMPLE_PER 1000   // one second, this is the measure interval
+#define SAMPLE_PER 250    // the RPM is updated 4 times a second
 
 #ifdef	__cplusplus
 extern "C" {
 #endif
 
 extern short int RPM_; 
+extern seq_t RPM_Seq;         // bumped by every handler that reads TCNT1
 
 extern void RPM_Setup(void);
 extern void RPM_Read(void);
@@ -7,11 +7,13 @@
 
 /* Functions to initialzie and read the SI 7021 Relative humidity sensor device */
 
+#include "build_opts.h"
 #include "SI_7021.h"
 
 //////////////////////////////////////////// Humidity sensor SI 7021 //////////////////////
 
 #define SI7021_ADDR (0x40<<1)
+#define SI7021_MAX_SCL 400000L          // fast mode
 #define SI7021_RESET_CMD    0xFE
 #define SI7021_Convert_CMD 0xF5        // Starts a temperature and RH conversion cycle, but does not hold CLK line until complete
 #define SI7021_ReadPrevTemp_CMD 0xE0     // Read out the temperature reading from the previous conversion
@@ -23,6 +25,7 @@ enum _SI7021_READ_SM {
     SM_START = 0,
     SM_Wait_Results,
     SM_Read_Results,
+    SM_Calc_Results,
     SM_ERROR,
     SM_STOP,
     SM_IDLE,
@@ -30,6 +33,27 @@ enum _SI7021_READ_SM {
 };
 static int ThisState = SM_NOTFOUND;
 
+// Bus transaction used by the state machine -- runs in the background from the TWI interrupt
+static unsigned char SI7021_RH[2];      // msb, lsb
+static unsigned char SI7021_Temp[2];    // msb, lsb
+static i2c_txn_t SI7021_Txn = I2C_TXN( SI7021_ADDR );
+static unsigned long SI7021_t_bus;     // when the transaction was queued
+
+static void
+SI7021_Submit( void )
+{
+    SI7021_t_bus = millis();
+    i2c_submit( &SI7021_Txn );
+}
+
+// queue a command byte followed by a burst read of len bytes
+static void
+SI7021_Queue( unsigned char cmd, unsigned char *buf, unsigned char len )
+{
+    i2c_txn_read( &SI7021_Txn, cmd, buf, len );
+    SI7021_Submit();
+}
+
 struct tag_HygReadings HygReading;
 
 // See if the Device can be addressed -- Listen for the ACK on address
@@ -38,7 +62,7 @@ SI7021_init(void)
 {
     unsigned short BusErr = 0;
 	 
-	i2c_init();
+	i2c_register_device( SI7021_ADDR, min( SI7021_MAX_SCL, I2C_MAX_SCL ));
 	 
 	if ((BusErr = i2c_start( SI7021_ADDR +I2C_WRITE  )) !=0 )
   {
@@ -61,74 +85,66 @@ SI7021_startMeasure(void)
         ThisState = SM_START;
 }
 
-void
+// Steps the measure cycle, returns the ms until the next step is due or 0 when the cycle is done or the device idle.
+unsigned short
 SI7021_Read_Process(void )
 {
     static unsigned long t;
-	
-    union {
-        unsigned char bytes[2];
-        unsigned short val;
-    } ADC_RH;
+    unsigned long dt;
 
-    union {
-        unsigned char  bytes[2];
-        unsigned short val;
-    } ADC_TEMP;
+    if ( SI7021_Txn.status == I2C_BUSY )    // previous bus transaction still in progress
+    {
+        if ( millis() - SI7021_t_bus > I2C_TXN_TIMEOUT )    // a device is holding the bus
+            i2c_abort();
+        return 1;
+    }
+
+    if ( SI7021_Txn.status != I2C_OK && ThisState < SM_ERROR ) // the device failed to ack
+        ThisState = SM_ERROR;
 
     switch (ThisState)
     {
         case SM_START: // initiate the Temp and RH  conversion
-			      if ( i2c_start( SI7021_ADDR +I2C_WRITE  ) != 0) // if the device fails to ack the address
-            {
-                ThisState = SM_ERROR;
-                break;
-            }
-			      i2c_write( SI7021_Convert_CMD); 	// internal register address
-            i2c_stop();
+            SI7021_Queue( SI7021_Convert_CMD, 0, 0 );
             t = millis();
             ThisState++;
-            break;
+            return 31;
 
         case SM_Wait_Results:   // The conversion should take a maximum of 20.4 ms
-            if ((millis() - t) > 30) // wait for the result to arrive
-                ThisState++;
-            break;
+            if ( (dt = millis() - t) <= 30 ) // wait for the result to arrive
+                return 31 - dt;
+            // If conversion is not ready yet device repsonds with NACK
+            i2c_txn_read( &SI7021_Txn, 0, SI7021_RH, 2 );
+            SI7021_Txn.wlen = 0;        // plain read of the result, no command byte
+            SI7021_Submit();
+            ThisState++;
+            return 1;
 
         case SM_Read_Results:
-			      if ( i2c_start( SI7021_ADDR +I2C_READ  ) != 0) // Check for ACK-- If conversion is not ready yet device repsonds with NACK
-            {
-                ThisState = SM_ERROR;
-                break;
-            }
+            // Collect the temperature data from the last conversion
+            SI7021_Queue( SI7021_ReadPrevTemp_CMD, SI7021_Temp, 2 );
+            ThisState++;
+            return 1;
 
-            ADC_RH.bytes[1] = i2c_readAck();// read rh data msb
-            ADC_RH.bytes[0] = i2c_readNak(); // read rh data lsb
-            i2c_stop();
+        case SM_Calc_Results:
+        {
+            unsigned short adc_rh = (SI7021_RH[0] << 8) | SI7021_RH[1];
+            unsigned short adc_temp = (SI7021_Temp[0] << 8) | SI7021_Temp[1];
 
-            // Collect the temperature data from the last conversion
-			      if ( i2c_start( SI7021_ADDR + I2C_WRITE  ) != 0) // if the device fails to ack the address
-            {
-                ThisState = SM_ERROR;
-                break;
-            }
-       		  i2c_write( SI7021_ReadPrevTemp_CMD); 	// internal register address
-			      i2c_rep_start( SI7021_ADDR +I2C_READ ); // restart in Read mode now
-            ADC_TEMP.bytes[1] = i2c_readAck(); // read Temp data msb
-            ADC_TEMP.bytes[0] = i2c_readNak(); // read Temp data lsb
-            i2c_stop();
-
-            HygReading.TempC = (ADC_TEMP.val*175.72/65536) -46.85;    // Magic numbers from SI datasheet  
-            HygReading.RelHum = (ADC_RH.val*125.0/65536)-6.0;         // Magic numbers from SI datasheet
+            HygReading.TempC = (adc_temp*175.72/65536) -46.85;    // Magic numbers from SI datasheet  
+            HygReading.RelHum = (adc_rh*125.0/65536)-6.0;         // Magic numbers from SI datasheet
     
             ThisState = SM_IDLE;
             break;
+        }
 
         case SM_ERROR:
             HygReading.TempC = -302.0;   // impossible numbers
             HygReading.RelHum = 1.0; 
-			      i2c_stop();
-            ThisState++;
+            if ( SI7021_Txn.status == I2C_ERR_START )   // bus error, see i2c_recover()
+                i2c_recover();
+            SI7021_Txn.status = I2C_OK;
+            ThisState = SM_IDLE;        // try again on the next measure cycle
             break;
 
         case SM_IDLE: // park here until someone starts the process again.
@@ -140,5 +156,6 @@ SI7021_Read_Process(void )
             break;   
     }
 
+    return 0;
 }
 
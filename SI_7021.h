@@ -12,6 +12,8 @@
 #ifndef SI_7021_H
 #define	SI_7021_H
 
+#define SI7021_PERIOD 1000    // measure cycle in ms, more often warms the sensor up
+
 #ifdef	__cplusplus
 extern "C" {
 #endif
@@ -26,7 +28,7 @@ struct tag_HygReadings
 extern struct tag_HygReadings HygReading; 
 extern unsigned short SI7021_init(void);
 extern void SI7021_startMeasure(void);
-extern void SI7021_Read_Process(void );
+extern unsigned short SI7021_Read_Process(void );
 
 
 #ifdef	__cplusplus
@@ -0,0 +1,137 @@
+#include "Arduino.h"
+#include "Sched.h"
+#include <avr/sleep.h>
+
+#define TIMER0_US ( 64 / clockCyclesPerMicrosecond() )   // us per count of Timer0 at clk/64, as set up by the core
+
+static struct tagTask *Tasks;
+static unsigned char TaskCnt;
+struct tagSleepStats SleepStats;
+
+// All tasks are due right away, the statistics start over
+void
+SchedStart( struct tagTask *tasks, unsigned char n )
+{
+  unsigned long now = millis();
+  struct tagTask *t;
+
+  Tasks = tasks;
+  TaskCnt = n;
+  for ( t = tasks; t < tasks + n; t++ )
+  {
+    t->release = t->due = now;
+    t->runs = t->busy_us = 0;
+    t->max_us = t->max_late = t->overruns = 0;
+  }
+  memset( &SleepStats, 0, sizeof( SleepStats ));
+}
+
+/*
+  Runs the tasks that are due, one pass over the table. Times are compared by their difference so the millis()
+  wrap after 49 days doesn't matter.
+*/
+void
+SchedRun( void )
+{
+  struct tagTask *t;
+  unsigned long now, us;
+  unsigned short wait;
+
+  for ( t = Tasks; t < Tasks + TaskCnt; t++ )
+  {
+    now = millis();
+    if ( (long) ( now - t->due ) < 0 )
+      continue;
+
+    if ( now - t->due > t->max_late )
+      t->max_late = min( now - t->due, 0xffff );
+
+    us = micros();
+    wait = t->run();
+    us = micros() - us;
+
+    t->runs++;
+    t->busy_us += us;
+    if ( us > t->max_us )
+      t->max_us = min( us, 0xffff );
+
+    now = millis();
+    if ( wait != SCHED_DONE )
+    {
+      t->due = now + wait;
+      continue;
+    }
+
+    t->release += t->period;
+    if ( (long) ( now - t->release ) > 0 )    // the next period has started already, skip to now
+    {
+      t->overruns++;
+      t->release = now;
+    }
+    t->due = t->release;
+  }
+}
+
+// The task runs in ms, on the next pass for 0, and its period starts over from there
+void
+SchedWake( struct tagTask *task, unsigned short ms )
+{
+  task->release = task->due = millis() + ms;
+}
+
+// Takes effect with the next period
+void
+SchedPeriod( struct tagTask *task, unsigned short period )
+{
+  task->period = period;
+}
+
+// When the task due next has to run
+static unsigned long
+SchedNext( void )
+{
+  struct tagTask *t;
+  unsigned long next = Tasks->due;
+
+  for ( t = Tasks + 1; t < Tasks + TaskCnt; t++ )
+    if ( (long) ( t->due - next ) < 0 )
+      next = t->due;
+  return next;
+}
+
+/*
+  Sleeps in idle mode until the next task is due. The time is checked with interrupts off, sei() enables them only
+  after the following instruction, so an interrupt arriving after the check still wakes up the sleep.
+  The wake latency is the time since the Timer0 overflow that moved millis() on, read from the timer count.
+*/
+void
+SchedIdle( void )
+{
+  unsigned long next = SchedNext();
+  unsigned long us;
+  unsigned short lat;
+
+  if ( (long) ( millis() - next ) >= 0 )
+    return;
+
+  us = micros();
+  set_sleep_mode( SLEEP_MODE_IDLE );
+  for ( ;; )
+  {
+    cli();
+    if ( (long) ( millis() - next ) >= 0 )
+      break;
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+  lat = TCNT0 * TIMER0_US;
+  sei();
+
+  SleepStats.sleep_us += micros() - us;
+  SleepStats.naps++;
+  SleepStats.wake_us += lat;
+  if ( lat > SleepStats.wake_max )
+    SleepStats.wake_max = lat;
+}
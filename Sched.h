@@ -0,0 +1,60 @@
+/*
+ * File:   Sched.h
+ * Author: Gary Stofer
+ *
+ * Cooperative deadline scheduler for the main loop.
+ *
+ * Every task has its own period and the time it is due next. SchedRun() calls the tasks that are due, in table
+ * order, and leaves the others alone. A task returns 0 when its work for the period is done, it is due again one
+ * period after the start of the period, so the period doesn't drift with the run time or with late starts. A task in
+ * the middle of a multi step job, a sensor waiting for its conversion, returns the ms until it wants to run again
+ * instead. Nothing preempts a task, a task that blocks delays all others.
+ *
+ * Per task the scheduler records the run count, the execution time, how late the task started compared to when it
+ * was due, and the overruns, periods that were over before the work of the period was done.
+ *
+ * SchedIdle() puts the CPU to sleep until the next task is due. Idle mode stops only the CPU clock, the timers, the
+ * ADC, the I2C bus and the pin change interrupts keep running and any interrupt wakes it up. The Timer0 tick of
+ * millis() is one of them, the CPU checks the time every 1.024ms and goes back to sleep when nothing is due yet.
+ */
+
+#ifndef SCHED_H
+#define	SCHED_H
+
+#define SCHED_DONE 0        // task return, done for this period
+
+struct tagTask
+{
+  unsigned short (*run)( void );  // returns SCHED_DONE or the ms until the next step
+  unsigned short period;          // in ms
+  // kept by the scheduler
+  unsigned long release;          // start of the current period
+  unsigned long due;              // next run
+  unsigned long runs;
+  unsigned long busy_us;          // execution time of all runs, wraps after 71 minutes
+  unsigned short max_us;          // longest run
+  unsigned short max_late;        // most ms a run started after it was due, the jitter
+  unsigned short overruns;
+};
+
+// an entry of the task table, the scheduler keeps the rest
+#define SCHED_TASK( run, period ) { run, period, 0, 0, 0, 0, 0, 0, 0 }
+
+// time spent in SchedIdle()
+struct tagSleepStats
+{
+  unsigned long sleep_us;         // asleep, with the interrupt handlers in between, wraps after 71 minutes
+  unsigned long naps;             // idle periods, each one or more sleeps until a task was due
+  unsigned long wake_us;          // sum of the wake latencies
+  unsigned short wake_max;        // most us from the timer tick that made a task due until the scheduler ran again
+};
+
+extern struct tagSleepStats SleepStats;
+
+extern void SchedStart( struct tagTask *tasks, unsigned char n );
+extern void SchedRun( void );
+extern void SchedIdle( void );
+extern void SchedWake( struct tagTask *task, unsigned short ms );
+extern void SchedPeriod( struct tagTask *task, unsigned short period );
+
+#endif	/* SCHED_H */
@@ -0,0 +1,47 @@
+/*
+ * File:   SeqLock.h
+ * Author: Gary Stofer
+ *
+ * Hand off of data from an interrupt handler to the main loop without turning interrupts or interrupt sources off.
+ *
+ * The handler updates the data and then bumps a sequence byte with SeqWrite(). The main loop takes the sequence with
+ * SeqBegin(), copies the data and repeats the copy for as long as SeqRetry() says that a handler ran in between.
+ * This relies on AVR interrupt handlers not nesting, the main loop sees the data either before or after a complete
+ * handler, and a single byte load of the sequence can't tear. Several handlers may share one sequence.
+ *
+ * The shared data must be volatile and only the handlers may write it. Counters are left free running, the main loop
+ * keeps the value it saw last and works with the difference, so no count gets lost by resetting them from main.
+ */
+
+#ifndef SEQLOCK_H
+#define	SEQLOCK_H
+
+typedef volatile unsigned char seq_t;
+
+// main loop: start or restart a copy of the shared data
+static inline unsigned char
+SeqBegin( seq_t *seq )
+{
+  unsigned char s = *seq;
+
+  __asm__ __volatile__ ( "" ::: "memory" );
+  return s;
+}
+
+// main loop: true when a handler changed the data during the copy, the copy has to be repeated
+static inline unsigned char
+SeqRetry( seq_t *seq, unsigned char start )
+{
+  __asm__ __volatile__ ( "" ::: "memory" );
+  return *seq != start;
+}
+
+// interrupt handler: after the shared data has been updated
+static inline void
+SeqWrite( seq_t *seq )
+{
+  __asm__ __volatile__ ( "" ::: "memory" );
+  *seq = *seq + 1;
+}
+
+#endif	/* SEQLOCK_H */
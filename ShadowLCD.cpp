@@ -0,0 +1,175 @@
+/*
+File:   ShadowLCD.cpp
+Author: Gary Stofer
+
+Each character sent over the 4 bit interface costs two nibble strobes and ~40us of busy time, a cursor move as much
+again. A screen update that reprints the same label and value used to cost all 16 characters plus the padding and
+the cursor moves, now it is only the digits that changed.
+*/
+
+#include "ShadowLCD.h"
+#include <avr/pgmspace.h>
+
+static const unsigned long Pow10[10] PROGMEM = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+ShadowLCD::ShadowLCD( LiquidCrystal &hw ) : Hw( hw )
+{
+  memset( Frame, ' ', LCD_SIZE );
+  Dirty = 0;
+  Col = Row = 0;
+  HwPos = LCD_SIZE;
+}
+
+// initialize the display, it comes up blank with the cursor at home same as the frame
+void
+ShadowLCD::begin( void )
+{
+  Hw.begin( LCD_COLS, LCD_ROWS );
+  memset( Frame, ' ', LCD_SIZE );
+  Dirty = 0;
+  Col = Row = 0;
+  HwPos = 0;
+}
+
+// no command to the display, the frame is rewritten from the start
+void
+ShadowLCD::home( void )
+{
+  Col = Row = 0;
+}
+
+// blanks the frame without the 2ms clear command and the flicker that goes with it
+void
+ShadowLCD::clear( void )
+{
+  uint8_t i;
+
+  for ( i = 0; i < LCD_SIZE; i++ )
+  {
+    if ( Frame[i] != ' ' )
+    {
+      Frame[i] = ' ';
+      Dirty |= 1U << i;
+    }
+  }
+  home();
+}
+
+void
+ShadowLCD::setCursor( uint8_t col, uint8_t row )
+{
+  Col = col;
+  Row = row;
+}
+
+size_t
+ShadowLCD::write( uint8_t c )
+{
+  uint8_t i;
+
+  if ( Col >= LCD_COLS || Row >= LCD_ROWS )   // off the display
+    return 1;
+
+  i = Row * LCD_COLS + Col;
+  if ( Frame[i] != c )
+  {
+    Frame[i] = c;
+    Dirty |= 1U << i;
+  }
+  Col++;
+  return 1;
+}
+
+// Characters of v / 10^dec with sign and decimal point, one digit at least before the point
+uint8_t
+ShadowLCD::fixedLen( long v, uint8_t dec )
+{
+  unsigned long u = v < 0 ? -v : v;
+  uint8_t n;
+
+  for ( n = dec + 1; n < 10 && u >= pgm_read_dword( &Pow10[n] ); n++ )
+    ;
+  return ( v < 0 ) + n + ( dec ? 1 : 0 );
+}
+
+/*
+  Prints a scaled integer, v / 10^dec, right aligned in a field of width characters. The digits come from subtracting
+  powers of 10, there is no float math and, as long as the number fits, no division. Decimals that don't fit are
+  rounded off, a number that doesn't fit without decimals shows as a row of '*'. Returns width.
+  Rounding off an integer that was rounded before can be off by one in the last digit, callers that have the exact
+  value check with fixedLen() and scale it with fewer decimals instead.
+*/
+uint8_t
+ShadowLCD::printFixed( long v, uint8_t dec, uint8_t width )
+{
+  unsigned long u, p;
+  uint8_t neg, n, len, i;
+  char d;
+
+  neg = v < 0;
+  u = neg ? -v : v;
+
+  for ( ;; )
+  {
+    for ( n = dec + 1; n < 10 && u >= pgm_read_dword( &Pow10[n] ); n++ )   // digits, one at least before the point
+      ;
+    len = neg + n + ( dec ? 1 : 0 );
+    if ( len <= width || dec == 0 )
+      break;
+    u = ( u + 5 ) / 10;                 // round off a decimal
+    dec--;
+    if ( u == 0 )
+      neg = 0;
+  }
+
+  if ( len > width )
+  {
+    for ( i = 0; i < width; i++ )
+      write( '*' );
+    return width;
+  }
+
+  for ( i = len; i < width; i++ )
+    write( ' ' );
+  if ( neg )
+    write( '-' );
+
+  while ( n-- )
+  {
+    p = pgm_read_dword( &Pow10[n] );
+    for ( d = '0'; u >= p; d++ )
+      u -= p;
+    write( d );
+    if ( n == dec && dec )
+      write( '.' );
+  }
+  return width;
+}
+
+void
+ShadowLCD::refresh( void )
+{
+  uint8_t i;
+
+  for ( i = 0; Dirty; i++, Dirty >>= 1 )
+  {
+    if ( !( Dirty & 1 ))
+      continue;
+
+    if ( HwPos != i )
+      Hw.setCursor( i % LCD_COLS, i / LCD_COLS );
+    Hw.write( Frame[i] );
+
+    // the display cursor stays on the line, past the last column it points to an invisible address
+    HwPos = ( i % LCD_COLS == LCD_COLS - 1 ) ? LCD_SIZE : i + 1;
+  }
+}
+
+void
+ShadowLCD::invalidate( void )
+{
+  Dirty = ( 1UL << LCD_SIZE ) - 1;
+  HwPos = LCD_SIZE;
+}
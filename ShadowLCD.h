@@ -0,0 +1,50 @@
+/*
+ * File:   ShadowLCD.h
+ * Author: Gary Stofer
+ *
+ * RAM copy of the 8x2 character display. The screens print into the copy, refresh() sends only the characters that
+ * changed since the last refresh to the HD44780. Writing past the end of a line is dropped, the display doesn't show
+ * those characters anyhow.
+ */
+
+#include "Arduino.h"
+#include <LiquidCrystal.h>
+
+#ifndef SHADOWLCD_H
+#define	SHADOWLCD_H
+
+#define LCD_COLS 8
+#define LCD_ROWS 2
+#define LCD_SIZE ( LCD_COLS * LCD_ROWS )
+
+#if LCD_SIZE > 16
+#error "the dirty mask of ShadowLCD holds 16 characters"
+#endif
+
+class ShadowLCD : public Print
+{
+  public:
+    ShadowLCD( LiquidCrystal &hw );
+
+    void begin( void );
+    void home( void );
+    void clear( void );
+    void setCursor( uint8_t col, uint8_t row );
+    virtual size_t write( uint8_t c );
+    using Print::write;
+
+    uint8_t printFixed( long v, uint8_t dec, uint8_t width );   // v / 10^dec right aligned in width characters
+    static uint8_t fixedLen( long v, uint8_t dec );             // characters printFixed() needs for v
+
+    void refresh( void );           // send the changed characters to the display
+    void invalidate( void );        // display content unknown, send everything with the next refresh
+
+  private:
+    LiquidCrystal &Hw;
+    uint8_t Frame[LCD_SIZE];
+    uint16_t Dirty;                 // one bit per character of Frame not yet on the display
+    uint8_t Col, Row;               // print position
+    uint8_t HwPos;                  // cursor position of the display as index into Frame, LCD_SIZE when unknown
+};
+
+#endif	/* SHADOWLCD_H */
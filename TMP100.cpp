@@ -8,11 +8,13 @@ Created on JAN 18, 2016, 5.25 PM
 
 /* Functions to initialzie and read the TMP100 temperatur sensor  */
 
+#include "build_opts.h"
 #include "TMP100.h"
 
 //////////////////////////////////////////// Humidity sensor SI 7021 //////////////////////
 
 #define TMP100_ADDR 0x94		// This is with ADD0 strapped high and ADD1 pulled low	
+#define TMP100_MAX_SCL 400000L	// fast mode
 #define TMP100_Temp_Reg 0x00
 #define TMP100_Ctrl_Reg 0x01
 #define TMP100_12BitConfig 0x60
@@ -34,13 +36,26 @@ static int ThisState = SM_NOTFOUND;
 float TMP100_TempC;
 static unsigned const char conf_reg = TMP100_12BitConfig | TMP100_ShutdownBit;
 
+// Bus transaction used by the state machine -- runs in the background from the TWI interrupt
+static unsigned char TMP100_Res[2];		// msb, lsb
+static i2c_txn_t TMP100_Txn = I2C_TXN( TMP100_ADDR );
+static unsigned long TMP100_t_bus;		// when the transaction was queued
+
+// queue the transaction as set up by i2c_txn_read() or i2c_txn_write()
+static void
+TMP100_Submit( void )
+{
+	TMP100_t_bus = millis();
+	i2c_submit( &TMP100_Txn );
+}
+
 // See if the Device can be addressed -- Listen for the ACK on address
 unsigned short
 TMP100_init(void)
 {
 	unsigned short BusErr = 0;
 
-	i2c_init();
+	i2c_register_device( TMP100_ADDR, min( TMP100_MAX_SCL, I2C_MAX_SCL ));
 
 	
 
@@ -68,65 +83,58 @@ TMP100_startMeasure(void)
 	ThisState = SM_START;
 }
 
-void
+// Steps the measure cycle, returns the ms until the next step is due or 0 when the cycle is done or the device idle.
+unsigned short
 TMP100_Read_Process(void )
 {
 	static unsigned long t;
+	unsigned long dt;
+
+	if ( TMP100_Txn.status == I2C_BUSY )	// previous bus transaction still in progress
+	{
+		if ( millis() - TMP100_t_bus > I2C_TXN_TIMEOUT )	// a device is holding the bus
+			i2c_abort();
+		return 1;
+	}
 
-	union {
-		unsigned char  bytes[2];
-		unsigned short val;
-	} ADC_TEMP;
+	if ( TMP100_Txn.status != I2C_OK && ThisState < SM_ERROR ) // the device failed to ack
+		ThisState = SM_ERROR;
 
 	switch (ThisState)
 	{
 	case SM_START: // initiate the Temp and RH  conversion
-		if ( i2c_start( TMP100_ADDR + I2C_WRITE  ) != 0) // if the device fails to ack the address
-		{
-			ThisState = SM_ERROR;
-			break;
-		}
-
-		i2c_write( TMP100_Ctrl_Reg);
-		i2c_write( conf_reg | TMP100_OneShotBit );
-		i2c_stop();
+		i2c_txn_write( &TMP100_Txn, TMP100_Ctrl_Reg, conf_reg | TMP100_OneShotBit );
+		TMP100_Submit();
 		t = millis();
 		ThisState++;
-		break;
+		return 401;
 
 	case SM_Wait_Results:   // The conversion should take 320ms at 12 bit res
-		if ((millis() - t) > 400) // wait for the result to arrive
-		{
-			ThisState++;
-
-		}
-		break;
+		if ( (dt = millis() - t) <= 400 ) // wait for the result to arrive
+			return 401 - dt;
+		i2c_txn_read( &TMP100_Txn, TMP100_Temp_Reg, TMP100_Res, 2 );
+		TMP100_Submit();
+		ThisState++;
+		return 1;
 
 	case SM_Read_Results:
-		if ( i2c_start( TMP100_ADDR + I2C_WRITE  ) != 0) // Check for ACK-- If conversion is not ready yet device repsonds with NACK
-		{
-			ThisState = SM_ERROR;
-			break;
-		}
-
-		i2c_write( TMP100_Temp_Reg);			 // switch to the temp registor for the following reads
-		i2c_rep_start( TMP100_ADDR + I2C_READ ); // restart in Read mode
-
-		ADC_TEMP.bytes[1] = i2c_readAck(); // read Temp data msb
-		ADC_TEMP.bytes[0] = i2c_readNak(); // read Temp data lsb
-		i2c_stop();
+	{
+		unsigned short adc_temp = (TMP100_Res[0] << 8) | TMP100_Res[1];
 
-		ADC_TEMP.val >>= 4;			// lower 4 bits are unused in 12 bit mode
-		TMP100_TempC = ADC_TEMP.val * 0.0625;    // resolution in 12 bit mode
+		adc_temp >>= 4;			// lower 4 bits are unused in 12 bit mode
+		TMP100_TempC = adc_temp * 0.0625;    // resolution in 12 bit mode
 
 
 		ThisState = SM_IDLE;
 		break;
+	}
 
 	case SM_ERROR:
 		TMP100_TempC = -303.0;   // impossible numbers
-		i2c_stop();
-		ThisState++;
+		if ( TMP100_Txn.status == I2C_ERR_START )	// bus error, see i2c_recover()
+			i2c_recover();
+		TMP100_Txn.status = I2C_OK;
+		ThisState = SM_IDLE;		// try again on the next measure cycle
 		break;
 
 	case SM_IDLE: // park here until someone starts the process again.
@@ -138,5 +146,6 @@ TMP100_Read_Process(void )
 		break;
 	}
 
+	return 0;
 }
 
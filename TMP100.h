@@ -12,6 +12,8 @@
 #ifndef TMP100_H
 #define	TMP100_H
 
+#define TMP100_PERIOD 1000    // measure cycle in ms, the conversion takes 320ms
+
 #ifdef	__cplusplus
 extern "C" {
 #endif
@@ -19,7 +21,7 @@ extern "C" {
 extern float TMP100_TempC; 
 extern unsigned short TMP100_init(void);
 extern void TMP100_startMeasure(void);
-extern void TMP100_Read_Process(void );
+extern unsigned short TMP100_Read_Process(void );
 
 
 #ifdef	__cplusplus
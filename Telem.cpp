@@ -0,0 +1,204 @@
+#include "Telem.h"
+
+#ifdef WITH_TELEMETRY
+
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+#include "BMP085_baro.h"
+#include "SI_7021.h"
+#include "TMP100.h"
+#include "Wind.h"
+#include "RPM.h"
+#include "Sched.h"
+#include "Mem.h"
+#include "Prof.h"
+
+#define TELEM_MASK ( TELEM_BUF - 1 )
+
+/*
+  The main loop moves the head once a whole frame is in the ring, the handler sends from the tail and moves it on.
+  Each index is written from one side only and a byte can't tear, no interrupts need to be turned off. One byte of
+  the ring stays unused so a full ring can be told from an empty one.
+*/
+static unsigned char Telem_Buf[TELEM_BUF];
+static volatile unsigned char Telem_Head, Telem_Tail;
+static unsigned char Telem_Seq;
+static unsigned short Telem_Drops;
+#ifdef WITH_PROFILE
+static unsigned char Telem_ProfNext = PROF_N;     // next region of the dump, PROF_N when there is none
+#endif
+
+ISR(USART_UDRE_vect)
+{
+  unsigned char t = Telem_Tail;
+
+  if ( t != Telem_Head )
+  {
+    UDR0 = Telem_Buf[t];
+    t = ( t + 1 ) & TELEM_MASK;
+    Telem_Tail = t;
+  }
+  if ( t == Telem_Head )
+    UCSR0B &= ~( 1 << UDRIE0 );     // all sent, Telem_Send() turns it back on
+}
+
+// 8N1 at TELEM_BAUD, transmit only. Double speed gives the closer divisor, the same as Serial.begin() picks.
+void
+Telem_Setup( void )
+{
+  UCSR0A = 1 << U2X0;
+  UBRR0 = ( F_CPU / 4 / TELEM_BAUD - 1 ) / 2;
+  UCSR0C = ( 1 << UCSZ01 ) | ( 1 << UCSZ00 );
+  UCSR0B = 1 << TXEN0;
+}
+
+static unsigned char
+Telem_Room( void )
+{
+  return ( Telem_Tail - Telem_Head - 1 ) & TELEM_MASK;
+}
+
+// payloads are put together byte by byte, little endian whatever the compiler makes of a struct
+static unsigned char *
+Put16( unsigned char *p, unsigned short v )
+{
+  *p++ = v;
+  *p++ = v >> 8;
+  return p;
+}
+
+static unsigned char *
+Put32( unsigned char *p, unsigned long v )
+{
+  p = Put16( p, v );
+  return Put16( p, v >> 16 );
+}
+
+unsigned char
+Telem_Send( unsigned char type, const void *payload, unsigned char len )
+{
+  const unsigned char *p = (const unsigned char *) payload;
+  unsigned char h = Telem_Head;
+  unsigned char crc = 0;
+  unsigned char head[TELEM_HEAD];
+  unsigned short ms = millis();
+  unsigned char i;
+
+  if ( Telem_Room() < len + TELEM_OVERHEAD )
+  {
+    Telem_Drops++;
+    return 0;
+  }
+
+  head[0] = TELEM_SYNC;
+  head[1] = type;
+  head[2] = len;
+  head[3] = Telem_Seq++;
+  Put16( head + 4, ms );
+  for ( i = 0; i < TELEM_HEAD + len; i++ )
+  {
+    unsigned char c = i < TELEM_HEAD ? head[i] : p[i - TELEM_HEAD];
+
+    if ( i )
+      crc = _crc8_ccitt_update( crc, c );
+    Telem_Buf[h] = c;
+    h = ( h + 1 ) & TELEM_MASK;
+  }
+  Telem_Buf[h] = crc;
+  Telem_Head = ( h + 1 ) & TELEM_MASK;
+  UCSR0B |= 1 << UDRIE0;
+  return 1;
+}
+
+void
+Telem_Baro( void )
+{
+  float v[2] = { BaroReading.TempC, BaroReading.BaromhPa };
+
+  Telem_Send( TELEM_BARO, v, sizeof( v ));
+}
+
+void
+Telem_Hygro( void )
+{
+  float v[2] = { HygReading.TempC, HygReading.RelHum };
+
+  Telem_Send( TELEM_HYGRO, v, sizeof( v ));
+}
+
+void
+Telem_Temp( void )
+{
+  Telem_Send( TELEM_TEMP, &TMP100_TempC, sizeof( TMP100_TempC ));
+}
+
+#ifdef WITH_WIND
+void
+Telem_Wind( void )
+{
+  unsigned char v[3];
+
+  v[0] = WindSpdMPH;
+  Put16( v + 1, WindDir );
+  Telem_Send( TELEM_WIND, v, sizeof( v ));
+}
+#endif
+
+#ifdef WITH_RPM
+void
+Telem_RPM( void )
+{
+  Telem_Send( TELEM_RPM, &RPM_, sizeof( RPM_ ));
+}
+#endif
+
+void
+Telem_Vbus( float v )
+{
+  Telem_Send( TELEM_VBUS, &v, sizeof( v ));
+}
+
+void
+Telem_Status( void )
+{
+  unsigned char v[14], *p = v;
+
+  p = Put32( p, millis() );
+  p = Put32( p, SleepStats.sleep_us );
+  p = Put16( p, Mem_Free() );
+  p = Put16( p, Mem_MinFree() );
+  Put16( p, Telem_Drops );
+  Telem_Send( TELEM_STATUS, v, sizeof( v ));
+}
+
+void
+Telem_Dump( void )
+{
+#ifdef WITH_PROFILE
+  Telem_ProfNext = 0;
+#endif
+}
+
+// Sends the regions of a profile dump that fit into the ring, the rest on the next call
+void
+Telem_Poll( void )
+{
+#ifdef WITH_PROFILE
+  struct tagProf prof;
+  unsigned char v[13], *p;
+
+  while ( Telem_ProfNext < PROF_N && Telem_Room() >= sizeof( v ) + TELEM_OVERHEAD )
+  {
+    Prof_Get( Telem_ProfNext, &prof );
+    p = v;
+    *p++ = Telem_ProfNext++;
+    p = Put16( p, prof.min );
+    p = Put16( p, prof.max );
+    p = Put32( p, prof.sum );
+    Put32( p, prof.n );
+    Telem_Send( TELEM_PROF, v, sizeof( v ));
+  }
+#endif
+}
+
+#endif	/* WITH_TELEMETRY */
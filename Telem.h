@@ -0,0 +1,80 @@
+/*
+ * File:   Telem.h
+ * Author: Gary Stofer
+ *
+ * Binary telemetry over the serial port, built in with WITH_TELEMETRY in build_opts.h.
+ *
+ * Every reading goes out as a frame as soon as its measure cycle is done, at the rate of its sensor and not only at
+ * the display update. A frame is
+ *	TELEM_SYNC, type, length of the payload, sequence number, time stamp, payload, CRC-8
+ * The time stamp is the low 16 bits of millis(), the sequence number counts every frame that was queued, a gap tells
+ * the receiver that frames got lost on the line. The CRC-8 is the CCITT one of avr-libc, polynomial 0x07 and 0 to
+ * start with, over everything after the sync byte. Multi byte values are little endian, floats in IEEE 754 single
+ * precision as the AVR has them. tools/telem_decode.c turns the stream into CSV on the PC.
+ *
+ * The frames are queued in a ring buffer and sent by the UART data register empty interrupt, queuing never waits for
+ * the line. A frame that doesn't fit into the ring is dropped as a whole and counted in the status frame, the
+ * sequence number isn't spent on it. The frames are queued from the main loop only, the handler only takes them out.
+ * The serial port belongs to this module, Serial of the Arduino core must not be used with it, its handler of the
+ * same interrupt would clash.
+ */
+
+#ifndef TELEM_H
+#define	TELEM_H
+
+#include "Arduino.h"
+#include "build_opts.h"
+
+#define TELEM_SYNC 0xa5
+#define TELEM_HEAD 6            // sync, type, length, sequence and time stamp
+#define TELEM_OVERHEAD ( TELEM_HEAD + 1 )
+#define TELEM_BUF 128           // ring buffer, a power of 2 up to 256
+#define TELEM_PER 16            // ms, how often the telemetry task looks for new bus voltage results
+#define TELEM_STATUS_PER 1000
+
+// frame types and their payloads
+enum {
+  TELEM_BARO = 1,       // float temperature in C, float station pressure in hPa
+  TELEM_HYGRO,          // float temperature in C, float relative humidity in %
+  TELEM_TEMP,           // float TMP100 temperature in C
+  TELEM_WIND,           // unsigned char speed in MPH, short direction in degrees
+  TELEM_RPM,            // short RPM
+  TELEM_VBUS,           // float bus voltage
+  TELEM_STATUS,         // unsigned long millis(), unsigned long us asleep, unsigned short SRAM free, least free, dropped frames
+  TELEM_PROF            // unsigned char region, unsigned short min, max, unsigned long sum, n, see Prof.h
+};
+
+#ifdef WITH_TELEMETRY
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+extern void Telem_Setup( void );
+extern unsigned char Telem_Send( unsigned char type, const void *payload, unsigned char len );  // 0 when dropped
+extern void Telem_Baro( void );
+extern void Telem_Hygro( void );
+extern void Telem_Temp( void );
+extern void Telem_Wind( void );
+extern void Telem_RPM( void );
+extern void Telem_Vbus( float v );
+extern void Telem_Status( void );
+extern void Telem_Dump( void );         // queues the profile, Telem_Poll() sends it as the ring has room
+extern void Telem_Poll( void );
+
+#ifdef	__cplusplus
+}
+#endif
+
+#else
+
+// the readings are sent from the tasks, without the telemetry there is nothing to do
+static inline void Telem_Baro( void ) {}
+static inline void Telem_Hygro( void ) {}
+static inline void Telem_Temp( void ) {}
+static inline void Telem_Wind( void ) {}
+static inline void Telem_RPM( void ) {}
+
+#endif	/* WITH_TELEMETRY */
+
+#endif	/* TELEM_H */
@@ -1,6 +1,9 @@
 #include "Wind.h"
+#include "ADC_Sampler.h"
+#include "SeqLock.h"
+#include "Prof.h"
 #include <avr/wdt.h>
-#include <LiquidCrystal.h>
+#include "ShadowLCD.h"
 #include <EEPROM.h>
 
 #ifdef WITH_WIND
@@ -9,7 +12,8 @@
 #define WIND_SPEED_PIN 16	// aka PC2 (ADC2)
 #define WIND_DIR_ADC 6		// ADC6
 
-#define WIND_GUST_PER ( 10 * 60000/ WIND_SAMPLE_PER )   // that is 10 minutes
+#define WIND_SEC_N ( 2 * 60000 / WIND_SAMPLE_PER )     // 2 minutes of samples
+#define WIND_MIN_SAMPLES ( 60000 / WIND_SAMPLE_PER )    // samples per minute
 
 #define ANEMO_CONST	(2.5)		// For Vortex/Inspeed wind cups 
 #define ANEMO_COUNT_Rev	16	// For high fidelity opto interrupter pickup with 8 fingers
@@ -21,21 +25,70 @@ struct tagCalData
   int WDir_offs;
 } WindCal = {70, 660, 0};
 
-// array to keep 10 minutes of wind data for gust and average calculations
-static unsigned char Wind_Gust[WIND_GUST_PER];
-static volatile unsigned short WindCnt = 0;
+// Wind history in two tiers -- every sample for the last 2 minutes and a summary for each of the last 60 minutes.
+// That is 420 bytes for an hour instead of 600 bytes for 10 minutes of samples.
+static unsigned char Wind_Sec[WIND_SEC_N];
+static struct tagWindMinute Wind_Min[WIND_HIST_MIN];
+static struct tagWindMinute Wind_Cur;          // the minute in progress
+static unsigned char Wind_CurSecs;             // samples in Wind_Cur
+static unsigned char SecNdx, SecValid;         // next slot and samples in Wind_Sec
+static unsigned char MinNdx, MinValid;         // next slot and minutes in Wind_Min
+static unsigned short Wind_Sum2;               // sum over Wind_Sec
+
+// Speed weighted direction vectors, east and north components summed over the minute with sin/cos scaled to 255.
+// The full minutes keep their sums / WIND_VEC_DIV to fit a short.
+#define WIND_VEC_DIV 240
+struct tagWindVec
+{
+  short e, n;
+};
+static struct tagWindVec Wind_Vec[10];          // the last 10 full minutes
+static long Wind_CurE, Wind_CurN;               // the minute in progress
+static long Wind_Vec1E, Wind_Vec1N;             // the last full minute
+static long Wind_Vec9E, Wind_Vec9N;             // the last 9 full minutes
+static struct tagWindVec Wind_Vec10th;          // the minute before those
+static unsigned short Wind_Sum1;                // speed sum of the last full minute
+static struct tagWindMinute Wind_2nd;           // the minute before that
+
+// sin() for whole degrees 0..90, scaled to 255
+static const unsigned char Wind_Sin[91] PROGMEM = {
+    0,   4,   9,  13,  18,  22,  27,  31,  35,  40,  44,  49,  53,  57,  62,  66,
+   70,  75,  79,  83,  87,  91,  96, 100, 104, 108, 112, 116, 120, 124, 127, 131,
+  135, 139, 143, 146, 150, 153, 157, 160, 164, 167, 171, 174, 177, 180, 183, 186,
+  190, 192, 195, 198, 201, 204, 206, 209, 211, 214, 216, 219, 221, 223, 225, 227,
+  229, 231, 233, 235, 236, 238, 240, 241, 243, 244, 245, 246, 247, 248, 249, 250,
+  251, 252, 253, 253, 254, 254, 254, 255, 255, 255, 255
+};
+
+// Totals over the 9 full minutes before the current one and the minute before those, which is still partly
+// inside the 10 minute window. Updated once a minute.
+static unsigned long Wind_Sum9;
+static unsigned short Wind_Cnt9;
+static unsigned char Wind_Gust9;
+static struct tagWindMinute Wind_10th;
+static volatile unsigned short WindCnt = 0;   // free running, WindRead() works with the difference
+static seq_t WindSeq;
 
 // Globals for reporing the wind data
 unsigned char WindGustMPH;
 unsigned char WindSpdMPH;
 unsigned char WindAvgMPH;
+unsigned char WindAvg2MPH;
+unsigned char WindAvgHourMPH;
+unsigned char WindGustHourMPH;
+short WindDir2, WindDir10;              // mean direction, -1 when calm
+unsigned char WindSteady2, WindSteady10;
 long WindDir;    // needs to be long for overflow protection in math
 
 // Pin change interrupt to capture the edges of the wind speed interrupter
 ISR(PCINT1_vect)
 {
+  PROF_BEGIN( PROF_ISR_PCINT );
+
   // check PCINT1 interrupt flags for the wind_count pin if any other pin change interrupts are used in this code
   WindCnt++;  // count every edge from the wind sensor
+  SeqWrite( &WindSeq );
+  PROF_END( PROF_ISR_PCINT );
 }
 
 void WindSetup()
@@ -50,13 +103,17 @@ void WindSetup()
 
   // Read from eeprom
   // TODO: this needs to go further out in scope if the EEPROM is used to store other setup related items such as metric/imperial display etc
-  EEPROM.get(2, WindCal);
+  struct tagCalData cal;
 
+  EEPROM.get(2, cal);
+  if ( cal.WDir_min >= 0 && cal.WDir_max > cal.WDir_min )   // an erased EEPROM reads all -1, keep the defaults until calibrated
+    WindCal = cal;
 }
 
 extern unsigned char ShortPressCnt;
 extern unsigned char EncoderCnt;        // decalared unsigned for this modules use
-extern LiquidCrystal lcd;
+extern void EncoderPoll(void);
+extern ShadowLCD lcd;
 
 void
 WindDirCal( void )
@@ -73,7 +130,8 @@ WindDirCal( void )
 
   while ( !ShortPressCnt )
   {
-    adc_val = analogRead(WIND_DIR_ADC);// read the vane position
+    EncoderPoll();
+    adc_val = ADC_Result(WIND_DIR_ADC) >> ( ADC_RES_BITS - 10 );// read the vane position, the calibration is kept in 10 bit units
 
     if ( adc_val > WindCal.WDir_max)
       WindCal.WDir_max = adc_val;
@@ -89,6 +147,7 @@ WindDirCal( void )
     lcd.print("Max ");
     lcd.print(WindCal.WDir_max);
     lcd.print("   ");
+    lcd.refresh();
     wdt_reset();
   }
 
@@ -106,6 +165,7 @@ WindDirCal( void )
   while ( !ShortPressCnt )
   {
     wdt_reset();
+    EncoderPoll();
 
     if (  EncoderCnt == 0 && p == 255)    // to continue past 255
       off = 255;
@@ -128,6 +188,7 @@ WindDirCal( void )
     lcd.print(" ");
     lcd.print(char(223)); // degree symbol
     lcd.print("     ");   // fill to end of line
+    lcd.refresh();
 
 
 
@@ -138,66 +199,258 @@ WindDirCal( void )
 }
 
 
-void WindRead()
+// Returns the summary of the full minute the given number of minutes ago, 1 is the last full minute.
+// Returns 0 if the history does not go back that far.
+unsigned char
+WindHistory( unsigned char ago, struct tagWindMinute *m )
 {
-  unsigned short adc_val;
-  unsigned short wind_count;
-  unsigned short n;
-  float wind_speed;
-  unsigned long t_now = 0;
-  unsigned long t_sample = 0;
-  static unsigned long t_next = 0;
-  static unsigned short GustNdx = 0;
+  if ( ago == 0 || ago > MinValid )
+    return 0;
 
+  *m = Wind_Min[ ( MinNdx + WIND_HIST_MIN - ago ) % WIND_HIST_MIN ];
+  return 1;
+}
 
-  if ( (t_now = millis()) < t_next) // wait until next update period
+// sin of whole degrees 0..359, scaled to 255
+static short
+Wind_sin( short deg )
+{
+  if ( deg <= 90 )
+    return pgm_read_byte( &Wind_Sin[deg] );
+  if ( deg <= 180 )
+    return pgm_read_byte( &Wind_Sin[180 - deg] );
+  if ( deg <= 270 )
+    return -pgm_read_byte( &Wind_Sin[deg - 180] );
+  return -pgm_read_byte( &Wind_Sin[360 - deg] );
+}
+
+/*
+  Direction of the vector sum e, n in whole degrees and the steadiness, the length of the vector sum as a percentage
+  of the speed sum. 100% for wind from a constant direction, towards 0 for wind that varies all around.
+  Adding vectors handles the wrap at north that a plain average of the angles gets wrong.
+*/
+static void
+WindVecDir( long e, long n, unsigned long spd_sum, short *dir, unsigned char *steady )
+{
+  unsigned long a = e < 0 ? -e : e;
+  unsigned long b = n < 0 ? -n : n;
+  unsigned long hi = max( a, b ), lo = min( a, b );
+  unsigned long x, d;
+  short t;
+
+  if ( hi == 0 || spd_sum == 0 )  // calm
   {
-    // not time yet
+    *dir = -1;
+    *steady = 0;
     return;
   }
 
+  // atan(lo/hi) in degrees, atan(x) ~ 45x + 15.64x(1-x) to within 0.25 degree, x in Q8
+  x = lo;
+  d = hi;
+  while ( d >= ( 1UL << 23 ) )
+  {
+    x >>= 1;
+    d >>= 1;
+  }
+  x = ( x << 8 ) / d;
+  t = ( x * ( 11520L * 64 + 1001L * ( 256 - x ) ) + ( 1L << 21 ) ) >> 22;
+
+  // length = hi / cos(t), as a percentage of the speed sum which carries the same 255 scale
+  d = pgm_read_byte( &Wind_Sin[90 - t] ) * spd_sum;
+  *steady = min( 100, ( hi * 25 ) / ( ( d + 2 ) / 4 ) );
+
+  if ( a > b )        // angle from north within the quadrant
+    t = 90 - t;
+  if ( n < 0 )
+    t = 180 - t;
+  if ( e < 0 )
+    t = 360 - t;
+  *dir = t % 360;
+}
 
-  // disable the interrupt so we can get a two byte variable without getting interrupted
-  PCICR = 0;  // disable PCinterupt 1 vector
-  wind_count = WindCnt;     // get the count from the pin change interrupt
-  WindCnt = 0;
-  t_sample = WIND_SAMPLE_PER + (t_now - t_next);
-  t_next = t_now + WIND_SAMPLE_PER; // every second we update the display with new data
-  PCICR |= 1 << PCIE1; // enable PCinterupt 1 vector
-
-  // calc and store the current wind speed
-  wind_speed = (wind_count * ANEMO_CONST) / ANEMO_COUNT_Rev;   // 2.5 miles/rev/sec; div by counts per revolution.
-  // correct for actual sampling periode
-  wind_speed = wind_speed * WIND_SAMPLE_PER / t_sample;
-  WindSpdMPH = wind_speed + 0.5; \
-
-  Wind_Gust[GustNdx] = WindSpdMPH; // store current measure wind speed in uchar, use rounding.
-  GustNdx = ++GustNdx % WIND_GUST_PER;  // Advance to next position, wrap around
+// A minute is complete, file it and update the totals that only change once a minute
+static void
+WindMinuteDone( void )
+{
+  unsigned char i;
+  unsigned long sum = 0;
+  struct tagWindMinute m;
+
+  Wind_Min[MinNdx] = Wind_Cur;
+  Wind_Vec[MinNdx % 10].e = Wind_CurE / WIND_VEC_DIV;
+  Wind_Vec[MinNdx % 10].n = Wind_CurN / WIND_VEC_DIV;
+  MinNdx = ( MinNdx + 1 ) % WIND_HIST_MIN;
+  if ( MinValid < WIND_HIST_MIN )
+    MinValid++;
+
+  Wind_Sum9 = Wind_Cnt9 = Wind_Gust9 = 0;
+  Wind_10th.sum = 0;
+  Wind_Vec9E = Wind_Vec9N = 0;
+  WindGustHourMPH = 0;
+
+  for ( i = 1; WindHistory( i, &m ); i++ )
+  {
+    sum += m.sum;
+    if ( m.gust > WindGustHourMPH )
+      WindGustHourMPH = m.gust;
+
+    if ( i <= 10 )
+    {
+      struct tagWindVec *v = &Wind_Vec[ ( MinNdx + WIND_HIST_MIN - i ) % WIND_HIST_MIN % 10 ];
+
+      if ( i == 1 )
+      {
+        Wind_Sum1 = m.sum;
+        Wind_Vec1E = v->e * (long) WIND_VEC_DIV;
+        Wind_Vec1N = v->n * (long) WIND_VEC_DIV;
+      }
+      else if ( i == 2 )
+        Wind_2nd = m;
+
+      if ( i < 10 )
+      {
+        Wind_Sum9 += m.sum;
+        Wind_Cnt9 += WIND_MIN_SAMPLES;
+        if ( m.gust > Wind_Gust9 )
+          Wind_Gust9 = m.gust;
+        Wind_Vec9E += v->e * (long) WIND_VEC_DIV;
+        Wind_Vec9N += v->n * (long) WIND_VEC_DIV;
+      }
+      else
+      {
+        Wind_10th = m;
+        Wind_Vec10th = *v;
+      }
+    }
+  }
+  WindAvgHourMPH = ( sum + MinValid * WIND_MIN_SAMPLES / 2 ) / ( MinValid * WIND_MIN_SAMPLES );
 
-  // go through the 1 second array and take the peak and average  for the last 10 minutes.
-  // note average will not be ready for first 10 minuntes after turning the device on
+  Wind_Cur.sum = Wind_Cur.max = Wind_Cur.gust = 0;
+  Wind_CurE = Wind_CurN = 0;
+  Wind_CurSecs = 0;
+}
 
-  WindGustMPH  = wind_speed = 0;
-  for ( unsigned short i = 0; i < WIND_GUST_PER; i++)
+// Add a one second sample to the history and update the averages, gusts and mean directions
+static void
+WindHistAdd( unsigned char spd, short dir )
+{
+  unsigned char g3, n;
+  unsigned long sum;
+  unsigned short cnt;
+  long e, v;
+
+  // 2 minute average from the samples
+  Wind_Sum2 -= Wind_Sec[SecNdx];
+  Wind_Sum2 += spd;
+  Wind_Sec[SecNdx] = spd;
+  SecNdx = ( SecNdx + 1 ) % WIND_SEC_N;
+  if ( SecValid < WIND_SEC_N )
+    SecValid++;
+  WindAvg2MPH = ( Wind_Sum2 + SecValid / 2 ) / SecValid;
+
+  // WMO gust -- the highest 3 second running average
+  n = min( SecValid, 3 );
+  g3 = ( Wind_Sec[ ( SecNdx + WIND_SEC_N - 1 ) % WIND_SEC_N ]
+       + ( n > 1 ? Wind_Sec[ ( SecNdx + WIND_SEC_N - 2 ) % WIND_SEC_N ] : 0 )
+       + ( n > 2 ? Wind_Sec[ ( SecNdx + WIND_SEC_N - 3 ) % WIND_SEC_N ] : 0 ) + n / 2 ) / n;
+
+  if ( Wind_CurSecs == 0 )
+    Wind_Cur.min = 0xff;
+  Wind_Cur.sum += spd;
+  Wind_Cur.max = max( Wind_Cur.max, spd );
+  Wind_Cur.min = min( Wind_Cur.min, spd );
+  Wind_Cur.gust = max( Wind_Cur.gust, g3 );
+  Wind_CurE += spd * (long) Wind_sin( dir );
+  Wind_CurN += spd * (long) Wind_sin( ( dir + 90 ) % 360 );
+  Wind_CurSecs++;
+  n = WIND_MIN_SAMPLES - Wind_CurSecs;    // seconds of the oldest minute still inside the window
+
+  // 2 minute mean direction, from the current and the last full minute and the part of the minute before it
+  e = Wind_CurE + Wind_Vec1E;
+  v = Wind_CurN + Wind_Vec1N;
+  sum = Wind_Cur.sum + Wind_Sum1;
+  if ( MinValid >= 2 )
   {
-    wind_speed += Wind_Gust[i];
+    e += Wind_Vec[ ( MinNdx + WIND_HIST_MIN - 2 ) % 10 ].e * (long) WIND_VEC_DIV / WIND_MIN_SAMPLES * n;
+    v += Wind_Vec[ ( MinNdx + WIND_HIST_MIN - 2 ) % 10 ].n * (long) WIND_VEC_DIV / WIND_MIN_SAMPLES * n;
+    sum += ( Wind_2nd.sum * (unsigned long) n ) / WIND_MIN_SAMPLES;
+  }
+  WindVecDir( e, v, sum, &WindDir2, &WindSteady2 );
 
-    if (Wind_Gust[i] > WindGustMPH)
-      WindGustMPH = Wind_Gust[i] ;    // this is the highest in the last 10 minutes
+  // same for 10 minutes
+  e = Wind_CurE + Wind_Vec9E;
+  v = Wind_CurN + Wind_Vec9N;
+  sum = Wind_Cur.sum + Wind_Sum9;
+  if ( MinValid >= 10 )
+  {
+    e += Wind_Vec10th.e * (long) WIND_VEC_DIV / WIND_MIN_SAMPLES * n;
+    v += Wind_Vec10th.n * (long) WIND_VEC_DIV / WIND_MIN_SAMPLES * n;
+    sum += ( Wind_10th.sum * (unsigned long) n ) / WIND_MIN_SAMPLES;
+  }
+  WindVecDir( e, v, sum, &WindDir10, &WindSteady10 );
+
+  // 10 minutes are the current minute, the 9 full ones before it and the part of the 10th minute back that is still
+  // inside the window, pro rated from its sum. The gust of that minute counts until all of it has expired, so the
+  // gust covers 10 to 11 minutes.
+  sum = Wind_Cur.sum + Wind_Sum9;
+  cnt = Wind_CurSecs + Wind_Cnt9;
+  WindGustMPH = max( Wind_Cur.gust, Wind_Gust9 );
+  if ( MinValid >= 10 && n )
+  {
+    sum += ( Wind_10th.sum * (unsigned long) n + WIND_MIN_SAMPLES / 2 ) / WIND_MIN_SAMPLES;
+    cnt += n;
+    WindGustMPH = max( WindGustMPH, Wind_10th.gust );
   }
+  WindAvgMPH = ( sum + cnt / 2 ) / cnt;
+
+  if ( Wind_CurSecs == WIND_MIN_SAMPLES )
+    WindMinuteDone();
+}
+
+void WindRead()
+{
+  unsigned short adc_val;
+  unsigned short wind_count, cnt;
+  float wind_speed;
+  unsigned long t_now = millis();
+  unsigned long t_sample = 0;
+  static unsigned long t_prev = 0;
+  static unsigned short prev_cnt = 0;
+  unsigned char seq;
 
-  wind_speed /= WIND_GUST_PER;
-  WindAvgMPH = wind_speed + 0.5;
 
+  // a two byte variable can be torn by the interrupt, read again if the handler ran in between
+  do
+  {
+    seq = SeqBegin( &WindSeq );
+    cnt = WindCnt;     // get the count from the pin change interrupt
+  } while ( SeqRetry( &WindSeq, seq ));
+  wind_count = cnt - prev_cnt;
+  prev_cnt = cnt;
+  t_sample = t_now - t_prev;     // the scheduler calls every WIND_SAMPLE_PER, give or take its jitter
+  t_prev = t_now;
+  if ( t_sample == 0 )
+    t_sample = WIND_SAMPLE_PER;
 
+  // calc and store the current wind speed
+  wind_speed = (wind_count * ANEMO_CONST) / ANEMO_COUNT_Rev;   // 2.5 miles/rev/sec; div by counts per revolution.
+  // correct for actual sampling periode
+  wind_speed = wind_speed * WIND_SAMPLE_PER / t_sample;
+  WindSpdMPH = wind_speed + 0.5; \
 
   // calc and store the current wind dir
-  adc_val = analogRead(WIND_DIR_ADC);    // read the input pin
+  adc_val = ADC_Result(WIND_DIR_ADC);    // read the input pin, 12 bits against the 10 bit calibration
 
-  WindDir = ((adc_val - WindCal.WDir_min) *  360L) / (WindCal.WDir_max - WindCal.WDir_min);
+  // in long, below the calibrated minimum the difference is negative and an unsigned int would wrap
+  WindDir = (((long) adc_val - ((long) WindCal.WDir_min << ( ADC_RES_BITS - 10 ))) *  360L) / ( (long) ( WindCal.WDir_max - WindCal.WDir_min ) << ( ADC_RES_BITS - 10 ));
   WindDir += WindCal.WDir_offs;
 
   WindDir = WindDir %360;    // to make the offset  wrap around 
+  if ( WindDir < 0 )         // reading below the calibrated minimum
+    WindDir += 360;
+
+  WindHistAdd( WindSpdMPH, WindDir );
 }
 
 #endif
\ No newline at end of file
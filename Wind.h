@@ -11,19 +11,37 @@
 #ifndef WIND_VANE_H
 #define	WIND_VANE_H
 #define WIND_SAMPLE_PER 1000   // one second, this is the measure interval
+#define WIND_HIST_MIN 60        // minutes of wind history
+
+// Summary of one minute of wind samples
+struct tagWindMinute
+{
+  unsigned short sum;           // sum of the 1 second samples, the average is sum / 60
+  unsigned char min;
+  unsigned char max;            // highest 1 second sample
+  unsigned char gust;           // highest 3 second average
+};
 
 #ifdef	__cplusplus
 extern "C" {
 #endif
 
-extern unsigned char WindGustMPH;
+extern unsigned char WindGustMPH;     // highest 3 second average in the last 10 minutes
 extern unsigned char WindSpdMPH;
-extern unsigned char WindAvgMPH;
+extern unsigned char WindAvgMPH;      // 10 minute average
+extern unsigned char WindAvg2MPH;     // 2 minute average
+extern unsigned char WindAvgHourMPH;  // average and 3 second gust over the history, up to an hour
+extern unsigned char WindGustHourMPH;
 extern long WindDir; 
+extern short WindDir2;                // 2 and 10 minute speed weighted mean direction, -1 when calm
+extern short WindDir10;
+extern unsigned char WindSteady2;     // 2 and 10 minute direction steadiness in %, 100 for a constant direction
+extern unsigned char WindSteady10;
 
 extern void WindDirCal( void );
 extern void WindSetup(void);
 extern void WindRead(void);
+extern unsigned char WindHistory( unsigned char ago, struct tagWindMinute *m );
 
 #ifdef	__cplusplus
 }
@@ -3,6 +3,40 @@
 // comment/uncomment for additional features 
 // Note: Wind and RPM are mutually excluisive as they currently make use of the same IO pin and the Pin-Change interrupt. 
 
+// BUILD_OPTS_CMDLINE takes WetBulbTemp, WITH_RPM and WITH_WIND from the compiler command line instead, tools/Makefile
+// builds every configuration on the host that way
+#ifndef BUILD_OPTS_CMDLINE
 // #define WetBulbTemp
+// #define WETBULB_SOLVER WETBULB_STULL   // defaults to WETBULB_NEWTON, see Atmos.h for the choices
 #define WITH_RPM 
-//#define WITH_WIND 
\ No newline at end of file
+//#define WITH_WIND 
+#endif
+#define RPM_PULSES_PER_REV 1      // rising edges from the RPM sensor per revolution
+
+#if defined(WITH_WIND) && defined(WITH_RPM)
+#error "WITH_WIND and WITH_RPM can't be used together"
+#endif
+
+// Math for altitude, density altitude, dew point and wet bulb in Atmos.c: ATMOS_FLOAT for the original float pow/log code,
+// ATMOS_FIXED for integer polynomials or ATMOS_TABLES for interpolation tables in flash (1.8Kb, see Atmos_tables.h)
+#ifndef ATMOS_MATH
+#define ATMOS_MATH ATMOS_FIXED
+#endif
+
+// BMP085/BMP180 pressure oversampling, BMP085_ULTRA_LOW_POWER .. BMP085_ULTRA_HIGH_RES, and how many pressure samples share one temperature reading
+#define BARO_OSS BMP085_ULTRA_HIGH_RES
+#define BARO_TEMP_EVERY 4
+
+// Upper limit for the I2C clock in Hz. All sensors support 400Khz fast mode, lower this for long sensor cables
+#define I2C_MAX_SCL 400000L
+
+// Execution time of the tasks and interrupt handlers, see Prof.h. A double press shows the diagnostics screen with the
+// profile and the free SRAM of Mem.h, a long press on it prints them over the serial port at 57600 baud
+// #define WITH_PROFILE
+
+// Readings streamed over the serial port as binary frames as they are measured, see Telem.h, tools/telem_decode.c
+// turns them into CSV on the PC. Takes the serial port over, with WITH_PROFILE the dump goes out as frames as well
+// #define WITH_TELEMETRY
+#ifndef TELEM_BAUD
+#define TELEM_BAUD 115200
+#endif
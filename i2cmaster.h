@@ -32,6 +32,11 @@
  
  Adjust the  CPU clock frequence F_CPU in twimaster.c or in the Makfile when using the TWI hardware implementaion.
 
+ The TWI hardware implementation additionally provides an interrupt driven transaction engine (i2c_submit()).
+ A transaction is described by an @ref i2c_txn and runs in the background from the TWI interrupt while the
+ caller continues, so a sensor state machine only has to check the status of its transaction on its next pass.
+ The byte oriented calls remain available as a synchronous interface, i.e. for device initialization.
+
  @note 
     The module i2cmaster.S is based on the Atmel Application Note AVR300, corrected and adapted 
     to GNU assembler and AVR-GCC C call interface.
@@ -94,22 +99,95 @@
 /** defines the data direction (writing to I2C device) in i2c_start(),i2c_rep_start() */
 #define I2C_WRITE   0
 
+/** @name Transaction status codes as found in i2c_txn.status */
+/**@{*/
+#define I2C_OK          0     /**< transaction completed */
+#define I2C_ERR_ADDR    1     /**< device did not acknowledge its address */
+#define I2C_ERR_START   2     /**< start condition could not be established, arbitration lost or bus error */
+#define I2C_ERR_DATA    3     /**< device did not acknowledge a data byte */
+#define I2C_ERR_TIMEOUT 4     /**< bus event did not complete in time, i.e. a device is holding SCL or SDA low */
+#define I2C_BUSY        0xff  /**< transaction is queued or in progress */
+/**@}*/
+
+/** how long a queued transaction may take before the caller should give up on it with i2c_abort(), in ms */
+#define I2C_TXN_TIMEOUT 20
+
+/** number of address attempts i2c_start_wait() makes while the device is busy */
+#define I2C_START_WAIT_TRIES 100
+
+/**
+ @brief Descriptor of a queued, interrupt driven bus transaction
+
+ The engine writes @a wlen bytes from @a wbuf to the device, then (after a repeated start) reads
+ @a rlen bytes into @a rbuf, NACKing the last one. Either phase may be empty. With both empty the
+ device is only addressed for writing, a probe that ends with I2C_OK if it ACKs. The descriptor and
+ the buffers must stay valid until @a status changes from I2C_BUSY.
+ */
+typedef struct i2c_txn
+{
+    unsigned char addr;                 /**< device address, the R/W bit is supplied by the engine */
+    const unsigned char *wbuf;          /**< bytes to write, i.e. register address followed by data */
+    unsigned char wlen;
+    unsigned char *rbuf;                /**< receive buffer */
+    unsigned char rlen;
+    volatile unsigned char status;      /**< I2C_BUSY until the transaction completed, then I2C_OK or an error code */
+    void (*done)(struct i2c_txn *t);    /**< optional completion callback, called from the TWI interrupt */
+    struct i2c_txn *next;               /**< queue link, owned by the engine */
+    unsigned char cmd[2];               /**< register address and value, @a wbuf for i2c_txn_read() and i2c_txn_write() */
+} i2c_txn_t;
+
+/** static initializer of an idle descriptor for the device at @a addr */
+#define I2C_TXN( addr ) { addr, 0, 0, 0, 0, 0, 0, 0, { 0, 0 } }
+
 
 #ifdef  __cplusplus
 extern "C" {
 #endif
 /**
  @brief initialize the I2C master interace. Need to be called only once 
+
+ Sets the bus default clock of ~30Khz. Registered device clock profiles are kept.
  @return none
  */
 extern void i2c_init(void);
 
+/**
+ @brief compute the TWI bit rate settings for a SCL clock
+
+ Picks the fastest setting that does not exceed @a scl_hz, limited to what the hardware can do at F_CPU.
+ @param    scl_hz  requested SCL clock in Hz
+ @param    twbr    receives the TWBR value
+ @param    twps    receives the TWPS prescaler bits (0..3 for 1,4,16,64)
+ @return   resulting SCL clock in Hz
+ */
+extern unsigned long i2c_clock_calc(unsigned long scl_hz, unsigned char *twbr, unsigned char *twps);
+
+/**
+ @brief set the bus clock used for devices without a registered clock profile
+ @param    scl_hz  SCL clock in Hz
+ @return   none
+ */
+extern void i2c_set_clock(unsigned long scl_hz);
+
+/**
+ @brief register the highest SCL clock a device supports
+
+ The clock is switched to the device's profile before each START addressed to it, so fast devices
+ are not throttled by the slowest one on the bus.
+ @param    addr        device address, the R/W bit is ignored
+ @param    max_scl_hz  highest SCL clock in Hz
+ @retval   0   registered
+ @retval   1   device table is full, the device uses the bus default
+ */
+extern unsigned char i2c_register_device(unsigned char addr, unsigned long max_scl_hz);
+
 
 /** 
  @brief Terminates the data transfer and releases the I2C bus 
- @return none
+ @retval   0   bus released
+ @retval   I2C_ERR_TIMEOUT   stop condition could not be executed
  */
-extern void i2c_stop(void);
+extern unsigned char i2c_stop(void);
 
 
 /** 
@@ -118,6 +196,8 @@ extern void i2c_stop(void);
  @param    addr address and transfer direction of I2C device
  @retval   0   device accessible 
  @retval   1   failed to access device 
+ @retval   2   start condition could not be established
+ @retval   I2C_ERR_TIMEOUT   bus held by a device
  */
 extern unsigned char i2c_start(unsigned char addr);
 
@@ -137,9 +217,10 @@ extern unsigned char i2c_rep_start(unsigned char addr);
    
  If device is busy, use ack polling to wait until device ready 
  @param    addr address and transfer direction of I2C device
- @return   none
+ @retval   0   device accessible
+ @retval   I2C_ERR_TIMEOUT   device still busy after I2C_START_WAIT_TRIES attempts or bus held by a device
  */
-extern void i2c_start_wait(unsigned char addr);
+extern unsigned char i2c_start_wait(unsigned char addr);
 
  
 /**
@@ -147,6 +228,7 @@ extern void i2c_start_wait(unsigned char addr);
  @param    data  byte to be transfered
  @retval   0 write successful
  @retval   1 write failed
+ @retval   I2C_ERR_TIMEOUT bus held by a device
  */
 extern unsigned char i2c_write(unsigned char data);
 
@@ -174,6 +256,89 @@ extern unsigned char i2c_readNak(void);
  */
 extern unsigned char i2c_read(unsigned char ack);
 
+
+/**
+ @brief    queue a transaction for the interrupt driven engine and return immediately
+
+ The transaction starts as soon as the ones queued before it have completed. Poll @a t->status or
+ use the @a t->done callback to find out when it has finished. A descriptor that is still
+ I2C_BUSY is not queued a second time.
+ @param    t transaction descriptor
+ @return   none
+ */
+extern void i2c_submit(i2c_txn_t *t);
+
+/**
+ @brief    queue a transaction and wait for it to complete
+
+ Gives up with i2c_abort() if the transaction takes longer than I2C_TXN_TIMEOUT.
+ @param    t transaction descriptor
+ @return   I2C_OK or one of the I2C_ERR_ codes
+ */
+extern unsigned char i2c_transfer(i2c_txn_t *t);
+
+/**
+ @brief    set up a transaction that reads a block of registers
+
+ Writes the register address, then reads @a len bytes in one burst after a repeated start. Only the
+ last byte is NACKed. With @a len = 0 only the register address is sent, i.e. for a command byte.
+ @param    t    transaction descriptor, @a t->addr must be set
+ @param    reg  register address or command
+ @param    buf  receive buffer
+ @param    len  number of bytes to read
+ @return   none
+ */
+extern void i2c_txn_read(i2c_txn_t *t, unsigned char reg, unsigned char *buf, unsigned char len);
+
+/**
+ @brief    set up a transaction that writes one register
+ @param    t    transaction descriptor, @a t->addr must be set
+ @param    reg  register address
+ @param    val  value to write
+ @return   none
+ */
+extern void i2c_txn_write(i2c_txn_t *t, unsigned char reg, unsigned char val);
+
+/**
+ @brief    read a block of registers and wait for the result
+ @param    addr device address, the R/W bit is ignored
+ @param    reg  first register address
+ @param    buf  receive buffer
+ @param    len  number of bytes to read, the last one is NACKed
+ @return   I2C_OK or one of the I2C_ERR_ codes
+ */
+extern unsigned char i2c_read_block(unsigned char addr, unsigned char reg, unsigned char *buf, unsigned char len);
+
+/**
+ @brief    wait until all queued transactions have completed
+
+ The byte oriented calls above drive the TWI hardware directly and therefore call this first, so
+ they can be mixed with queued transactions.
+ @return   none
+ */
+extern void i2c_wait_idle(void);
+
+/**
+ @brief    abandon all queued transactions and recover the bus
+
+ For use when a transaction has been I2C_BUSY for longer than I2C_TXN_TIMEOUT. All queued
+ transactions complete with I2C_ERR_TIMEOUT, without their callbacks being called.
+ @return   none
+ */
+extern void i2c_abort(void);
+
+/**
+ @brief    free a stuck bus
+
+ Clocks out 9 SCL pulses so that a device left in the middle of a byte releases SDA, issues a
+ STOP and re-initializes the TWI hardware. Called from the error paths of the sensor state machines
+ after an I2C_ERR_START. A NACK (I2C_ERR_ADDR, I2C_ERR_DATA) leaves the bus free and i2c_abort()
+ recovers from an I2C_ERR_TIMEOUT itself. Does nothing while transactions are queued, they would be
+ broken off by the bit banging.
+ @return   none
+ */
+extern void i2c_recover(void);
+
 #ifdef  __cplusplus
 }
 #endif
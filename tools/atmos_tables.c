@@ -0,0 +1,141 @@
+/*
+  Generates Atmos_tables.h, the PROGMEM interpolation tables used by Atmos.c when ATMOS_MATH is ATMOS_TABLES.
+
+  Build and run on the host from the sketch directory:
+	cc -o atmos_tables tools/atmos_tables.c -lm
+	./atmos_tables > Atmos_tables.h
+
+  The tables are linearly interpolated on the target. The max interpolation error of each table against the
+  formula it replaces is measured here and written into the header, so a change of the table size shows the
+  resulting accuracy next to the flash cost.
+*/
+#include <stdio.h>
+#include <math.h>
+
+// saturation vapor pressure, same formula as the wet bulb calculation in Atmos.c
+#define ES_T_MIN  -80
+#define ES_T_MAX   80
+#define ES_T_STEP  1
+
+// pressure ratio ^ pwr for Altitude and DensityAlt, covers 300..1100 hPa at -40..+60 degC
+#define POW_X_MIN  0.25
+#define POW_X_DIV  128          // entries per unit of the ratio
+#define POW_N      145          // 0.25 .. 1.375
+
+static double
+es( double t )
+{
+	return 6.112 * exp( (17.67 * t) / (t + 243.5) );
+}
+
+static double
+table_val( const double *tab, double x0, double step, int n, double x )
+{
+	double i = (x - x0) / step;
+	int k = (int) i;
+
+	if ( k >= n - 1 )
+		k = n - 2;
+
+	return tab[k] + (tab[k + 1] - tab[k]) * (i - k);
+}
+
+static void
+print_table( const char *name, const double *tab, int n )
+{
+	int i;
+
+	printf( "static const float %s[%d] PROGMEM = {", name, n );
+	for ( i = 0; i < n; i++ )
+		printf( "%s%.8g%s", i % 6 ? " " : "\n\t", tab[i], i < n - 1 ? "," : "" );
+	printf( "\n};\n\n" );
+}
+
+// max error of the interpolated table relative to the value, scanned at 1/64 of the step
+static double
+max_rel_err( const double *tab, double x0, double step, int n, double (*f)( double, double ), double p )
+{
+	double x, err, max = 0;
+
+	for ( x = x0; x <= x0 + step * (n - 1); x += step / 64 )
+	{
+		err = fabs( table_val( tab, x0, step, n, x ) / f( x, p ) - 1 );
+		if ( err > max )
+			max = err;
+	}
+	return max;
+}
+
+// max error of the interpolated vapor pressure table expressed as a temperature error
+static double
+max_t_err( const double *tab, int n )
+{
+	double t, err, max = 0;
+
+	for ( t = ES_T_MIN; t <= ES_T_MIN + ES_T_STEP * (n - 1); t += ES_T_STEP / 64.0 )
+	{
+		err = fabs( table_val( tab, ES_T_MIN, ES_T_STEP, n, t ) - es( t ) );
+		err /= es( t ) * 17.67 * 243.5 / ((t + 243.5) * (t + 243.5));		// d es / dt
+		if ( err > max )
+			max = err;
+	}
+	return max;
+}
+
+static double
+f_es( double t, double unused )
+{
+	(void) unused;
+	return es( t );
+}
+
+static double
+f_pow( double x, double p )
+{
+	return pow( x, p );
+}
+
+int
+main( void )
+{
+	static double es_tab[ES_T_MAX - ES_T_MIN + 1];
+	static double alt_tab[POW_N], da_tab[POW_N];
+	const int es_n = (ES_T_MAX - ES_T_MIN) / ES_T_STEP + 1;
+	double e_es, e_t, e_alt, e_da;
+	int i;
+
+	for ( i = 0; i < es_n; i++ )
+		es_tab[i] = es( ES_T_MIN + i * ES_T_STEP );
+
+	for ( i = 0; i < POW_N; i++ )
+	{
+		alt_tab[i] = pow( POW_X_MIN + (double) i / POW_X_DIV, 0.190284 );
+		da_tab[i] = pow( POW_X_MIN + (double) i / POW_X_DIV, 0.234969245 );
+	}
+
+	e_es = max_rel_err( es_tab, ES_T_MIN, ES_T_STEP, es_n, f_es, 0 );
+	e_t = max_t_err( es_tab, es_n );
+	e_alt = max_rel_err( alt_tab, POW_X_MIN, 1.0 / POW_X_DIV, POW_N, f_pow, 0.190284 );
+	e_da = max_rel_err( da_tab, POW_X_MIN, 1.0 / POW_X_DIV, POW_N, f_pow, 0.234969245 );
+
+	printf( "/* Generated by tools/atmos_tables.c -- do not edit\n\n" );
+	printf( "  Flash used: %d bytes\n", (int) ((es_n + 2 * POW_N) * sizeof( float )) );
+	printf( "  Max relative interpolation error:\n" );
+	printf( "\tSatVP_Table   %.2g, %.3f degC in the wet bulb\n", e_es, e_t );
+	printf( "\tAlt_Table     %.2g, below %.2f m altitude\n", e_alt, e_alt * 44307.7 );
+	printf( "\tDA_Table      %.2g, below %.2f m density altitude\n", e_da, e_da * 44330.8 );
+	printf( "*/\n\n" );
+
+	printf( "#include <avr/pgmspace.h>\n\n" );
+	printf( "#define SATVP_T_MIN %d\t\t// degC, 1 degC per entry\n", ES_T_MIN );
+	printf( "#define SATVP_N %d\n", es_n );
+	printf( "#define POW_X_MIN %g\t\t// pressure ratio of the first entry\n", POW_X_MIN );
+	printf( "#define POW_X_DIV %d\t\t// entries per unit of the pressure ratio\n", POW_X_DIV );
+	printf( "#define POW_N %d\n\n", POW_N );
+
+	print_table( "SatVP_Table", es_tab, es_n );
+	print_table( "Alt_Table", alt_tab, POW_N );
+	print_table( "DA_Table", da_tab, POW_N );
+
+	return 0;
+}
@@ -0,0 +1,276 @@
+/*
+  The benchmark of the whole sketch on tools/sim, see tools/Makefile: make -C tools bench builds it for every
+  combination of WITH_WIND or WITH_RPM and WetBulbTemp, runs the same session on each and compares what it prints
+  with the baseline-<config>.txt next to this file. make -C tools bench-baseline takes the new results as the
+  baseline, after a change that is meant to move them.
+
+  The session boots with all sensors on the bus and the readings drifting, the wind blowing or the engine running,
+  stays on the start screen for a minute, turns the knob once around the screens, 20 s on each, toggles the units
+  with a long press on the Temp screen, loses the barometer for 30 s and runs on for another minute.
+
+  The results are those of the simulated time and don't depend on the host: per task the runs, the execution time,
+  the longest run, the jitter and the overruns, the time asleep, the characters sent to the LCD and the I2C traffic.
+  The execution time is what the calls into the core, the LCD and the bus take in tools/sim, not the instructions in
+  between, tools/sim isn't cycle accurate. The math in between is counted instead, as check/wetbulb.cpp does: Atmos.c
+  is built here with its entry points and its exp(), log() and pow() counted, the Newton iterations of the wet bulb
+  are its exp() calls less the one for the air, and the BMP085 model counts the pressures read, one SM_Calc_Press
+  each with a long division and 11 long multiplications.
+
+  Mem_MinFree() and Mem_Static() only measure on the target. The bench paints the host stack below main() the way
+  Mem.cpp paints the SRAM and reports how deep the sketch went, tools/Makefile adds the .data and .bss of the sketch
+  modules from the symbols of the bench. Both are host sizes, with 8 byte pointers and longs, larger than on the
+  AVR, but they grow with the target's. Flash and the target sizes need avr-size and tools/ram_usage.c on a target
+  build, the profile of WITH_PROFILE measures the cycles on the target.
+*/
+#include <alloca.h>
+#include <stdio.h>
+#include "sim.h"
+
+enum { MATH_OTHER, MATH_DEWPT, MATH_DENSALT, MATH_ALT, MATH_WETBULB, MATH_N };
+
+struct MathWork
+{
+  unsigned long calls, exp, log, pow;
+  unsigned exp_max;             // most exp() calls in one call
+};
+
+static struct MathWork Math[MATH_N];
+static unsigned char MathIn;    // the entry point running
+static unsigned MathExp;        // exp() calls of this call
+
+#define exp( x ) ( Math[MathIn].exp++, MathExp++, exp( x ))
+#define log( x ) ( Math[MathIn].log++, log( x ))
+#define pow( x, y ) ( Math[MathIn].pow++, pow( x, y ))
+#define DewPt Atmos_DewPt
+#define DensityAlt Atmos_DensityAlt
+#define Altitude Atmos_Altitude
+#define T_wetbulb_C Atmos_T_wetbulb_C
+#include "Atmos.c"
+#undef exp
+#undef log
+#undef pow
+#undef DewPt
+#undef DensityAlt
+#undef Altitude
+#undef T_wetbulb_C
+
+static void
+MathEnter( unsigned char in )
+{
+  MathIn = in;
+  MathExp = 0;
+  Math[in].calls++;
+}
+
+static float
+MathLeave( float v )
+{
+  Math[MathIn].exp_max = max( Math[MathIn].exp_max, MathExp );
+  MathIn = MATH_OTHER;
+  return v;
+}
+
+static float
+DewPt( float Tc, float RH )
+{
+  MathEnter( MATH_DEWPT );
+  return MathLeave( Atmos_DewPt( Tc, RH ));
+}
+
+static float
+DensityAlt( float P_hPa, float Temp_C )
+{
+  MathEnter( MATH_DENSALT );
+  return MathLeave( Atmos_DensityAlt( P_hPa, Temp_C ));
+}
+
+static float
+Altitude( float P_hPa, float P_sl )
+{
+  MathEnter( MATH_ALT );
+  return MathLeave( Atmos_Altitude( P_hPa, P_sl ));
+}
+
+#ifdef WetBulbTemp
+static float
+T_wetbulb_C( float Temp_C, float Press_hPa, float Rh )
+{
+  MathEnter( MATH_WETBULB );
+  return MathLeave( Atmos_T_wetbulb_C( Temp_C, Press_hPa, Rh ));
+}
+#endif
+
+#include "Air_LCDuino.ino"
+
+#ifdef WITH_WIND
+#define CFG_WIND_RPM "wind"
+#elif defined(WITH_RPM)
+#define CFG_WIND_RPM "rpm"
+#else
+#define CFG_WIND_RPM "none"
+#endif
+#ifdef WetBulbTemp
+#define CFG_WETBULB "-wetbulb"
+#else
+#define CFG_WETBULB ""
+#endif
+
+static const char *Names[TASK_END] = {
+  "input",
+#ifdef WITH_WIND
+  "wind",
+#elif defined(WITH_RPM)
+  "rpm",
+#endif
+  "baro",
+  "hygro",
+  "temp",
+#ifdef WITH_TELEMETRY
+  "telem",
+#endif
+  "display",
+};
+
+static uint32_t Rand = 1;
+
+// -1 .. +1
+static double
+Uniform( void )
+{
+  Rand = Rand * 1103515245 + 12345;
+  return ( Rand >> 8 ) / 8388608.0 - 1;
+}
+
+// the sketch for ms, the readings change every 100 ms
+static void
+Run( unsigned long ms )
+{
+  uint64_t end = SimNow + ms * 1000ULL, next = SimNow;
+
+  while ( SimNow < end )
+  {
+    if ( SimNow >= next )
+    {
+      World.temp_c = constrain( World.temp_c + 0.02 * Uniform(), 15, 25 );
+      World.rh = constrain( World.rh + 0.1 * Uniform(), 30, 50 );
+      World.hpa += 0.01 * Uniform();
+      World.wind_mph = constrain( World.wind_mph + Uniform(), 5, 20 );
+      World.wind_dir = fmod( World.wind_dir + 3 * Uniform() + 360, 360 );
+      World.rpm = constrain( World.rpm + 20 * Uniform(), 2000, 2800 );
+      next += 100000;
+    }
+    loop();
+  }
+}
+
+static void
+Click( void )
+{
+  SimPin( Enc_B_PIN, Enc_DIRECTION == 1 );
+  SimPin( Enc_A_PIN, 0 );
+  SimIrqCheck();
+  SimAdvance( 1000 );
+  SimPin( Enc_A_PIN, 1 );
+}
+
+static void
+Press( unsigned long ms )
+{
+  SimPin( Enc_PRESS_PIN, 0 );
+  SimIrqCheck();
+  Run( ms );
+  SimPin( Enc_PRESS_PIN, 1 );
+  SimIrqCheck();
+}
+
+#define STACK_PAINT 65536
+
+static uintptr_t StackLo;       // lowest painted address
+
+// paints STACK_PAINT bytes below the caller with MEM_CANARY, as Mem.cpp paints the SRAM
+static void __attribute__(( noinline ))
+StackPaint( void )
+{
+  uint8_t paint[STACK_PAINT];
+
+  memset( paint, MEM_CANARY, sizeof( paint ));
+  __asm__ __volatile__( "" :: "r" ( paint ) : "memory" );
+  StackLo = (uintptr_t) paint;
+}
+
+// how much of the paint the calls since StackPaint() wrote over, as Mem_MinFree() scans it
+static unsigned long __attribute__(( noinline ))
+StackUsed( void )
+{
+  const volatile uint8_t *p = (const uint8_t *) StackLo, *top = p + STACK_PAINT;
+
+  while ( p < top && *p == MEM_CANARY )
+    p++;
+  return top - p;
+}
+
+static const char *MathNames[MATH_N] = { "", "DewPt", "DensityAlt", "Altitude", "T_wetbulb_C" };
+
+int
+main( void )
+{
+  struct tagTask *t;
+  unsigned char n;
+
+  // ASLR moves the stack in steps of 16 bytes, the frames aligned to more than that take more or less room with it
+  __asm__ __volatile__( "" :: "r" ( alloca( (uintptr_t) &t & 4095 )) : "memory" );
+  StackPaint();
+  SimQuiet = true;
+  World.wind_mph = 12;
+  World.wind_dir = 270;
+  World.rpm = 2400;
+  SimPin( Enc_A_PIN, 1 );
+  SimPin( Enc_PRESS_PIN, 1 );
+  SimStart();
+  setup();
+  Run( 60000 );
+
+  for ( n = 0; n < DISP_END; n++ )
+    if ( ScreenAvail & ( 1UL << n ))
+    {
+      Click();
+      Run( 20000 );
+    }
+
+  EncoderCnt = Temp;
+  Run( 2000 );
+  Press( 800 );
+  Run( 2000 );
+
+  World.baro = false;
+  Run( 30000 );
+  World.baro = true;
+  Run( 60000 );
+
+  printf( "bench %s%s, %.1f s simulated\n", CFG_WIND_RPM, CFG_WETBULB, SimNow / 1e6 );
+  printf( "task     period     runs  busy us   max us  late ms  overruns\n" );
+  for ( n = 0; n < TASK_END; n++ )
+  {
+    t = &Tasks[n];
+    printf( "%-8s %6u %8lu %8lu %8u %8u %9u\n", Names[n], t->period, t->runs, t->busy_us, t->max_us, t->max_late,
+            t->overruns );
+  }
+  printf( "asleep %.2f%%, %lu naps, wake latency max %u us\n", SleepStats.sleep_us / ( SimNow / 100.0 ),
+          SleepStats.naps, SleepStats.wake_max );
+  printf( "LCD bytes %lu\n", SimLcdWrites );
+  SimTwiReport();
+
+  printf( "math            calls    exp()    log()    pow()  exp() max\n" );
+  for ( n = MATH_DEWPT; n < MATH_N; n++ )
+    printf( "%-12s %8lu %8lu %8lu %8lu %10u\n", MathNames[n], Math[n].calls, Math[n].exp, Math[n].log, Math[n].pow,
+            Math[n].exp_max );
+#if defined(WetBulbTemp) && WETBULB_SOLVER != WETBULB_STULL
+  if ( Math[MATH_WETBULB].calls )
+    printf( "wet bulb iterations avg %.2f max %u\n",
+            (double) ( Math[MATH_WETBULB].exp - Math[MATH_WETBULB].calls ) / Math[MATH_WETBULB].calls,
+            Math[MATH_WETBULB].exp_max - 1 );
+#endif
+  printf( "SM_Calc_Press %lu\n", SimBmpPressReads );
+  printf( "stack %lu bytes on the host\n", StackUsed());
+  return 0;
+}
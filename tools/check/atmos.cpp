@@ -0,0 +1,109 @@
+/*
+  Accuracy sweep of the ATMOS_MATH kernel of Atmos.c against the formulas in double precision, over the range the
+  fixed point code documents: -40..+60 degC, 300..1100 hPa and 1..100 %RH, and for the dew point on to the +80 degC
+  the temperature clamps allow. tools/Makefile builds it once per kernel.
+
+  Atmos.c is included as build/Atmos32.c, a copy with long and its constants in 32 bits, so the fixed point code
+  overflows where it would on the AVR.
+*/
+#include "Atmos32.c"
+#include "check.h"
+
+#if ATMOS_MATH == ATMOS_FIXED
+#define KERNEL "fixed"
+#define ALT_MAX 0.2             // m, the bounds documented in Atmos.c
+#define DA_MAX  0.5
+#elif ATMOS_MATH == ATMOS_TABLES
+#define KERNEL "tables"
+#define ALT_MAX 0.81            // m, the interpolation error of Atmos_tables.h
+#define DA_MAX  0.94
+#else
+#define KERNEL "float"
+#define ALT_MAX 0.05            // m, the rounding of the single precision floats
+#define DA_MAX  0.05
+#endif
+#define DEWPT_MAX 0.02          // degC, the fixed point dew point serves the float API of all but ATMOS_FLOAT
+
+static double
+AltRef( double p, double psl )
+{
+  return ( 1 - pow( p / psl, 0.190284 )) * 44307.7;
+}
+
+static double
+DensityAltRef( double p, double t )
+{
+  return 288.15 / 0.0065 * ( 1 - pow(( p / 1013.25 ) / (( t + 273.15 ) / 288.15 ), 0.234969245 ));
+}
+
+static double
+DewPtRef( double t, double rh )
+{
+  double y = 17.271 * t / ( 237.7 + t ) + log( rh / 100 );
+
+  return 237.7 * y / ( 17.271 - y );
+}
+
+struct MaxErr
+{
+  const char *name;
+  double max, bound;
+  double at[3];
+};
+
+static void
+Err( struct MaxErr *m, double got, double want, double a, double b, double c )
+{
+  double e = fabs( got - want );
+
+  if ( e > m->max )
+  {
+    m->max = e;
+    m->at[0] = a;
+    m->at[1] = b;
+    m->at[2] = c;
+  }
+}
+
+static void
+Report( struct MaxErr *m, const char *unit )
+{
+  printf( "  %-14s max error %.4f %s at %g %g %g\n", m->name, m->max, unit, m->at[0], m->at[1], m->at[2] );
+  CHECK( m->max < m->bound, "%s error %.4f %s, the bound is %g", m->name, m->max, unit, m->bound );
+}
+
+int
+main( void )
+{
+  struct MaxErr alt = { "Altitude", 0, ALT_MAX }, pa = { "PressureAlt", 0, ALT_MAX };
+  struct MaxErr da = { "DensityAlt", 0, DA_MAX }, dp = { "DewPt", 0, DEWPT_MAX };
+  struct MaxErr dp_hot = { "DewPt 60..80C", 0, DEWPT_MAX };
+  double p, psl, t, rh;
+
+  for ( p = 300; p <= 1100; p += 2.5 )
+  {
+    Err( &pa, PressureAlt( p ), AltRef( p, 1013.25 ), p, 0, 0 );
+    for ( psl = 950; psl <= 1060; psl += 10 )
+      Err( &alt, Altitude( p, psl ), AltRef( p, psl ), p, psl, 0 );
+    for ( t = -40; t <= 60; t += 0.5 )
+      Err( &da, DensityAlt( p, t ), DensityAltRef( p, t ), p, t, 0 );
+  }
+  for ( t = -40; t <= 80; t += 0.25 )
+    for ( rh = 1; rh <= 100; rh += 0.5 )
+      Err( t <= 60 ? &dp : &dp_hot, DewPt( t, rh ), DewPtRef( t, rh ), t, rh, 0 );
+
+  printf( "ATMOS_MATH %s\n", KERNEL );
+  Report( &pa, "m" );
+  Report( &alt, "m" );
+  Report( &da, "m" );
+  Report( &dp, "degC" );
+  Report( &dp_hot, "degC" );
+
+  // the top of the clamp, where a*Tc * 16 overflowed 32 bits
+  t = DewPt( 80, 50 );
+  CHECK( fabs( t - DewPtRef( 80, 50 )) < DEWPT_MAX, "DewPt( 80, 50 ) %.2f, expected %.2f", t, DewPtRef( 80, 50 ));
+  CHECK( labs( DewPt_centiC( 8000, 5000 ) - lround( DewPtRef( 80, 50 ) * 100 )) <= DEWPT_MAX * 100,
+         "DewPt_centiC( 8000, 5000 ) %d", DewPt_centiC( 8000, 5000 ));
+
+  return check_done( "atmos-" KERNEL );
+}
@@ -0,0 +1,120 @@
+/*
+  The integer compensation of BMP085_Baro.cpp against the example of the Bosch datasheet, for each oversampling
+  setting, with the example calibration the model of tools/sim/twi.cpp has and raw results fixed by SimBmpRaw().
+
+  The reference is the datasheet algorithm in the 32 bit widths of the AVR, with the shifts of the reference code of
+  Bosch for the divisions by powers of 2, over a grid of raw values around the example. The datasheet gives the
+  result for UT 27898 and UP 23843 at oss 0, 15.0 degC and 69964 Pa. At the other settings UP carries the extra bits
+  of resolution, 23843 << oss has to give the same pressure within the rounding of the compensation, 2 Pa.
+*/
+#include <stdint.h>
+#include "build_opts.h"
+#include "BMP085_baro.h"
+#include "check.h"
+
+static const int16_t AC1 = 408, AC2 = -72, AC3 = -14383, B1 = 6190, B2 = 4, MC = -8711, MD = 2868;
+static const uint16_t AC4 = 32741, AC5 = 32757, AC6 = 23153;
+
+// in 0.1 degC and Pa
+static void
+Reference( int32_t ut, int32_t up, int oss, int32_t *t, int32_t *p )
+{
+  int32_t x1, x2, x3, b3, b5, b6, pa;
+  uint32_t b4, b7;
+
+  x1 = ( ut - AC6 ) * AC5 >> 15;
+  x2 = ( MC * 2048 ) / ( x1 + MD );
+  b5 = x1 + x2;
+  *t = ( b5 + 8 ) >> 4;
+
+  b6 = b5 - 4000;
+  x1 = ( B2 * ( b6 * b6 >> 12 )) >> 11;
+  x2 = AC2 * b6 >> 11;
+  x3 = x1 + x2;
+  b3 = ((( AC1 * 4 + x3 ) << oss ) + 2 ) / 4;
+  x1 = AC3 * b6 >> 13;
+  x2 = ( B1 * ( b6 * b6 >> 12 )) >> 16;
+  x3 = (( x1 + x2 ) + 2 ) >> 2;
+  b4 = AC4 * (uint32_t) ( x3 + 32768 ) >> 15;
+  b7 = ( (uint32_t) up - b3 ) * ( 50000 >> oss );
+  pa = b7 < 0x80000000 ? ( b7 * 2 ) / b4 : ( b7 / b4 ) * 2;
+  x1 = ( pa >> 8 ) * ( pa >> 8 );
+  x1 = ( x1 * 3038 ) >> 16;
+  x2 = ( -7357 * pa ) >> 16;
+  *p = pa + (( x1 + x2 + 3791 ) >> 4 );
+}
+
+static void
+Measure( void )
+{
+  unsigned short ms;
+
+  BMP085_startMeasure();
+  while (( ms = BMP085_Read_Process()) != 0 )
+    delay( ms );
+}
+
+static void
+Golden( void )
+{
+  int32_t t, p, ut, up;
+  int oss;
+
+  Reference( 27898, 23843, 0, &t, &p );
+  CHECK( t == 150 && p == 69964, "reference gives %d and %d for the datasheet example", t, p );
+
+  printf( "oss      UT      UP   T 0.1C     p Pa\n" );
+  for ( oss = 0; oss < 4; oss++ )
+  {
+    BMP085_setMode( oss, 1 );
+    for ( ut = 27898 - 4000; ut <= 27898 + 4000; ut += 2000 )
+      for ( up = ( 23843L << oss ) - ( 8000L << oss ); up <= ( 23843L << oss ) + ( 8000L << oss ); up += 4000L << oss )
+      {
+        SimBmpRaw( ut, up );
+        Measure();
+        Reference( ut, up, oss, &t, &p );
+        CHECK( lround( BaroReading.TempC * 10 ) == t && lround( BaroReading.BaromhPa * 100 ) == p,
+               "oss %d UT %d UP %d: %.1f degC %.2f hPa, expected %d and %d", oss, ut, up, BaroReading.TempC,
+               BaroReading.BaromhPa, t, p );
+        if ( ut == 27898 && up == 23843L << oss )
+          printf( "%3d %7d %7d %8.1f %8.0f\n", oss, ut, up, BaroReading.TempC * 10, BaroReading.BaromhPa * 100 );
+      }
+    SimBmpRaw( 27898, 23843L << oss );
+    Measure();
+    CHECK( labs( lround( BaroReading.BaromhPa * 100 ) - 69964 ) <= 2,
+           "oss %d: %.2f hPa for the datasheet example", oss, BaroReading.BaromhPa );
+  }
+}
+
+// with the temperature every 4 pressure samples a new UT shows at the 5th cycle
+static void
+TempReuse( void )
+{
+  int i;
+
+  BMP085_setMode( BMP085_ULTRA_HIGH_RES, 4 );
+  SimBmpRaw( 27898, 23843L << 3 );
+  Measure();
+  SimBmpRaw( 27898 + 1000, 23843L << 3 );
+  for ( i = 1; i < 4; i++ )
+  {
+    Measure();
+    CHECK( lround( BaroReading.TempC * 10 ) == 150, "cycle %d: %.1f degC, the temperature should be reused", i,
+           BaroReading.TempC );
+  }
+  Measure();
+  CHECK( lround( BaroReading.TempC * 10 ) != 150, "cycle 4: %.1f degC, the temperature wasn't measured again",
+         BaroReading.TempC );
+}
+
+int
+main( void )
+{
+  SimStart();
+  i2c_init();
+  CHECK( BMP085_init() == 0, "BMP085 not found" );
+
+  Golden();
+  TempReuse();
+  return check_done( "bmp085" );
+}
@@ -0,0 +1,156 @@
+/*
+  The button of Air_LCDuino.ino on press timelines: ISR_ButtonPress() on the simulated INT1 and EncoderPoll() every
+  INPUT_PER ms as InputTask() calls it, without the rest of the sketch consuming the counts.
+
+  Each timeline has to give its short, long and double presses. A short press counts DOUBLEPRESS_MS after the
+  release, a long one LONGPRESS_MS after the press while the button is still held. Holding the button for seconds
+  must not stop millis(), the wind cup edges or the knob, the ISR used to spin for as long as the button was down.
+*/
+#include "Air_LCDuino.ino"
+#include "check.h"
+
+struct Timeline
+{
+  const char *name;
+  unsigned short ms[6];         // down, up, down ... 0 ends
+  unsigned char s, l, d;        // short, long and double presses
+};
+
+static const struct Timeline Timelines[] = {
+  { "short", { 100 }, 1, 0, 0 },
+  { "490 ms", { 490 }, 1, 0, 0 },         // either side of LONGPRESS_MS, millis() counts in steps of 1.024 ms
+  { "510 ms", { 510 }, 0, 1, 0 },
+  { "long", { 800 }, 0, 1, 0 },
+  { "double", { 100, 150, 100 }, 0, 0, 1 },
+  { "short, pause, short", { 100, 300, 100 }, 2, 0, 0 },
+  { "short then long", { 100, 150, 800 }, 1, 1, 0 },
+  { "bounce", { 100, 5, 100 }, 1, 0, 0 },
+  { "double, bounce", { 100, 150, 50, 10, 50 }, 0, 0, 1 },
+  { "held 3 s", { 3000 }, 0, 1, 0 },
+};
+
+// the input task for ms
+static void
+Poll( unsigned long ms )
+{
+  unsigned long i;
+
+  for ( i = 0; i < ms / INPUT_PER; i++ )
+  {
+    SimAdvance( INPUT_PER * 1000UL );
+    EncoderPoll();
+  }
+}
+
+static void
+Button( bool down )
+{
+  SimPin( Enc_PRESS_PIN, !down );
+  SimIrqCheck();
+}
+
+static void
+Click( int dir )
+{
+  SimPin( Enc_B_PIN, dir == Enc_DIRECTION );
+  SimPin( Enc_A_PIN, 0 );
+  SimIrqCheck();
+  SimAdvance( 1000 );
+  SimPin( Enc_A_PIN, 1 );
+}
+
+static void
+Run( const struct Timeline *t )
+{
+  unsigned char s = ShortPressCnt, l = LongPressCnt, d = DoublePressCnt;
+  int i;
+
+  for ( i = 0; i < 6 && t->ms[i]; i++ )
+  {
+    Button( !( i & 1 ));
+    Poll( t->ms[i] );
+  }
+  Button( false );
+  Poll( 1000 );
+  s = ShortPressCnt - s;
+  l = LongPressCnt - l;
+  d = DoublePressCnt - d;
+  CHECK( s == t->s && l == t->l && d == t->d, "%s: %u short %u long %u double, expected %u %u %u", t->name, s, l, d,
+         t->s, t->l, t->d );
+}
+
+// when the presses count
+static void
+Latency( void )
+{
+  unsigned char s = ShortPressCnt, l = LongPressCnt;
+
+  Button( true );
+  Poll( 100 );
+  Button( false );
+  Poll( DOUBLEPRESS_MS - INPUT_PER );
+  CHECK( ShortPressCnt == s, "short press counted before DOUBLEPRESS_MS" );
+  Poll( 2 * INPUT_PER );
+  CHECK( ShortPressCnt == s + 1, "short press not counted DOUBLEPRESS_MS after the release" );
+
+  Button( true );
+  Poll( LONGPRESS_MS - INPUT_PER );
+  CHECK( LongPressCnt == l, "long press counted before LONGPRESS_MS" );
+  Poll( 2 * INPUT_PER );
+  CHECK( LongPressCnt == l + 1, "long press not counted while held" );
+  Button( false );
+  Poll( 1000 );
+}
+
+// the wind cups, millis() and the knob carry on while the button is held
+static void
+Held( void )
+{
+  unsigned long t, dt;
+  char knob = EncoderCnt, pressed = EncoderPressedCnt;
+  int i;
+
+  World.wind_mph = 25;
+  Poll( 2000 );
+  WindRead();
+  t = millis();
+
+  Button( true );
+  for ( i = 0; i < 3; i++ )
+  {
+    Poll( 1000 );
+    Click( 1 );
+  }
+  WindRead();
+  dt = millis() - t;
+  CHECK( dt >= 3000 && dt < 3000 + INPUT_PER, "millis() went on by %lu ms in 3 s", dt );
+  CHECK( WindSpdMPH == 25, "%u mph from the edges during a 3 s press, expected 25", WindSpdMPH );
+  Button( false );
+  Poll( 1000 );
+  CHECK( EncoderPressedCnt - pressed == 3 && EncoderCnt == knob, "3 clicks while held: %d pressed and %d plain",
+         EncoderPressedCnt - pressed, EncoderCnt - knob );
+  printf( "3 s press: millis() +%lu, wind %u mph, %d knob clicks\n", dt, WindSpdMPH,
+          EncoderPressedCnt - pressed );
+}
+
+int
+main( void )
+{
+  unsigned i;
+
+  SimPin( Enc_A_PIN, 1 );
+  SimPin( Enc_PRESS_PIN, 1 );
+  SimStart();
+  attachInterrupt( 0, ISR_KnobTurn, FALLING );
+  attachInterrupt( 1, ISR_ButtonPress, CHANGE );
+  WindSetup();
+  Poll( 100 );
+
+  for ( i = 0; i < sizeof( Timelines ) / sizeof( Timelines[0] ); i++ )
+    Run( &Timelines[i] );
+  printf( "%u press timelines\n", i );
+  Latency();
+  Held();
+
+  return check_done( "buttons" );
+}
@@ -0,0 +1,41 @@
+/*
+ * Helpers shared by the host checks in tools/check, see tools/Makefile.
+ *
+ * A check is a program that includes the firmware sources it exercises and links the simulated MCU of tools/sim
+ * (hal.cpp, twi.cpp, world.cpp) for the registers, the time and the devices on the I2C bus. It prints what it
+ * measured, a line for every failed CHECK() and returns non zero from check_done() if any failed.
+ */
+
+#ifndef CHECK_H
+#define	CHECK_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include "sim.h"
+
+static unsigned check_fails, check_count;
+
+static void
+check_fail( const char *file, int line, const char *fmt, ... )
+{
+  va_list ap;
+
+  printf( "%s:%d: FAIL ", file, line );
+  va_start( ap, fmt );
+  vprintf( fmt, ap );
+  va_end( ap );
+  printf( "\n" );
+  check_fails++;
+}
+
+// CHECK( condition, printf style message of what went wrong )
+#define CHECK( c, ... ) do { check_count++; if ( !( c )) check_fail( __FILE__, __LINE__, __VA_ARGS__ ); } while ( 0 )
+
+static int
+check_done( const char *name )
+{
+  printf( "%s: %u checks, %u failed\n", name, check_count, check_fails );
+  return check_fails ? 1 : 0;
+}
+
+#endif	/* CHECK_H */
@@ -0,0 +1,212 @@
+/*
+  PrintValue() of Air_LCDuino.ino and ShadowLCD::printFixed() against the float print the screens used before, the
+  Print::printFloat() of the Arduino 1.6 core, in the 32 bit float the AVR has for double. Every screen with a value
+  is run over its range in both units, on a grid finer than the last decimal and at random, and up to 10^7 into the
+  values too wide for the field. It is built with WITH_WIND and WetBulbTemp, the RPM screen prints without decimals
+  as the wind direction does, over the whole field.
+
+  The field has to read as the float print would, right aligned in front of the unit, with the decimals that don't
+  fit left off and '*' where even the integer doesn't fit. The two round in float differently, a value within a few
+  float steps of half a digit can come out one apart in the last digit, those are counted and not more are allowed.
+  The float print shows "-0.00" for a small negative value, printFixed() leaves the sign off.
+*/
+#include "Air_LCDuino.ino"
+#include "check.h"
+
+#define TIE_REL 1e-6            // relative distance to half a digit where the float rounding may go either way
+
+struct Range
+{
+  const char *label;
+  float lo[2], hi[2];           // imperial and metric
+};
+
+static const struct Range Ranges[] = {
+  { "Voltage ", { 0, 0 }, { 20, 20 } },
+  { "Dens Alt", { -5000, -1500 }, { 40000, 12000 } },
+  { " Alt *  ", { -5000, -1500 }, { 40000, 12000 } },
+  { "Pressure", { 8, 270 }, { 33, 1120 } },
+  { "Humidity", { 0, 0 }, { 100, 100 } },
+  { " Temp * ", { -40, -40 }, { 140, 60 } },
+  { "DewPoint", { -40, -40 }, { 140, 60 } },
+  { "Wet Bulb", { -40, -40 }, { 140, 60 } },
+  { "TDspread", { 0, 0 }, { 100, 60 } },
+  { "Wnd DIR*", { 0, 0 }, { 360, 360 } },
+  { "Wind SPD", { 0, 0 }, { 150, 240 } },
+  { "Wind AVG", { 0, 0 }, { 150, 240 } },
+  { "Wind GST", { 0, 0 }, { 150, 240 } },
+};
+
+static uint32_t Rand = 1;
+static unsigned long Values, Exact, Ties, Wrong;
+
+// 0 .. 1
+static float
+Uniform( void )
+{
+  Rand = Rand * 1103515245 + 12345;
+  return ( Rand >> 8 ) / 16777216.0f;
+}
+
+// Print::printFloat() of the Arduino 1.6 core with float for double, into s
+static void
+PrintFloat( char *s, float number, uint8_t digits )
+{
+  float rounding = 0.5, remainder;
+  unsigned long int_part;
+  int d;
+
+  if ( number < 0.0 )
+  {
+    *s++ = '-';
+    number = -number;
+  }
+  for ( d = 0; d < digits; ++d )
+    rounding /= 10.0;
+  number += rounding;
+  int_part = (unsigned long) number;
+  remainder = number - (float) int_part;
+  s += sprintf( s, "%lu", int_part );
+  if ( digits > 0 )
+    *s++ = '.';
+  while ( digits-- > 0 )
+  {
+    remainder *= 10.0;
+    d = int( remainder );
+    *s++ = '0' + d;
+    remainder -= d;
+  }
+  *s = 0;
+}
+
+// the field as the float print with as many of the decimals as fit, right aligned in width
+static void
+Reference( char *field, float v, signed char dec, unsigned char width )
+{
+  char s[32];
+
+  if ( dec < 0 )
+    sprintf( s, "%ld", lround( v / 10 ) * 10 );
+  else
+    for ( ;; )
+    {
+      PrintFloat( s, v, dec );
+      if ( dec == 0 || strlen( s ) <= width )
+        break;
+      dec--;
+    }
+  if ( s[0] == '-' && strspn( s + 1, "0." ) == strlen( s + 1 ))
+    memmove( s, s + 1, strlen( s ));      // "-0.00"
+  if ( strlen( s ) > width )
+    memset( field, '*', width );
+  else
+    sprintf( field, "%*s", width, s );
+  field[width] = 0;
+}
+
+// the field PrintValue() shows
+static void
+Shown( char *field, float v, signed char dec, unsigned char width )
+{
+  unsigned char c;
+
+  lcd.setCursor( 0, 1 );
+  PrintValue( v, dec, width );
+  lcd.refresh();
+  for ( c = 0; c < width; c++ )
+    field[c] = SimLcdChar( 1, c );
+  field[c] = 0;
+}
+
+static void
+Compare( const char *label, float v, signed char dec, unsigned char width )
+{
+  char shown[LCD_COLS + 1], ref[LCD_COLS + 1], lo[LCD_COLS + 1], hi[LCD_COLS + 1];
+
+  Values++;
+  Shown( shown, v, dec, width );
+  Reference( ref, v, dec, width );
+  if ( strcmp( shown, ref ) == 0 )
+  {
+    Exact++;
+    return;
+  }
+  Reference( lo, v * ( 1 - TIE_REL ), dec, width );
+  Reference( hi, v * ( 1 + TIE_REL ), dec, width );
+  if ( strcmp( shown, lo ) == 0 || strcmp( shown, hi ) == 0 )
+  {
+    Ties++;
+    return;
+  }
+  if ( ++Wrong <= 10 )
+    printf( "%s: %.9g shows \"%s\", the float print \"%s\"\n", label, v, shown, ref );
+}
+
+// the unit for the terminal, the degree sign of the display is 0xdf
+static const char *
+Unit( const char *unit )
+{
+  static char s[8];
+
+  strcpy( s, unit );
+  if ( strchr( s, '\xdf' ))
+    *strchr( s, '\xdf' ) = 'o';
+  return s;
+}
+
+// the screen over its range and beyond
+static void
+Screen( const struct tagScreen *scr, const struct Range *r, unsigned char metric )
+{
+  signed char dec = scr->dec[metric];
+  unsigned char width = LCD_COLS - strlen( scr->unit[metric] );
+  float lo = r->lo[metric], hi = r->hi[metric], step, v;
+  long i;
+
+  step = pow( 10, -max( dec, 0 )) / 7.3;
+  for ( v = lo, i = 0; v <= hi && i < 100000; v = lo + ++i * step )
+    Compare( scr->label, v, dec, width );
+  for ( i = 0; i < 20000; i++ )
+    Compare( scr->label, lo + ( hi - lo ) * Uniform(), dec, width );
+  for ( i = 0; i < 20000; i++ )        // up to 10^7, with the decimals that is still within the long of the AVR
+  {
+    v = pow( 10, 7 * Uniform());
+    Compare( scr->label, i & 1 ? -v : v, dec, width );
+  }
+}
+
+int
+main( void )
+{
+  const struct tagScreen *scr;
+  unsigned long values, exact, ties;
+  unsigned i, n, metric;
+
+  lcd.begin();
+  printf( "screen    unit    values     exact  ties\n" );
+  for ( n = 0; n < DISP_END; n++ )
+  {
+    scr = &Screens[n];
+    if ( !scr->get )
+      continue;
+    for ( i = 0; i < sizeof( Ranges ) / sizeof( Ranges[0] ) && strcmp( Ranges[i].label, scr->label ); i++ )
+      ;
+    CHECK( i < sizeof( Ranges ) / sizeof( Ranges[0] ), "no range for %s", scr->label );
+    if ( i == sizeof( Ranges ) / sizeof( Ranges[0] ))
+      continue;
+    for ( metric = 0; metric < 2; metric++ )
+    {
+      values = Values;
+      exact = Exact;
+      ties = Ties;
+      Screen( scr, &Ranges[i], metric );
+      printf( "%-8.8s %-5s %8lu %9lu %5lu\n", scr->label, Unit( scr->unit[metric] ), Values - values, Exact - exact,
+              Ties - ties );
+    }
+  }
+  printf( "%lu values, %lu as the float print, %lu float ties, %lu wrong\n", Values, Exact, Ties, Wrong );
+  CHECK( Wrong == 0, "%lu values wrong", Wrong );
+  CHECK( Ties * 1000 < Values, "%lu float ties", Ties );
+
+  return check_done( "format" );
+}
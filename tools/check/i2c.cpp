@@ -0,0 +1,271 @@
+/*
+  The interrupt driven TWI engine of twimaster.c against the TWI model and the sensors of tools/sim/twi.cpp.
+
+  The model completes a bus event as soon as it is started, with the I bit set a whole transaction runs inside
+  i2c_submit(). The queue is checked with the interrupts off instead, nothing moves on the bus until sei().
+  The bus recovery is counted through the delays of its bit banging.
+
+  The faults of the model are a device that NACKs the bytes written to it after its address, and one that holds SDA
+  low in the middle of a byte. The synchronous calls have to give up on the held bus within POLL_MAX_US, a queued
+  transaction stays busy until i2c_abort(), and after i2c_recover() the bus works. check/i2c_fault.cpp runs the
+  sketch through the same faults.
+*/
+#include <util/delay.h>
+#undef _delay_us
+#define _delay_us( us ) Bang( us )
+
+static unsigned long BangUs;
+
+static void
+Bang( unsigned us )
+{
+  BangUs += us;
+  delayMicroseconds( us );
+}
+
+#include "twimaster.c"
+#include "SI_7021.cpp"
+#include "check.h"
+
+#define BMP085_ADDR 0xee
+#define TMP100_ADDR 0x94
+#define POLL_MAX_US 2500        // the bound of twi_wait_int() and twi_wait_stop(), about 2ms
+
+static i2c_txn_t *Order[8];
+static unsigned Done;
+
+static void
+Record( i2c_txn_t *t )
+{
+  if ( Done < 8 )
+    Order[Done] = t;
+  Done++;
+}
+
+static void
+Setup( i2c_txn_t *t, unsigned char addr )
+{
+  memset( t, 0, sizeof( *t ));
+  t->addr = addr;
+  t->done = Record;
+}
+
+// transactions queued while the bus is busy run in order, each with its own data
+static void
+Queue( void )
+{
+  i2c_txn_t id, cal, user, conf, back;
+  unsigned char b_id = 0, b_user = 0, b_back = 0, b_cal[22];
+  i2c_txn_t *want[] = { &id, &cal, &user, &conf, &back };
+  unsigned i;
+
+  Setup( &id, BMP085_ADDR );
+  i2c_txn_read( &id, 0xd0, &b_id, 1 );
+  Setup( &cal, BMP085_ADDR );
+  i2c_txn_read( &cal, 0xaa, b_cal, sizeof( b_cal ));
+  Setup( &user, SI7021_ADDR );
+  i2c_txn_read( &user, 0xe7, &b_user, 1 );
+  Setup( &conf, TMP100_ADDR );
+  i2c_txn_write( &conf, 1, 0x60 );
+  Setup( &back, TMP100_ADDR );
+  i2c_txn_read( &back, 1, &b_back, 1 );
+
+  Done = 0;
+  cli();
+  for ( i = 0; i < 5; i++ )
+    i2c_submit( want[i] );
+  i2c_submit( &cal );                   // still queued, must not be linked in a second time
+
+  for ( i = 0; i < 5; i++ )
+    CHECK( want[i]->status == I2C_BUSY, "transaction %u done before the interrupt ran", i );
+  CHECK( TWCR & ( 1 << TWINT ), "i2c_submit() didn't start the bus" );
+
+  sei();
+  SimAdvance( 1 );
+
+  CHECK( Done == 5, "%u callbacks for 5 transactions", Done );
+  for ( i = 0; i < 5 && i < Done; i++ )
+    CHECK( Order[i] == want[i], "transaction %u completed out of order", i );
+  for ( i = 0; i < 5; i++ )
+    CHECK( want[i]->status == I2C_OK, "transaction %u status %u", i, want[i]->status );
+  CHECK( !txn_head, "queue not empty after the last transaction" );
+
+  CHECK( b_id == 0x55, "BMP085 chip id %02x", b_id );
+  CHECK( b_cal[0] == 0x01 && b_cal[1] == 0x98 && b_cal[20] == 0x0b && b_cal[21] == 0x34,
+         "BMP085 calibration AC1 %02x%02x MD %02x%02x", b_cal[0], b_cal[1], b_cal[20], b_cal[21] );
+  CHECK( b_user == 0x3a, "SI7021 user register %02x", b_user );
+  CHECK( b_back == 0x60, "TMP100 configuration %02x, wrote 60", b_back );
+}
+
+// the synchronous calls wait for the queue and work on the bus the engine left
+static void
+Shim( void )
+{
+  i2c_txn_t t;
+  unsigned char b = 0, e;
+
+  Setup( &t, SI7021_ADDR );
+  i2c_txn_read( &t, 0xe7, &b, 1 );
+  i2c_submit( &t );
+
+  e = i2c_start( BMP085_ADDR + I2C_WRITE );
+  e |= i2c_write( 0xd0 );
+  e |= i2c_rep_start( BMP085_ADDR + I2C_READ );
+  b = i2c_readNak();
+  e |= i2c_stop();
+  CHECK( t.status == I2C_OK, "queued transaction status %u", t.status );
+  CHECK( e == 0 && b == 0x55, "synchronous read of the chip id: error %u, %02x", e, b );
+
+  b = 0;
+  e = i2c_read_block( BMP085_ADDR, 0xd0, &b, 1 );
+  CHECK( e == I2C_OK && b == 0x55, "i2c_read_block(): error %u, %02x", e, b );
+}
+
+/*
+  A device that NACKs while another transaction is queued. txn_finish() starts the queued one before the driver of
+  the failed one sees the error, recovering the bus then would break it off.
+*/
+static void
+Nack( void )
+{
+  i2c_txn_t t;
+  unsigned char b = 0;
+
+  CHECK( SI7021_init() == 0, "SI7021 not found" );
+  World.hygro = false;
+  SI7021_startMeasure();
+  SI7021_Read_Process();                // queues the conversion, NACKed
+  CHECK( SI7021_Txn.status == I2C_ERR_ADDR, "SI7021 status %u, expected a NACK", SI7021_Txn.status );
+
+  Setup( &t, BMP085_ADDR );
+  i2c_txn_read( &t, 0xd0, &b, 1 );
+  BangUs = 0;
+  cli();
+  i2c_submit( &t );
+  SI7021_Read_Process();                // error path with the BMP085 transaction on the wire
+  i2c_recover();                        // and straight, while it is still queued
+  sei();
+  SimAdvance( 1 );
+
+  CHECK( BangUs == 0, "bus recovered after a NACK or with a transaction queued" );
+  CHECK( t.status == I2C_OK && b == 0x55, "queued transaction after the NACK: status %u, %02x", t.status, b );
+  CHECK( HygReading.RelHum == 1.0, "SI7021 error not reported" );
+  World.hygro = true;
+}
+
+// i2c_abort() gives up on everything queued and recovers the bus, which works afterwards
+static void
+Abort( void )
+{
+  i2c_txn_t t[2];
+  unsigned char b = 0;
+
+  Setup( &t[0], BMP085_ADDR );
+  i2c_txn_read( &t[0], 0xd0, &b, 1 );
+  Setup( &t[1], TMP100_ADDR );
+  i2c_txn_read( &t[1], 1, &b, 1 );
+  BangUs = 0;
+  Done = 0;
+  cli();
+  i2c_submit( &t[0] );
+  i2c_submit( &t[1] );
+  i2c_abort();
+  sei();
+  SimAdvance( 1 );
+
+  CHECK( t[0].status == I2C_ERR_TIMEOUT && t[1].status == I2C_ERR_TIMEOUT, "aborted transactions: status %u %u",
+         t[0].status, t[1].status );
+  CHECK( Done == 0, "callbacks of aborted transactions called" );
+  CHECK( BangUs > 0, "i2c_abort() didn't recover the bus" );
+
+  i2c_submit( &t[0] );
+  CHECK( t[0].status == I2C_OK && b == 0x55, "transaction after the abort: status %u, %02x", t[0].status, b );
+}
+
+// a transaction without data only addresses the device, with no buffer to read into
+static void
+Probe( void )
+{
+  i2c_txn_t t;
+
+  Setup( &t, BMP085_ADDR );
+  i2c_submit( &t );
+  CHECK( t.status == I2C_OK, "probe of the BMP085: status %u", t.status );
+
+  World.tmp100 = false;
+  Setup( &t, TMP100_ADDR );
+  i2c_submit( &t );
+  CHECK( t.status == I2C_ERR_ADDR, "probe of the missing TMP100: status %u", t.status );
+  World.tmp100 = true;
+}
+
+// a device that stops ACKing after its address fails the transfer with I2C_ERR_DATA and leaves the bus free
+static void
+DataNack( void )
+{
+  unsigned char b = 0, e;
+
+  SimTwiFault( BMP085_ADDR >> 1, SIM_TWI_DATA_NACK );
+  BangUs = 0;
+  e = i2c_read_block( BMP085_ADDR, 0xd0, &b, 1 );
+  CHECK( e == I2C_ERR_DATA, "read with the register address NACKed: status %u", e );
+  SimTwiFault( BMP085_ADDR >> 1, SIM_TWI_OK );
+
+  e = i2c_read_block( BMP085_ADDR, 0xd0, &b, 1 );
+  CHECK( e == I2C_OK && b == 0x55, "read after the NACK: status %u, %02x", e, b );
+  CHECK( BangUs == 0, "bus recovered after a NACK" );
+}
+
+// the synchronous calls time out on a held bus, a queued transaction stays busy until i2c_abort() recovers the bus
+static void
+Held( void )
+{
+  i2c_txn_t t;
+  unsigned char b = 0, e;
+  uint64_t start;
+
+  SimTwiFault( TMP100_ADDR >> 1, SIM_TWI_STUCK );
+  e = i2c_start( TMP100_ADDR + I2C_WRITE );
+  CHECK( e == 0, "TMP100 not addressed: %u", e );
+  start = SimNow;
+  e = i2c_write( 1 );
+  CHECK( e == I2C_ERR_TIMEOUT, "i2c_write() on the held bus returned %u", e );
+  CHECK( SimNow - start <= POLL_MAX_US, "i2c_write() gave up after %llu us", (unsigned long long) ( SimNow - start ));
+  start = SimNow;
+  e = i2c_stop();
+  CHECK( e == I2C_ERR_TIMEOUT, "i2c_stop() on the held bus returned %u", e );
+  CHECK( SimNow - start <= POLL_MAX_US, "i2c_stop() gave up after %llu us", (unsigned long long) ( SimNow - start ));
+  CHECK( SimTwiHeld(), "the bus wasn't held" );
+  i2c_recover();
+  CHECK( !SimTwiHeld(), "i2c_recover() didn't free the bus" );
+  e = i2c_read_block( TMP100_ADDR, 1, &b, 1 );
+  CHECK( e == I2C_OK && b == 0x60, "read after the recovery: status %u, %02x", e, b );
+
+  SimTwiFault( BMP085_ADDR >> 1, SIM_TWI_STUCK );
+  Setup( &t, BMP085_ADDR );
+  i2c_txn_read( &t, 0xd0, &b, 1 );
+  i2c_submit( &t );
+  SimAdvance( I2C_TXN_TIMEOUT * 1000UL );
+  CHECK( t.status == I2C_BUSY && SimTwiHeld(), "transaction on the held bus: status %u", t.status );
+  i2c_abort();
+  CHECK( t.status == I2C_ERR_TIMEOUT && !SimTwiHeld(), "i2c_abort() on the held bus: status %u", t.status );
+  b = 0;
+  i2c_submit( &t );
+  CHECK( t.status == I2C_OK && b == 0x55, "transaction after the abort: status %u, %02x", t.status, b );
+}
+
+int
+main( void )
+{
+  SimStart();
+  i2c_init();
+
+  Queue();
+  Shim();
+  Nack();
+  Abort();
+  Probe();
+  DataNack();
+  Held();
+  return check_done( "i2c" );
+}
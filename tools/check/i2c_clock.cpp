@@ -0,0 +1,120 @@
+/*
+  i2c_clock_calc() of twimaster.c against a search of every TWBR and prescaler setting, and the time a measure cycle
+  of each sensor keeps the bus busy at the standard clocks, from the bus events of tools/sim/twi.cpp.
+*/
+#include "build_opts.h"
+#include "i2cmaster.h"
+#include "BMP085_baro.h"
+#include "SI_7021.h"
+#include "TMP100.h"
+#include "check.h"
+
+#define TWBR_MIN 10             // as in twimaster.c
+
+// divisor of F_CPU for SCL
+static unsigned long
+Div( unsigned br, unsigned ps )
+{
+  return 16 + ( br << ( 1 + 2 * ps ));
+}
+
+// The fastest setting that isn't faster than asked for, the slowest one if all are. Compared on the divisors, the
+// clocks in whole Hz are rounded down.
+static unsigned long
+Best( unsigned long scl )
+{
+  unsigned long d, best = 0;
+  unsigned br, ps;
+
+  for ( ps = 0; ps < 4; ps++ )
+    for ( br = TWBR_MIN; br < 256; br++ )
+      if ( F_CPU <= scl * ( d = Div( br, ps )) && ( !best || d < best ))
+        best = d;
+  return best ? best : Div( 255, 3 );
+}
+
+static void
+Calc( unsigned long scl )
+{
+  unsigned char br, ps;
+  unsigned long f = i2c_clock_calc( scl, &br, &ps );
+  unsigned long want = Best( scl ? scl : F_CPU );
+
+  CHECK( br >= TWBR_MIN && ps < 4 && Div( br, ps ) == want, "%lu Hz: TWBR %u TWPS %u give %lu Hz, the best setting %lu Hz",
+         scl, br, ps, F_CPU / Div( br, ps ), F_CPU / want );
+  CHECK( f == F_CPU / Div( br, ps ), "%lu Hz: returned %lu Hz for TWBR %u TWPS %u", scl, f, br, ps );
+}
+
+static void
+Settings( void )
+{
+  unsigned long scl;
+  unsigned br, ps, n = 0;
+
+  for ( ps = 0; ps < 4; ps++ )          // every setting is found again from its own clock
+    for ( br = 0; br < 256; br++, n++ )
+      Calc( F_CPU / Div( br, ps ));
+  for ( scl = 0; scl <= 1200000; scl += scl < 2000 ? 1 : scl / 1000, n++ )
+    Calc( scl );
+  printf( "i2c_clock_calc: %u clocks, %lu to %lu Hz\n", n, F_CPU / Div( 255, 3 ), F_CPU / Div( TWBR_MIN, 0 ));
+}
+
+// Bus time of one measure cycle, the average over BARO_TEMP_EVERY cycles of the BMP085 with its temperature reading
+static double
+Cycle( void (*start)( void ), unsigned short (*step)( void ))
+{
+  double us = SimTwiBusUs();
+  unsigned short ms;
+  int i;
+
+  for ( i = 0; i < BARO_TEMP_EVERY; i++ )
+  {
+    start();
+    while (( ms = step()) != 0 )
+      delay( ms );
+  }
+  return ( SimTwiBusUs() - us ) / BARO_TEMP_EVERY;
+}
+
+static void
+BusTime( void )
+{
+  static const unsigned long scl[] = { 30000, 100000, 400000 };
+  double us[3][3];
+  unsigned i;
+
+  CHECK( BMP085_init() == 0 && SI7021_init() == 0 && TMP100_init() == 0, "sensors not found" );
+
+  printf( "bus time per measure cycle in ms\n    SCL   BMP085  SI7021  TMP100\n" );
+  for ( i = 0; i < 3; i++ )
+  {
+    i2c_register_device( 0xee, scl[i] );
+    i2c_register_device( 0x80, scl[i] );
+    i2c_register_device( 0x94, scl[i] );
+    us[i][0] = Cycle( BMP085_startMeasure, BMP085_Read_Process );
+    us[i][1] = Cycle( SI7021_startMeasure, SI7021_Read_Process );
+    us[i][2] = Cycle( TMP100_startMeasure, TMP100_Read_Process );
+    printf( "%7lu %8.3f %7.3f %7.3f\n", scl[i], us[i][0] / 1000, us[i][1] / 1000, us[i][2] / 1000 );
+    CHECK( SimTwiScl( 0x77 ) == F_CPU / Best( scl[i] ), "BMP085 clocked at %lu Hz", SimTwiScl( 0x77 ));
+  }
+  CHECK( us[2][0] < us[0][0] / 10 && us[2][1] < us[0][1] / 10, "400Khz isn't 10x faster than 30Khz" );
+
+  // each device at its own clock, switched before every START
+  i2c_register_device( 0xee, 100000 );
+  i2c_register_device( 0x80, 400000 );
+  Cycle( BMP085_startMeasure, BMP085_Read_Process );
+  Cycle( SI7021_startMeasure, SI7021_Read_Process );
+  CHECK( SimTwiScl( 0x77 ) == F_CPU / Best( 100000 ) && SimTwiScl( 0x40 ) == F_CPU / Best( 400000 ),
+         "per device clock: BMP085 %lu Hz, SI7021 %lu Hz", SimTwiScl( 0x77 ), SimTwiScl( 0x40 ));
+}
+
+int
+main( void )
+{
+  SimStart();
+  i2c_init();
+
+  Settings();
+  BusTime();
+  return check_done( "i2c_clock" );
+}
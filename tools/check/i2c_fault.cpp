@@ -0,0 +1,169 @@
+/*
+  The whole sketch through faults on the I2C bus, with the faults of tools/sim/twi.cpp: a sensor that NACKs the bytes
+  written to it after its address, and one that holds SDA low in the middle of a byte until the bus recovery clocks
+  it free. Each fault is set for FAULT_MS on one sensor. The TMP100 is only read without the barometer and the
+  hygrometer, its faults run on a second boot with it alone on the bus.
+
+  No task may take more than FAULT_US longer per run than without a fault: one poll of a bus event that doesn't come
+  and a bus recovery. Nothing may wait for a queued transaction, the sensor state machines give up on it with
+  i2c_abort() after I2C_TXN_TIMEOUT. A pass through loop(), without the time asleep, has to stay within LOOP_MAX_US,
+  the display rewriting every character and a fault. The sensor has to report the impossible reading of its error
+  path during the fault, and read right again within BACK_MS after it.
+*/
+#include "Air_LCDuino.ino"
+#include "check.h"
+
+#define FAULT_MS 3000
+#define BACK_MS 2000            // two measure cycles of the slowest sensor
+#define FAULT_US 2500           // the ~2ms bound of a TWI wait and the recovery
+#define LOOP_MAX_US ( LCD_SIZE * 250 + FAULT_US )
+
+// 7 bit addresses
+#define BMP085_ADDR7 0x77
+#define SI7021_ADDR7 0x40
+#define TMP100_ADDR7 0x4a
+
+static const char *Names[TASK_END] = { "input", "baro", "hygro", "temp", "display" };
+
+static unsigned long PassMax;
+static bool ErrBaro, ErrHygro, ErrTemp;
+
+// the sketch for ms, the longest pass and whether a sensor reported its error
+static void
+Run( unsigned long ms )
+{
+  uint64_t end = SimNow + ms * 1000ULL, start;
+  unsigned long slept;
+
+  while ( SimNow < end )
+  {
+    start = SimNow;
+    slept = SleepStats.sleep_us;
+    loop();
+    PassMax = max( PassMax, (unsigned long) ( SimNow - start ) - ( SleepStats.sleep_us - slept ));
+    ErrBaro |= BaroReading.TempC < -200;
+    ErrHygro |= HygReading.TempC < -200;
+    ErrTemp |= TMP100_TempC < -200;
+  }
+}
+
+// whether the readings of the sensors on the bus are those of World
+static bool
+BaroOk( void )
+{
+  return !World.baro ||
+         ( fabs( BaroReading.BaromhPa - World.hpa ) < 0.5 && fabs( BaroReading.TempC - World.temp_c ) < 0.5 );
+}
+
+static bool
+HygroOk( void )
+{
+  return !World.hygro ||
+         ( fabs( HygReading.RelHum - World.rh ) < 1 && fabs( HygReading.TempC - World.temp_c ) < 0.5 );
+}
+
+static bool
+TempOk( void )
+{
+  return !No_TMP100 && fabs( TMP100_TempC - World.temp_c ) < 0.5;
+}
+
+static bool
+AllOk( void )
+{
+  return BaroOk() && HygroOk() && ( !No_Baro || !No_Hygro || TempOk());
+}
+
+struct Fault
+{
+  const char *name;
+  uint8_t addr, fault;
+  bool *err;
+  bool (*ok)( void );
+};
+
+static const struct Fault Faults[] = {
+  { "BMP085 data NACK", BMP085_ADDR7, SIM_TWI_DATA_NACK, &ErrBaro, BaroOk },
+  { "SI7021 data NACK", SI7021_ADDR7, SIM_TWI_DATA_NACK, &ErrHygro, HygroOk },
+  { "BMP085 SDA held", BMP085_ADDR7, SIM_TWI_STUCK, &ErrBaro, BaroOk },
+  { "SI7021 SDA held", SI7021_ADDR7, SIM_TWI_STUCK, &ErrHygro, HygroOk },
+  { "TMP100 data NACK", TMP100_ADDR7, SIM_TWI_DATA_NACK, &ErrTemp, TempOk },
+  { "TMP100 SDA held", TMP100_ADDR7, SIM_TWI_STUCK, &ErrTemp, TempOk },
+};
+
+static unsigned short Clean[TASK_END];
+
+// boots with the sensors of World and takes the longest run of each task without a fault
+static void
+Boot( void )
+{
+  unsigned n;
+
+  SimPin( Enc_A_PIN, 1 );
+  SimPin( Enc_PRESS_PIN, 1 );
+  SimStart();
+  setup();
+  Run( 10000 );
+  CHECK( AllOk(), "baro %d hygro %d: readings wrong before the faults", World.baro, World.hygro );
+
+  for ( n = 0; n < TASK_END; n++ )
+    Tasks[n].max_us = 0;
+  Run( 10000 );
+  for ( n = 0; n < TASK_END; n++ )
+    Clean[n] = Tasks[n].max_us;
+}
+
+static void
+Inject( const struct Fault *f )
+{
+  unsigned long back;
+  unsigned n;
+
+  for ( n = 0; n < TASK_END; n++ )
+    Tasks[n].max_us = 0;
+  PassMax = 0;
+  ErrBaro = ErrHygro = ErrTemp = false;
+  SimTwiFault( f->addr, f->fault );
+  Run( FAULT_MS );
+  SimTwiFault( f->addr, SIM_TWI_OK );
+  for ( back = 0; back < BACK_MS && !( f->ok() && !SimTwiHeld()); back += 10 )
+    Run( 10 );
+  Run( 1000 );
+
+  printf( "%-17s", f->name );
+  for ( n = 0; n < TASK_END; n++ )
+    printf( " %5u", Tasks[n].max_us );
+  printf( " %6lu %5lu\n", PassMax, back );
+  for ( n = 0; n < TASK_END; n++ )
+    if ( n != TASK_DISPLAY )
+      CHECK( Tasks[n].max_us <= Clean[n] + FAULT_US, "%s: %s took %u us, %u us without it", f->name, Names[n],
+             Tasks[n].max_us, Clean[n] );
+  CHECK( PassMax <= LOOP_MAX_US, "%s: %lu us in loop()", f->name, PassMax );
+  CHECK( *f->err, "%s: no error reported", f->name );
+  CHECK( back < BACK_MS, "%s: reading not back after %u ms", f->name, BACK_MS );
+  CHECK( AllOk(), "%s: readings wrong after the fault", f->name );
+}
+
+int
+main( void )
+{
+  unsigned i, n;
+
+  SimQuiet = true;
+  printf( "longest run us   input  baro hygro  temp  disp  loop  back ms\n" );
+  for ( i = 0; i < sizeof( Faults ) / sizeof( Faults[0] ); i++ )
+  {
+    if ( i == 0 || ( Faults[i].addr == TMP100_ADDR7 && Faults[i - 1].addr != TMP100_ADDR7 ))
+    {
+      World.baro = World.hygro = Faults[i].addr != TMP100_ADDR7;
+      Boot();
+      printf( "%-17s", World.baro ? "none" : "none, TMP100 only" );
+      for ( n = 0; n < TASK_END; n++ )
+        printf( " %5u", Clean[n] );
+      printf( "\n" );
+    }
+    Inject( &Faults[i] );
+  }
+
+  return check_done( "i2c_fault" );
+}
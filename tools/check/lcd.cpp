@@ -0,0 +1,114 @@
+/*
+  The LCD traffic of the display updates through ShadowLCD, with the whole sketch on the simulated instrument and the
+  readings drifting as the weather does. Each screen is shown for a minute and the characters sent per update are
+  compared with the LCD_SIZE characters a rewrite of both lines sends.
+
+  Every second the display content is checked against a full rewrite: the shadow copy is invalidated and sent whole,
+  which must not change a character on the display.
+*/
+#include "Air_LCDuino.ino"
+#include "check.h"
+
+#define SHOW_MS 60000UL
+
+static uint32_t Rand = 1;
+
+// -1 .. +1
+static double
+Uniform( void )
+{
+  Rand = Rand * 1103515245 + 12345;
+  return ( Rand >> 8 ) / 8388608.0 - 1;
+}
+
+// the sketch for ms, the readings change every 100 ms
+static void
+Run( unsigned long ms )
+{
+  uint64_t end = SimNow + ms * 1000ULL, next = SimNow;
+
+  while ( SimNow < end )
+  {
+    if ( SimNow >= next )
+    {
+      World.temp_c = constrain( World.temp_c + 0.02 * Uniform(), 15, 25 );
+      World.rh = constrain( World.rh + 0.1 * Uniform(), 30, 50 );
+      World.hpa += 0.01 * Uniform();
+      World.vbus = 12.6 + 0.05 * Uniform();
+      World.wind_mph = constrain( World.wind_mph + Uniform(), 5, 20 );
+      World.wind_dir = fmod( World.wind_dir + 3 * Uniform() + 360, 360 );
+      next += 100000;
+    }
+    loop();
+  }
+}
+
+// the characters a rewrite of the display changes, from what the updates left on it
+static unsigned
+Differs( void )
+{
+  uint8_t before[LCD_ROWS][LCD_COLS], r, c;
+  unsigned n = 0;
+
+  for ( r = 0; r < LCD_ROWS; r++ )
+    for ( c = 0; c < LCD_COLS; c++ )
+      before[r][c] = SimLcdChar( r, c );
+  lcd.invalidate();
+  lcd.refresh();
+  for ( r = 0; r < LCD_ROWS; r++ )
+    for ( c = 0; c < LCD_COLS; c++ )
+      n += SimLcdChar( r, c ) != before[r][c];
+  return n;
+}
+
+int
+main( void )
+{
+  unsigned long bytes, updates, all_bytes = 0, all_updates = 0, t, full;
+  unsigned differ;
+  unsigned char n;
+
+  SimPin( Enc_A_PIN, 1 );
+  SimPin( Enc_PRESS_PIN, 1 );
+  SimQuiet = true;
+  SimStart();
+  setup();
+  Run( 3000 );
+
+  printf( "screen    updates  chars/update  rewrite\n" );
+  for ( n = 0; n < DISP_END; n++ )
+  {
+    if ( !( ScreenAvail & ( 1UL << n )))
+      continue;
+    EncoderCnt = n;
+    Run( 1000 );
+
+    bytes = updates = 0;
+    differ = 0;
+    for ( t = 0; t < SHOW_MS; t += 1000 )
+    {
+      full = SimLcdWrites;
+      differ += Differs();
+      full = SimLcdWrites - full;
+      CHECK( full == LCD_SIZE, "a rewrite sent %lu characters", full );
+
+      updates -= Tasks[TASK_DISPLAY].runs;
+      bytes -= SimLcdWrites;
+      Run( 1000 );
+      updates += Tasks[TASK_DISPLAY].runs;
+      bytes += SimLcdWrites;
+    }
+    printf( "%-8.8s %8lu %13.2f %8u\n", Screens[n].label, updates, (double) bytes / updates, LCD_SIZE );
+    CHECK( EncoderCnt == n, "%.8s: the display went to screen %d", Screens[n].label, EncoderCnt );
+    CHECK( differ == 0, "%.8s: %u characters on the display differ from the shadow copy", Screens[n].label, differ );
+    CHECK( bytes <= updates * LCD_SIZE, "%.8s: %.2f characters per update", Screens[n].label,
+           (double) bytes / updates );
+    all_bytes += bytes;
+    all_updates += updates;
+  }
+  printf( "all screens %.2f characters per update, %.0f%% of a rewrite\n", (double) all_bytes / all_updates,
+          100.0 * all_bytes / ( all_updates * LCD_SIZE ));
+  CHECK( all_bytes * 2 < all_updates * LCD_SIZE, "more than half of the characters sent" );
+
+  return check_done( "lcd" );
+}
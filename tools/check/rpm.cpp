@@ -0,0 +1,136 @@
+/*
+  RPM.cpp on the simulated Timer1 and pin change interrupt, with the sensor edges placed by the check at the exact
+  times of a speed in us, and RPM_Read() called every SAMPLE_PER ms as the scheduler does.
+
+  From idle through redline and on into the edge averaging above 8400 RPM the reading has to be within 1 RPM of
+  the speed, the edge count of a second it replaced had steps of 30 RPM. After a change of speed the reading has to
+  settle within the time of RPM_EDGES + 1 sensor periods at the new speed plus one update, or within two updates
+  where the edges since the last one are averaged, and go to 0 within RPM_TIMEOUT once the edges stop.
+
+  tools/Makefile builds it again as rpm-prof with WITH_PROFILE, where the handlers take time stamps from TCNT1. Each
+  handler region has to bump RPM_Seq then, the regions of the main loop must not.
+*/
+#include "RPM.cpp"
+#include "check.h"
+
+#ifdef WITH_PROFILE
+#define NAME "rpm-prof"
+#else
+#define NAME "rpm"
+#endif
+
+#define READ_US ( SAMPLE_PER * 1000ULL )
+
+static double Rpm;              // speed of the edges
+static double Tedge;            // time of the next pin change in us
+
+static double
+HalfPeriodUs( void )
+{
+  return 30e6 / ( Rpm * RPM_PULSES_PER_REV );
+}
+
+// the edges and the updates for ms
+static void
+Run( unsigned long ms )
+{
+  uint64_t end = SimNow + ms * 1000ULL, read, t;
+
+  while ( SimNow < end )
+  {
+    read = ( SimNow / READ_US + 1 ) * READ_US;
+    t = min( end, read );
+    if ( Rpm > 0 && Tedge < t )
+      t = max( SimNow, (uint64_t) llround( Tedge ));
+    SimAdvance( t - SimNow );
+    if ( Rpm > 0 && SimNow >= (uint64_t) llround( Tedge ))
+    {
+      SimPin( RPM_PIN, !SimPinLevel( RPM_PIN ));
+      SimIrqCheck();
+      Tedge += HalfPeriodUs();
+    }
+    if ( SimNow == read )
+      RPM_Read();
+  }
+}
+
+// ms until the reading is within 1 RPM of the new speed, the bound
+static unsigned long
+Step( double rpm, unsigned long *bound )
+{
+  uint64_t t0 = SimNow;
+
+  if ( Rpm == 0 )
+    Tedge = SimNow + 1;
+  Rpm = rpm;
+  if ( rpm == 0 )
+    *bound = RPM_TIMEOUT / 2000 + SAMPLE_PER;
+  else if (( RPM_EDGES - 1 ) * 60.0 * RPM_TICKS_PER_SEC / ( rpm * RPM_PULSES_PER_REV ) < RPM_MIN_SPAN )
+    *bound = 2 * SAMPLE_PER;    // all edges since the last update, the one before has a period of the old speed
+  else
+    *bound = ( RPM_EDGES + 1 ) * 60000 / ( rpm * RPM_PULSES_PER_REV ) + SAMPLE_PER;
+  do
+    Run( SAMPLE_PER );
+  while ( fabs( RPM_ - rpm ) > 1 && SimNow - t0 < 10000000 );
+  return ( SimNow - t0 ) / 1000;
+}
+
+static void
+Check( double rpm )
+{
+  unsigned long ms, bound;
+
+  ms = Step( rpm, &bound );
+  Run( 1000 );
+  CHECK( ms <= bound, "%.2f RPM: settled after %lu ms, bound %lu ms", rpm, ms, bound );
+  CHECK( fabs( RPM_ - rpm ) <= 1, "%.2f RPM: reads %d", rpm, RPM_ );
+  printf( "%9.2f %7d %8lu %6lu\n", rpm, RPM_, ms, bound );
+}
+
+#ifdef WITH_PROFILE
+static void
+Regions( void )
+{
+  prof_t start;
+  unsigned char r, seq;
+
+  for ( r = 0; r < PROF_N; r++ )
+  {
+    Prof_Stamp( &start );
+    seq = RPM_Seq;
+    Prof_Add( r, &start );
+    CHECK(( RPM_Seq != seq ) == ( r >= PROF_ISR_KNOB ), "region %u: RPM_Seq %s", r,
+          RPM_Seq != seq ? "bumped from the main loop" : "not bumped from a handler" );
+  }
+}
+#endif
+
+int
+main( void )
+{
+  double rpm;
+  unsigned long ms, bound;
+
+  SimStart();
+  RPM_Setup();
+#ifdef WITH_PROFILE
+  Prof_Setup();
+  Regions();
+#endif
+
+  printf( "      RPM    read  settle  bound ms\n" );
+  for ( rpm = 300.37; rpm < 13000; rpm *= 1.25 )
+    Check( rpm );
+  Check( 2400 );
+  Check( 2401 );                // sub RPM steps show
+  Check( 600 );                 // idle to redline and back
+  Check( 6000 );
+  Check( 600 );
+
+  ms = Step( 0, &bound );
+  CHECK( RPM_ == 0 && ms <= bound, "stopped: reads %d after %lu ms", RPM_, ms );
+  printf( "%9d %7d %8lu %6lu\n", 0, RPM_, ms, bound );
+  Check( 600 );                 // and starting again
+
+  return check_done( NAME );
+}
@@ -0,0 +1,125 @@
+/*
+  The scheduler of Sched.h with the tasks of Air_LCDuino.ino, on the simulated clock for hours, with all sensors on
+  the bus and the wind or the engine running. tools/Makefile builds it for each of WITH_WIND and WITH_RPM and for
+  neither, and with WITH_TELEMETRY.
+
+  Per task it reports the runs, the execution time, the jitter, how late a run started against when it was due, the
+  overruns and the share of the CPU. The counters are taken every minute, busy_us wraps after 71 minutes. The
+  execution time is what the calls into the core, the LCD and the bus take in tools/sim, not the instructions in
+  between. No task may overrun with the knob left alone, none may start later than JITTER_MS and after the boot
+  screen each has to run at least once per period.
+
+  The time in SchedIdle() is summed the same way, the CPU has to sleep at least ASLEEP_MIN % of the time in every
+  configuration and wake up within WAKE_MAX_US of the timer tick that made a task due. As the instructions of the
+  tasks take no simulated time the share asleep is an upper bound, what the bus, the LCD and the UART keep the CPU
+  awake for is in it. The wake latency is read from TCNT0 as on the target, it is the tick handler and the check of
+  the time after it. A tick handler that takes SLOW_TICK_US, as a slow core or a long handler at the tick would, has
+  to show as a latency over the bound.
+*/
+#include "Air_LCDuino.ino"
+#include "check.h"
+
+#define HOURS 2
+#define JITTER_MS 5
+#define ASLEEP_MIN 95           // % of the time
+#define WAKE_MAX_US 100         // from the timer tick to the scheduler running
+#define SLOW_TICK_US ( 2 * WAKE_MAX_US )
+
+#ifdef WITH_WIND
+#define CFG_WIND_RPM "-wind"
+#elif defined(WITH_RPM)
+#define CFG_WIND_RPM "-rpm"
+#else
+#define CFG_WIND_RPM "-none"
+#endif
+#ifdef WITH_TELEMETRY
+#define CFG_TELEM "-telem"
+#else
+#define CFG_TELEM ""
+#endif
+
+static const char *Names[TASK_END] = {
+  "input",
+#ifdef WITH_WIND
+  "wind",
+#elif defined(WITH_RPM)
+  "rpm",
+#endif
+  "baro",
+  "hygro",
+  "temp",
+#ifdef WITH_TELEMETRY
+  "telem",
+#endif
+  "display",
+};
+
+int
+main( void )
+{
+  uint64_t busy[TASK_END] = { 0 }, all = 0, asleep = 0, end, start = 0;
+  uint32_t seen[TASK_END] = { 0 }, slept = 0;
+  unsigned long runs[TASK_END];
+  unsigned long periods, late;
+  unsigned i, min;
+  struct tagTask *t;
+
+  SimQuiet = true;
+  World.wind_mph = 12;
+  World.wind_dir = 270;
+  World.rpm = 2400;
+  SimPin( Enc_A_PIN, 1 );
+  SimPin( Enc_PRESS_PIN, 1 );
+  SimStart();
+  setup();
+  for ( min = 0; min < HOURS * 60; min++ )
+  {
+    end = SimNow + 60000000ULL;
+    while ( SimNow < end )
+      loop();
+    for ( i = 0; i < TASK_END; i++ )
+    {
+      busy[i] += (uint32_t) ( Tasks[i].busy_us - seen[i] );     // as the 32 bits of the AVR wrap
+      seen[i] = Tasks[i].busy_us;
+      if ( min == 0 )
+        runs[i] = Tasks[i].runs;
+    }
+    asleep += (uint32_t) ( SleepStats.sleep_us - slept );
+    slept = SleepStats.sleep_us;
+    if ( min == 0 )
+      start = SimNow;
+  }
+
+  printf( "%u h on the simulated clock\n", HOURS );
+  printf( "task     period     runs   avg us   max us  late ms  overruns   CPU %%\n" );
+  for ( i = 0; i < TASK_END; i++ )
+  {
+    t = &Tasks[i];
+    printf( "%-8s %6u %8lu %8.1f %8u %8u %9u %7.3f\n", Names[i], t->period, t->runs, (double) busy[i] / t->runs,
+            t->max_us, t->max_late, t->overruns, busy[i] * 100.0 / SimNow );
+    all += busy[i];
+
+    periods = ( SimNow - start ) / 1000 / t->period;
+    late = t->max_late;
+    CHECK( t->overruns == 0, "%s: %u overruns", Names[i], t->overruns );
+    CHECK( late <= JITTER_MS, "%s: started %lu ms late", Names[i], late );
+    CHECK( t->runs - runs[i] >= periods, "%s: %lu runs in %lu periods", Names[i], t->runs - runs[i], periods );
+  }
+  printf( "all tasks %.3f%% of the CPU\n", all * 100.0 / SimNow );
+  printf( "asleep %.2f%%, %lu naps, wake latency avg %lu us max %u us\n", asleep * 100.0 / SimNow, SleepStats.naps,
+          SleepStats.wake_us / SleepStats.naps, SleepStats.wake_max );
+  CHECK( asleep * 100 >= ASLEEP_MIN * SimNow, "asleep %.2f%% of the time", asleep * 100.0 / SimNow );
+  CHECK( SleepStats.wake_max > 0, "woke up with TCNT0 at 0" );
+  CHECK( SleepStats.wake_max <= WAKE_MAX_US, "woke up %u us after the timer tick", SleepStats.wake_max );
+
+  SimTickIsrUs = SLOW_TICK_US;
+  SleepStats.wake_max = 0;
+  end = SimNow + 10000000ULL;
+  while ( SimNow < end )
+    loop();
+  printf( "with a tick handler of %u us: wake latency max %u us\n", SLOW_TICK_US, SleepStats.wake_max );
+  CHECK( SleepStats.wake_max > WAKE_MAX_US, "a tick handler of %u us left the wake latency at %u us", SLOW_TICK_US,
+         SleepStats.wake_max );
+
+  return check_done( "sched" CFG_WIND_RPM CFG_TELEM );
+}
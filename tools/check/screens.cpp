@@ -0,0 +1,176 @@
+/*
+  The knob through the screen table of Air_LCDuino.ino, for every combination of the sensors answering on the bus.
+  tools/Makefile builds it once per build option combination, with and without WITH_WIND, WITH_RPM and WetBulbTemp.
+
+  The knob is turned one click at a time through two rounds forward and two backward, and the display has to show
+  the next screen that has its sensors in table order, wrapping around at the ends, within a few INPUT_PER of the
+  click. Which screens need which sensor is written out here from the labels, not taken from the table. A long press
+  on the Temp screen has to show the other unit as soon as the press counts as long. Without wind or RPM and without
+  any sensor setup() waits for the watchdog, that combination isn't run.
+*/
+#include "Air_LCDuino.ino"
+#include "check.h"
+
+#define SHOWN_MS ( 3 * INPUT_PER )      // from a click to the new screen
+
+#ifdef WITH_WIND
+#define CFG_WIND_RPM "-wind"
+#elif defined(WITH_RPM)
+#define CFG_WIND_RPM "-rpm"
+#else
+#define CFG_WIND_RPM ""
+#endif
+#ifdef WetBulbTemp
+#define CFG_WETBULB "-wetbulb"
+#else
+#define CFG_WETBULB ""
+#endif
+
+struct Need
+{
+  const char *label;
+  unsigned char baro, hygro, temp;      // shown with the barometer, the hygrometer, any temperature
+};
+
+static const struct Need Needs[] = {
+  { "Dens Alt", 1, 0, 0 },
+  { " Alt *  ", 1, 0, 0 },
+  { "Pressure", 1, 0, 0 },
+  { "Humidity", 0, 1, 0 },
+  { " Temp * ", 0, 0, 1 },
+  { "DewPoint", 0, 1, 0 },
+  { "Wet Bulb", 0, 1, 0 },
+  { "TDspread", 0, 1, 0 },
+};
+
+// the sketch for ms
+static void
+Run( unsigned long ms )
+{
+  uint64_t end = SimNow + ms * 1000ULL;
+
+  while ( SimNow < end )
+    loop();
+}
+
+static void
+Click( int dir )
+{
+  SimPin( Enc_B_PIN, dir == Enc_DIRECTION );
+  SimPin( Enc_A_PIN, 0 );
+  SimIrqCheck();
+  SimAdvance( 1000 );
+  SimPin( Enc_A_PIN, 1 );
+}
+
+// the label on the display
+static void
+Shown( char *label )
+{
+  unsigned char c;
+
+  for ( c = 0; c < LCD_COLS; c++ )
+    label[c] = SimLcdChar( 0, c );
+  label[c] = 0;
+}
+
+static bool
+Expected( unsigned char n )
+{
+  unsigned i;
+
+  for ( i = 0; i < sizeof( Needs ) / sizeof( Needs[0] ); i++ )
+    if ( strcmp( Needs[i].label, Screens[n].label ) == 0 )
+      return ( !Needs[i].baro || World.baro ) && ( !Needs[i].hygro || World.hygro ) &&
+             ( !Needs[i].temp || World.baro || World.hygro || World.tmp100 );
+  return !( Screens[n].flags & SCR_HIDDEN );
+}
+
+// the screen after n in direction dir that can be shown
+static unsigned char
+Next( unsigned char n, int dir )
+{
+  do
+    n = ( n + DISP_END + dir ) % DISP_END;
+  while ( !Expected( n ));
+  return n;
+}
+
+// two rounds in direction dir from the screen shown, returns the screens shown
+static unsigned
+Walk( int dir )
+{
+  char label[LCD_COLS + 1];
+  unsigned char n = EncoderCnt, avail = 0, i;
+  unsigned shown = 0;
+
+  for ( i = 0; i < DISP_END; i++ )
+    avail += Expected( i );
+  for ( i = 0; i < 2 * avail; i++ )
+  {
+    n = Next( n, dir );
+    Click( dir );
+    Run( SHOWN_MS );
+    Shown( label );
+    CHECK( strcmp( label, Screens[n].label ) == 0, "baro %d hygro %d tmp100 %d: %s after a click %+d, expected %s",
+           World.baro, World.hygro, World.tmp100, label, dir, Screens[n].label );
+    shown++;
+    Run( 300 );
+  }
+  return shown;
+}
+
+// a long press on the Temp screen toggles the unit right away
+static void
+LongPress( void )
+{
+  unsigned char i, unit;
+
+  for ( i = 0; i < DISP_END && strcmp( Screens[i].label, " Temp * " ) != 0; i++ )
+    ;
+  if ( i == DISP_END || !Expected( i ))
+    return;
+  EncoderCnt = i;
+  Run( 1500 );
+  unit = SimLcdChar( 1, LCD_COLS - 1 );
+
+  SimPin( Enc_PRESS_PIN, 0 );
+  SimIrqCheck();
+  Run( LONGPRESS_MS + SHOWN_MS );
+  CHECK( SimLcdChar( 1, LCD_COLS - 1 ) != unit, "baro %d hygro %d tmp100 %d: unit %c %d ms into a long press",
+         World.baro, World.hygro, World.tmp100, unit, LONGPRESS_MS + SHOWN_MS );
+  SimPin( Enc_PRESS_PIN, 1 );
+  SimIrqCheck();
+  Run( 1000 );
+}
+
+int
+main( void )
+{
+  unsigned char sensors;
+  unsigned shown = 0, runs = 0;
+
+  SimQuiet = true;
+  for ( sensors = 0; sensors < 8; sensors++ )
+  {
+    World.baro = sensors & 1;
+    World.hygro = sensors & 2;
+    World.tmp100 = sensors & 4;
+#if !defined(WITH_WIND) && !defined(WITH_RPM)
+    if ( !sensors )
+      continue;
+#endif
+    SimPin( Enc_A_PIN, 1 );
+    SimPin( Enc_PRESS_PIN, 1 );
+    SimStart();
+    setup();
+    Run( 2000 );
+    shown += Walk( 1 );
+    shown += Walk( -1 );
+    LongPress();
+    runs++;
+  }
+  printf( "%u sensor combinations, %u screens shown by the knob\n", runs, shown );
+
+  return check_done( "screens" CFG_WIND_RPM CFG_WETBULB );
+}
@@ -0,0 +1,169 @@
+/*
+  The sequence byte of SeqLock.h under interrupts at every point of a read. The AVR loads a 16 or 32 bit value a byte
+  at a time, so the shared data here is kept in bytes and the reader loads them one by one, as the compiled code does.
+  A handler is run after every single load of a read in turn, and after two of them, for counts that carry into the
+  high byte.
+
+  Every value read has to be one the handler wrote, whole. The differences of the free running count the main loop
+  works with can't be more than the edges in between, and have to add up to the edges the handler counted. The same
+  reads without the sequence byte tear, which shows the check can see it.
+*/
+#include "SeqLock.h"
+#include "check.h"
+
+#define RING 4
+
+// an edge counter with a ring of time stamps as in RPM.cpp, in bytes, low byte first
+static volatile unsigned char Cnt[2];
+static volatile unsigned char Edge[RING][4];
+static seq_t Seq;
+
+static unsigned Loads, Fire[2];         // the loads of a read so far, the handler runs after load Fire[0] and Fire[1]
+static unsigned long Edges;
+
+// the time stamp of edge n, a different value in each byte
+static uint32_t
+Stamp( unsigned short n )
+{
+  return 0x01010101UL * ( n & 0xff ) + 0x80402010UL;
+}
+
+static void
+Isr( void )
+{
+  unsigned short n = Cnt[0] | Cnt[1] << 8;
+  uint32_t t = Stamp( n );
+  int i;
+
+  for ( i = 0; i < 4; i++ )
+    Edge[n & ( RING - 1 )][i] = t >> ( 8 * i );
+  n++;
+  Cnt[0] = n;
+  Cnt[1] = n >> 8;
+  Edges++;
+  SeqWrite( &Seq );
+}
+
+static unsigned char
+Load( volatile unsigned char *b )
+{
+  unsigned char v = *b;
+
+  Loads++;
+  if ( Loads == Fire[0] || Loads == Fire[1] )
+    Isr();
+  return v;
+}
+
+// the count and the stamp of the last edge, as RPM_Read() copies them
+static void
+Read( unsigned short *n, uint32_t *last, bool seqlock )
+{
+  unsigned char seq = 0, i;
+
+  do
+  {
+    if ( seqlock )
+      seq = SeqBegin( &Seq );
+    *n = Load( &Cnt[0] );
+    *n |= Load( &Cnt[1] ) << 8;
+    for ( *last = 0, i = 0; i < 4; i++ )
+      *last |= (uint32_t) Load( &Edge[( *n - 1 ) & ( RING - 1 )][i] ) << ( 8 * i );
+  } while ( seqlock && SeqRetry( &Seq, seq ));
+}
+
+static void
+Set( unsigned short n )
+{
+  while (( Cnt[0] | Cnt[1] << 8 ) != n )
+    Isr();
+}
+
+// a read with the handler after loads f0 and f1, 0 for none
+static void
+ReadAt( unsigned f0, unsigned f1, bool seqlock, unsigned short *n, uint32_t *last )
+{
+  Loads = 0;
+  Fire[0] = f0;
+  Fire[1] = f1;
+  Read( n, last, seqlock );
+}
+
+// every placement of one or two handlers from a count, the read has to give the count before or after a handler
+static unsigned long
+Placements( unsigned short start, bool seqlock )
+{
+  unsigned short n;
+  uint32_t last;
+  unsigned long torn = 0;
+  unsigned f0, f1;
+
+  for ( f0 = 0; f0 <= 6; f0++ )
+    for ( f1 = f0 ? f0 + 1 : 0; f1 <= ( f0 ? 12 : 0 ); f1++ )
+    {
+      Set( start );
+      ReadAt( f0, f1, seqlock, &n, &last );
+      if ( last != Stamp( n - 1 ) || (unsigned short) ( n - start ) > ( f0 != 0 ) + ( f1 != 0 ))
+        torn++;
+    }
+  return torn;
+}
+
+// The main loop adds up the differences of the count across the reads, the handlers run at every placement in turn.
+// Between the reads more edges bring the low byte to 0xff, so a handler during a read carries into the high byte. A
+// difference can't be more than the edges since the read before started, a torn read is off by 255. Returns the
+// differences that were, and the sum of all of them has to match the edges.
+static unsigned long
+Sum( bool seqlock, unsigned long *off )
+{
+  unsigned short n, prev;
+  uint32_t last;
+  unsigned long sum = 0, edges, before, bad = 0;
+  unsigned f0, f1, k;
+
+  Set( 0xff00 );
+  edges = before = Edges;
+  ReadAt( 0, 0, seqlock, &prev, &last );
+  for ( k = 0; k < 2; k++ )
+    for ( f0 = 0; f0 <= 6; f0++ )
+      for ( f1 = f0 + 1; f1 <= 12; f1++ )
+      {
+        while ( Cnt[0] != 0xff )
+          Isr();
+        ReadAt( f0, f1, seqlock, &n, &last );
+        if ( (unsigned short) ( n - prev ) > Edges - before )
+          bad++;
+        sum += (unsigned short) ( n - prev );
+        before = Edges;
+        prev = n;
+      }
+  ReadAt( 0, 0, seqlock, &n, &last );
+  sum += (unsigned short) ( n - prev );
+  *off = labs( (long) ( sum - ( Edges - edges )));
+  return bad;
+}
+
+int
+main( void )
+{
+  static const unsigned short start[] = { 1, 0x00fe, 0x00ff, 0x0100, 0x7fff, 0xfffe, 0xffff, 0 };
+  unsigned long torn = 0, raw = 0, bad, lost, raw_lost;
+  unsigned i;
+
+  for ( i = 0; i < sizeof( start ) / sizeof( start[0] ); i++ )
+  {
+    torn += Placements( start[i], true );
+    raw += Placements( start[i], false );
+  }
+  printf( "handler at every load: %lu torn reads, %lu without the sequence byte\n", torn, raw );
+  CHECK( torn == 0, "%lu torn reads", torn );
+  CHECK( raw > 0, "the check doesn't see torn reads" );
+
+  bad = Sum( true, &lost );
+  raw = Sum( false, &raw_lost );
+  printf( "differences of the count: %lu too large and %lu counts off, %lu and %lu without the sequence byte\n", bad,
+          lost, raw, raw_lost );
+  CHECK( bad == 0 && lost == 0, "%lu differences too large, %lu counts off", bad, lost );
+
+  return check_done( "seqlock" );
+}
@@ -0,0 +1,14 @@
+/*
+  What the sensor and wind modules use of Air_LCDuino.ino, for the checks that link them without the sketch: the
+  display and the knob counts of the calibration screens, which the checks don't go into.
+*/
+#include <LiquidCrystal.h>
+#include "ShadowLCD.h"
+
+char EncoderCnt;
+unsigned char ShortPressCnt;
+
+static LiquidCrystal lcd_hw( 9, 8, 6, 7, 4, 5 );
+ShadowLCD lcd( lcd_hw );
+
+void EncoderPoll( void ) {}
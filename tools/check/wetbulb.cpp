@@ -0,0 +1,126 @@
+/*
+  The WETBULB_SOLVER of Atmos.c against the root of the wet bulb equation found by bisection in double precision,
+  over -40..+60 degC, 300..1100 hPa and 1..100 %RH, with the exp() calls counted. tools/Makefile builds it once per
+  solver, with the ATMOS_MATH of build_opts.h.
+
+  Each solver but Stull's evaluates the saturation vapor pressure once for the air and once per iteration, so the
+  iterations are the exp() calls less 1. Stull's fit is only checked where it was made, at 1013 hPa for 5..99 %RH, and
+  from 0 to 50 degC. It is within -1..+0.65 degC of his own reference, within 1.5 degC of the equation here, and
+  worse in cold dry air, which he leaves out as well.
+*/
+#include <math.h>
+
+static unsigned long ExpCalls;
+
+static inline double
+CountExp( double x )
+{
+  ExpCalls++;
+  return exp( x );
+}
+
+#define exp( x ) CountExp( x )
+#include "Atmos32.c"
+#undef exp
+#include "check.h"
+
+#if WETBULB_SOLVER == WETBULB_NEWTON
+#define SOLVER "newton"
+#define ERR_MAX 0.01            // degC
+#define EXP_MAX ( 1 + 5 )       // at most 5 iterations, see Atmos.c
+#elif WETBULB_SOLVER == WETBULB_STULL
+#define SOLVER "stull"
+#define ERR_MAX 1.5
+#define EXP_MAX 0
+#else
+#define SOLVER "search"
+#define ERR_MAX 0.05            // reported, a guess close enough is stepped past once more
+#define EXP_MAX ( 1 + WETBULB_MAX_STEPS )
+#endif
+
+#if ATMOS_MATH == ATMOS_FIXED
+#define KERNEL "fixed"
+#elif ATMOS_MATH == ATMOS_TABLES
+#define KERNEL "tables"
+#else
+#define KERNEL "float"
+#endif
+
+static double
+Es( double t )
+{
+  return 6.112 * exp( 17.67 * t / ( t + 243.5 ));
+}
+
+static double
+Psy( double twb, double t, double p, double e )
+{
+  return Es( twb ) - p * ( t - twb ) * 0.00066 * ( 1 + 0.00115 * twb ) - e;
+}
+
+// the root lies between the dew point and T, F() grows with Twb
+static double
+Reference( double t, double p, double rh )
+{
+  double e = Es( t ) * rh / 100, lo = -100, hi = t, mid;
+  int i;
+
+  for ( i = 0; i < 100; i++ )
+  {
+    mid = ( lo + hi ) / 2;
+    if ( Psy( mid, t, p, e ) > 0 )
+      hi = mid;
+    else
+      lo = mid;
+  }
+  return ( lo + hi ) / 2;
+}
+
+int
+main( void )
+{
+  double t, p, rh, err, max_err = 0, stull_err = 0, at[3] = { 0, 0, 0 };
+  unsigned long n = 0, calls = 0, max_calls = 0, bad = 0;
+
+  for ( t = -40; t <= 60; t += 1 )
+    for ( p = 300; p <= 1100; p += 50 )
+      for ( rh = 1; rh <= 100; rh += 3 )
+      {
+        ExpCalls = 0;
+        err = fabs( T_wetbulb_C( t, p, rh ) - Reference( t, p, rh ));
+        n++;
+        calls += ExpCalls;
+        if ( ExpCalls > max_calls )
+          max_calls = ExpCalls;
+        if ( err > ERR_MAX )
+          bad++;
+        if ( err > max_err )
+        {
+          max_err = err;
+          at[0] = t;
+          at[1] = p;
+          at[2] = rh;
+        }
+      }
+
+  for ( t = 0; t <= 50; t += 1 )          // where Stull's fit holds
+    for ( rh = 5; rh <= 99; rh += 2 )
+      if (( err = fabs( T_wetbulb_C( t, 1013.25, rh ) - Reference( t, 1013.25, rh ))) > stull_err )
+        stull_err = err;
+
+  printf( "WETBULB_SOLVER %s, ATMOS_MATH %s, %lu points\n", SOLVER, KERNEL, n );
+  printf( "  exp() calls avg %.2f max %lu\n", (double) calls / n, max_calls );
+  printf( "  max error %.5f degC at %g degC %g hPa %g %%RH, %lu points off by more than %g\n", max_err, at[0], at[1],
+          at[2], bad, ERR_MAX );
+  printf( "  max error at 1013 hPa, 0..50 degC, 5..99 %%RH %.5f degC\n", stull_err );
+
+#if ATMOS_MATH != ATMOS_TABLES
+  CHECK( max_calls <= EXP_MAX, "%lu exp() calls, at most %d expected", max_calls, EXP_MAX );
+#endif
+#if WETBULB_SOLVER == WETBULB_STULL
+  CHECK( stull_err < ERR_MAX, "error %.4f degC where the fit holds", stull_err );
+#elif WETBULB_SOLVER == WETBULB_NEWTON
+  CHECK( max_err < ERR_MAX, "error %.4f degC at %g degC %g hPa %g %%RH", max_err, at[0], at[1], at[2] );
+#endif
+  return check_done( "wetbulb-" SOLVER );
+}
@@ -0,0 +1,351 @@
+/*
+  The wind history of Wind.cpp against a brute force reference that keeps every 1 second sample, for a synthetic
+  series of 3 hours with steady wind, gusts, spikes and calm spells. The samples go straight into WindHistAdd(), the
+  wind cups and the vane are left out.
+
+  The 2 minute average is exact. The 10 minute average and gust are exact for the first 10 minutes, where they cover
+  only the samples so far, and whenever a minute completes. In between the part of the oldest minute still inside the
+  window is pro rated from its sum, which is off by no more than its spread, and the gust covers all of that minute.
+
+  The hour average and gust and the minute summaries of WindHistory() are exact, the report sets the RAM they take
+  against the 600 bytes of samples the 10 minutes used to take, and the 3600 bytes an hour of them would.
+
+  The mean directions are checked across the wrap at north, where a plain average of the angles gives south, for
+  every whole degree, for calm and for wind that turns all around, and against the vector mean of the samples as a
+  minute completes. WindRead() is checked on the simulated vane, at 359 and 0 degrees and with the vane below the
+  calibrated minimum. That one would have wrapped in the 16 bit unsigned int of the AVR, on the host int is wider.
+
+  The timing compares WindHistAdd() with the rescan of a 600 sample array it replaced, in ns on the host. The AVR
+  cycles would take a cycle accurate simulator.
+*/
+#include <time.h>
+#include "Wind.cpp"
+#include "check.h"
+
+#define SECS ( 3 * 3600UL )
+#define WIN10 600
+
+static unsigned char Samples[SECS];
+
+// steady wind that slowly changes, gusts, a few spikes to full scale and two calm spells
+static void
+MakeSeries( void )
+{
+  unsigned long k, r = 12345;
+  double v;
+
+  for ( k = 0; k < SECS; k++ )
+  {
+    r = r * 1103515245 + 12345;
+    v = 12 + 8 * sin( k / 700.0 ) + ( r >> 16 ) % 7;
+    if ( k % 97 < 5 )
+      v += 15 + ( r >> 20 ) % 10;
+    if ( k % 1801 == 0 )
+      v = 255;
+    if (( k >= 1500 && k < 1700 ) || ( k >= 5000 && k < 5700 ))
+      v = 0;
+    Samples[k] = constrain( v, 0, 255 );
+  }
+}
+
+// average of the n samples up to and including k, rounded as Wind.cpp does
+static unsigned
+RefAvg( unsigned long k, unsigned long n )
+{
+  unsigned long i, sum = 0;
+
+  n = min( n, k + 1 );
+  for ( i = 0; i < n; i++ )
+    sum += Samples[k - i];
+  return ( sum + n / 2 ) / n;
+}
+
+// highest 3 second average that ends within the n samples up to k
+static unsigned
+RefGust( unsigned long k, unsigned long n )
+{
+  unsigned long i, g = 0;
+
+  n = min( n, k + 1 );
+  for ( i = k + 1 - n; i <= k; i++ )
+    g = max( g, RefAvg( i, 3 ));
+  return g;
+}
+
+// spread of the samples of the oldest minute the 10 minute window reaches into, that are still inside it
+static unsigned
+RefSpread( unsigned long k, unsigned long n )
+{
+  unsigned long i, lo = 255, hi = 0;
+
+  for ( i = k + 1 - WIN10; i < k + 1 - WIN10 + n; i++ )
+  {
+    lo = min( lo, Samples[i] );
+    hi = max( hi, Samples[i] );
+  }
+  return n ? hi - lo : 0;
+}
+
+// the hour values are updated as a minute completes, over the full minutes so far
+static void
+Hour( unsigned long k )
+{
+  unsigned long n = min( k + 1, WIND_HIST_MIN * WIND_MIN_SAMPLES );
+
+  CHECK( WindAvgHourMPH == RefAvg( k, n ) && WindGustHourMPH == RefGust( k, n ),
+         "%lu s: hour average %u gust %u, expected %u and %u", k, WindAvgHourMPH, WindGustHourMPH, RefAvg( k, n ),
+         RefGust( k, n ));
+}
+
+static void
+Averages( void )
+{
+  unsigned long k, n, avg, exact = 0, off = 0;
+  long err, max_err = 0;
+
+  for ( k = 0; k < SECS; k++ )
+  {
+    WindHistAdd( Samples[k], 0 );
+
+    CHECK( WindAvg2MPH == RefAvg( k, WIND_SEC_N ), "%lu s: 2 minute average %u, expected %u", k, WindAvg2MPH,
+           RefAvg( k, WIND_SEC_N ));
+
+    n = ( k + 1 ) % WIND_MIN_SAMPLES ? WIND_MIN_SAMPLES - ( k + 1 ) % WIND_MIN_SAMPLES : 0;
+    avg = RefAvg( k, WIN10 );
+    if ( n == 0 )
+      Hour( k );
+    if ( k < WIN10 || n == 0 )
+    {
+      exact++;
+      CHECK( WindAvgMPH == avg && WindGustMPH == RefGust( k, WIN10 ),
+             "%lu s: 10 minute average %u gust %u, expected %lu and %u", k, WindAvgMPH, WindGustMPH, avg,
+             RefGust( k, WIN10 ));
+    }
+    else
+    {
+      err = (long) WindAvgMPH - (long) avg;
+      if ( labs( err ) > labs( max_err ))
+        max_err = err;
+      if ( err )
+        off++;
+      CHECK( labs( err ) <= ( RefSpread( k, n ) * n + WIN10 - 1 ) / WIN10 + 1,
+             "%lu s: 10 minute average %u, expected %lu", k, WindAvgMPH, avg );
+      CHECK( WindGustMPH >= RefGust( k, WIN10 ) && WindGustMPH <= RefGust( k, WIN10 + WIND_MIN_SAMPLES - n ),
+             "%lu s: gust %u, expected %u..%u", k, WindGustMPH, RefGust( k, WIN10 ),
+             RefGust( k, WIN10 + WIND_MIN_SAMPLES - n ));
+    }
+  }
+  printf( "%lu s of samples, 10 minute average and gust exact at %lu of them\n", SECS, exact );
+  printf( "  pro rated 10 minute average off at %lu s, by at most %ld mph\n", off, max_err );
+}
+
+// the minute summaries at the end of the series and the RAM of the history
+static void
+History( void )
+{
+  struct tagWindMinute m = { 0, 0, 0, 0 };
+  unsigned long k, end, ago, sum, lo, hi, gust;
+  unsigned ram;
+
+  for ( ago = 1; ago <= WIND_HIST_MIN; ago++ )
+  {
+    CHECK( WindHistory( ago, &m ), "no minute %lu ago", ago );
+    end = SECS - ( ago - 1 ) * WIND_MIN_SAMPLES;
+    sum = hi = 0;
+    lo = 255;
+    for ( k = end - WIND_MIN_SAMPLES; k < end; k++ )
+    {
+      sum += Samples[k];
+      lo = min( lo, Samples[k] );
+      hi = max( hi, Samples[k] );
+    }
+    gust = RefGust( end - 1, WIND_MIN_SAMPLES );
+    CHECK( m.sum == sum && m.min == lo && m.max == hi && m.gust == gust,
+           "minute %lu ago: sum %u min %u max %u gust %u, expected %lu %lu %lu %lu", ago, m.sum, m.min, m.max, m.gust,
+           sum, lo, hi, gust );
+  }
+  CHECK( !WindHistory( WIND_HIST_MIN + 1, &m ), "history beyond %d minutes", WIND_HIST_MIN );
+
+  ram = sizeof( Wind_Sec ) + sizeof( Wind_Min ) + sizeof( Wind_Cur ) + sizeof( Wind_CurSecs ) + sizeof( SecNdx )
+      + sizeof( SecValid ) + sizeof( MinNdx ) + sizeof( MinValid ) + sizeof( Wind_Sum2 ) + sizeof( Wind_Sum9 )
+      + sizeof( Wind_Cnt9 ) + sizeof( Wind_Gust9 ) + sizeof( Wind_10th );
+  // the sizes on the AVR, 4 bytes for an unsigned long and no padding after the 5 bytes of a minute
+  ram -= sizeof( Wind_Sum9 ) - 4 + ( WIND_HIST_MIN + 2 ) * ( sizeof( struct tagWindMinute ) - 5 );
+  printf( "  history of %d minutes in %u bytes, 10 minutes of samples took %d, an hour would take %d\n",
+          WIND_HIST_MIN, ram, WIN10, WIND_HIST_MIN * WIND_MIN_SAMPLES );
+  CHECK( ram <= WIN10, "the history takes %u bytes", ram );
+}
+
+static unsigned
+DirDiff( short a, short b )
+{
+  unsigned d = abs( a - b ) % 360;
+
+  return min( d, 360 - d );
+}
+
+// 11 minutes of a pattern, then both mean directions are over the pattern alone
+static void
+Feed( unsigned char spd, short dir0, short dir1, short turn )
+{
+  unsigned long k;
+
+  for ( k = 0; k < 11UL * WIND_MIN_SAMPLES; k++ )
+    WindHistAdd( spd, ( k & 1 ? dir1 : dir0 ) + k * turn % 360 );
+}
+
+// vector mean of the speed weighted directions of the n samples up to k
+static void
+RefDir( const unsigned char *spd, const short *dir, unsigned long k, unsigned long n, short *mean, double *steady )
+{
+  double e = 0, v = 0, sum = 0, a;
+  unsigned long i;
+
+  for ( i = k + 1 - n; i <= k; i++ )
+  {
+    e += spd[i] * sin( dir[i] * M_PI / 180 );
+    v += spd[i] * cos( dir[i] * M_PI / 180 );
+    sum += spd[i];
+  }
+  a = atan2( e, v ) * 180 / M_PI;
+  *mean = lround( a < 0 ? a + 360 : a ) % 360;
+  *steady = sum ? hypot( e, v ) / sum * 100 : 0;
+}
+
+static void
+Direction( void )
+{
+  static unsigned char spd[SECS];
+  static short dir[SECS];
+  unsigned long k, r = 777;
+  short d, mean;
+  double steady;
+  unsigned max_d = 0, max_s = 0;
+
+  // 350 and 10 degrees in turn average to 180 as plain numbers
+  Feed( 10, 350, 10, 0 );
+  CHECK( DirDiff( WindDir2, 0 ) <= 1 && DirDiff( WindDir10, 0 ) <= 1 && WindSteady2 >= 97 && WindSteady10 >= 97,
+         "350 and 10 deg: mean %d and %d deg, steady %u and %u%%", WindDir2, WindDir10, WindSteady2, WindSteady10 );
+  printf( "  350 and 10 deg in turn: mean %d deg, steady %u%%\n", WindDir10, WindSteady10 );
+
+  for ( d = 0; d < 360; d++ )
+  {
+    Feed( 20, d, d, 0 );
+    CHECK( DirDiff( WindDir2, d ) <= 1 && DirDiff( WindDir10, d ) <= 1 && WindSteady2 >= 99 && WindSteady10 >= 99,
+           "%d deg: mean %d and %d deg, steady %u and %u%%", d, WindDir2, WindDir10, WindSteady2, WindSteady10 );
+  }
+
+  Feed( 15, 0, 0, 3 );          // a full turn every 2 minutes
+  CHECK( WindSteady2 <= 2 && WindSteady10 <= 2, "turning all around: steady %u and %u%%", WindSteady2, WindSteady10 );
+  Feed( 0, 90, 90, 0 );
+  CHECK( WindDir2 == -1 && WindDir10 == -1 && WindSteady10 == 0, "calm: mean %d and %d deg", WindDir2, WindDir10 );
+
+  // gusty wind swinging across north
+  for ( k = 0; k < SECS; k++ )
+  {
+    r = r * 1103515245 + 12345;
+    spd[k] = ( r >> 16 ) % 40;
+    dir[k] = ( 360 + lround( 40 * sin( k / 300.0 )) + ( r >> 24 ) % 31 - 15 ) % 360;
+    WindHistAdd( spd[k], dir[k] );
+    if (( k + 1 ) % WIND_MIN_SAMPLES == 0 && k >= WIN10 )
+    {
+      RefDir( spd, dir, k, WIND_SEC_N, &mean, &steady );
+      max_d = max( max_d, DirDiff( WindDir2, mean ));
+      max_s = max( max_s, (unsigned) fabs( WindSteady2 - steady ));
+      RefDir( spd, dir, k, WIN10, &mean, &steady );
+      max_d = max( max_d, DirDiff( WindDir10, mean ));
+      max_s = max( max_s, (unsigned) fabs( WindSteady10 - steady ));
+    }
+  }
+  printf( "  against the vector mean: direction off by %u deg, steadiness by %u%%\n", max_d, max_s );
+  CHECK( max_d <= 1 && max_s <= 1, "mean direction off by %u deg, steadiness by %u%%", max_d, max_s );
+}
+
+static void
+Vane( double deg )
+{
+  World.wind_dir = deg;
+  SimAdvance( 100000 );         // new ADC results
+  WindRead();
+}
+
+static void
+Read( void )
+{
+  SimStart();
+  ADC_Setup();
+
+  Vane( 359.5 );
+  CHECK( WindDir == 359, "vane at 359.5 deg: %ld", WindDir );
+  Vane( 0 );
+  CHECK( WindDir == 0, "vane at 0 deg: %ld", WindDir );
+  WindCal.WDir_offs = 10;
+  Vane( 355.5 );
+  CHECK( WindDir == 5, "vane at 355.5 deg with 10 deg offset: %ld", WindDir );
+
+  // the vane reads 70 at north, 30 counts below a minimum of 100 are 30 / 560 of a turn short of north
+  WindCal.WDir_offs = 0;
+  WindCal.WDir_min = 100;
+  Vane( 0 );
+  CHECK( WindDir == 341, "vane below the calibrated minimum: %ld", WindDir );
+}
+
+// the 600 sample rescan WindRead() did before, with its float sum
+static unsigned char Old[WIN10];
+
+static void
+OldAdd( unsigned char spd )
+{
+  static unsigned short ndx;
+  unsigned short i;
+  float sum = 0;
+
+  Old[ndx] = spd;
+  ndx = ( ndx + 1 ) % WIN10;
+  WindGustMPH = 0;
+  for ( i = 0; i < WIN10; i++ )
+  {
+    sum += Old[i];
+    if ( Old[i] > WindGustMPH )
+      WindGustMPH = Old[i];
+  }
+  WindAvgMPH = sum / WIN10 + 0.5;
+}
+
+static double
+Ns( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+Timing( void )
+{
+  unsigned long k;
+  double t0, t1, t2;
+
+  t0 = Ns();
+  for ( k = 0; k < SECS; k++ )
+    WindHistAdd( Samples[k], k % 360 );
+  t1 = Ns();
+  for ( k = 0; k < SECS; k++ )
+    OldAdd( Samples[k] );
+  t2 = Ns();
+  printf( "  per sample on the host: WindHistAdd() %.0f ns, the 600 sample rescan %.0f ns\n", ( t1 - t0 ) / SECS,
+          ( t2 - t1 ) / SECS );
+}
+
+int
+main( void )
+{
+  MakeSeries();
+  Averages();
+  History();
+  Direction();
+  Read();
+  Timing();
+  return check_done( "wind" );
+}
@@ -0,0 +1,72 @@
+/*
+  The rolling 10 minute gust and average of WindRead() with the block maxima, as Wind.cpp had them before the tiered
+  history of WindHistAdd() replaced them, against a brute force max and mean over the last 600 samples. tools/Makefile
+  takes that Wind.cpp and its Wind.h out of the git history into build/blockmax, the check is left out without it.
+
+  WindRead() takes each sample itself, from the edges counted in WindCnt over a second of simulated time. The series
+  is 4 hours of random wind, rising and falling ramps, spikes to near full scale and a calm spell. The reference
+  keeps the samples WindRead() made of it, in WindSpdMPH, so the rounding of the wind cups is left out. Gust and
+  average have to agree bit for bit at every second, during the first 10 minutes over the samples so far.
+*/
+#include "blockmax/Wind.cpp"
+#include "check.h"
+
+#define SECS ( 4 * 3600UL )
+#define WIN10 WIND_GUST_PER
+
+// what WindDirCal() uses of Air_LCDuino.ino, the check doesn't go into it
+unsigned char ShortPressCnt;
+unsigned char EncoderCnt;
+LiquidCrystal lcd( 9, 8, 6, 7, 4, 5 );
+
+static unsigned char Samples[SECS];
+
+// the wind in mph at second k, in stretches of 20 minutes that cut through the block boundaries
+static double
+Series( unsigned long k, unsigned long *r )
+{
+  unsigned long t = k % 1200;
+
+  *r = *r * 1103515245 + 12345;
+  switch ( k / 1200 % 5 )
+  {
+    case 0:                                     // random
+      return ( *r >> 16 ) % 40;
+    case 1:                                     // rising ramp
+      return t / 30.0 + ( *r >> 16 ) % 3;
+    case 2:                                     // falling ramp
+      return 60 - t / 25.0;
+    case 3:                                     // spiky, now and then to near full scale
+      return t % 37 == 0 ? 200 + ( *r >> 16 ) % 50 : t % 11 < 2 ? 30 + ( *r >> 16 ) % 20 : 8;
+    default:                                    // calm
+      return t < 700 ? 0 : ( *r >> 16 ) % 4;
+  }
+}
+
+int
+main( void )
+{
+  unsigned long k, i, n, r = 1, sum, peak;
+
+  SimStart();
+  for ( k = 0; k < SECS; k++ )
+  {
+    delay( WIND_SAMPLE_PER + 2 );                 // millis() steps by 2 now and then, WindRead() would skip a second
+    WindCnt = lround( Series( k, &r ) * ANEMO_COUNT_Rev / ANEMO_CONST );
+    WindRead();
+    CHECK( WindCnt == 0, "%lu s: no sample taken", k );
+    Samples[k] = WindSpdMPH;
+
+    n = min( k + 1, WIN10 );
+    sum = peak = 0;
+    for ( i = k + 1 - n; i <= k; i++ )
+    {
+      sum += Samples[i];
+      peak = max( peak, Samples[i] );
+    }
+    CHECK( WindGustMPH == peak && WindAvgMPH == ( sum + n / 2 ) / n, "%lu s: gust %u average %u, expected %lu and %lu",
+           k, WindGustMPH, WindAvgMPH, peak, ( sum + n / 2 ) / n );
+  }
+  printf( "%lu s of samples, gust and average of the block maxima against the last %d samples\n", SECS, WIN10 );
+  return check_done( "wind_blockmax" );
+}
@@ -0,0 +1,157 @@
+/*
+  Lists the static RAM, .data and .bss, of the built firmware per module and the largest variables, from the
+  symbols of the ELF. What is left of the 2Kb of the 328P is shared by the stack and the free SRAM, see Mem.h for
+  how much of it the stack actually uses.
+
+  Build on the host, run on the ELF the Arduino IDE leaves in its build folder (File/Preferences, verbose compile
+  output shows where):
+	cc -o ram_usage tools/ram_usage.c
+	avr-nm -C -S -l --size-sort /tmp/build.../Air_LCDuino.ino.elf | ./ram_usage
+
+  -l takes the module from the debug info, symbols without it are listed under "?". .data costs flash as well, for
+  its initial values. Weak symbols, the static locals of inline functions, can't be told apart from flash and are
+  left out.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RAM_SIZE 2048
+#define MAX_MODS 128
+#define MAX_SYMS 2048
+#define TOP_SYMS 15
+
+struct mod
+{
+	char name[64];
+	unsigned long data, bss;
+};
+
+struct sym
+{
+	char name[64];
+	char mod[64];
+	unsigned long size;
+	char type;
+};
+
+static struct mod mods[MAX_MODS];
+static struct sym syms[MAX_SYMS];
+static int nmods, nsyms;
+
+// file name without the directories and the line number
+static void
+module_of( const char *loc, char *mod, size_t n )
+{
+	const char *s = strrchr( loc, '/' );
+	size_t len;
+
+	s = s ? s + 1 : loc;
+	len = strcspn( s, ":\r\n" );
+	if ( len >= n )
+		len = n - 1;
+	memcpy( mod, s, len );
+	mod[len] = 0;
+}
+
+static struct mod *
+find_mod( const char *name )
+{
+	int i;
+
+	for ( i = 0; i < nmods; i++ )
+		if ( !strcmp( mods[i].name, name ) )
+			return &mods[i];
+	if ( nmods == MAX_MODS )
+		return NULL;
+	snprintf( mods[nmods].name, sizeof( mods[0].name ), "%s", name );
+	return &mods[nmods++];
+}
+
+static int
+by_total( const void *a, const void *b )
+{
+	const struct mod *x = a, *y = b;
+
+	return (int) (y->data + y->bss) - (int) (x->data + x->bss);
+}
+
+static int
+by_size( const void *a, const void *b )
+{
+	const struct sym *x = a, *y = b;
+
+	return (int) y->size - (int) x->size;
+}
+
+int
+main( void )
+{
+	char line[1024], mod[64], *name, *loc;
+	unsigned long addr, size, data = 0, bss = 0;
+	struct mod *m;
+	char type;
+	int i, n;
+
+	while ( fgets( line, sizeof( line ), stdin ) )
+	{
+		if ( sscanf( line, "%lx %lx %c %n", &addr, &size, &type, &n ) != 3 )
+			continue;			// no size, an address label
+		if ( !strchr( "bBdD", type ) )
+			continue;
+
+		name = line + n;		// demangled names can have blanks, the location follows a tab
+		loc = strchr( name, '\t' );
+		if ( loc )
+		{
+			*loc++ = 0;
+			module_of( loc, mod, sizeof( mod ) );
+		}
+		else
+			strcpy( mod, "?" );
+		name[strcspn( name, "\r\n" )] = 0;
+
+		if ( !(m = find_mod( mod )) )
+			continue;
+		if ( type == 'd' || type == 'D' )
+		{
+			m->data += size;
+			data += size;
+		}
+		else
+		{
+			m->bss += size;
+			bss += size;
+		}
+
+		if ( nsyms < MAX_SYMS )
+		{
+			snprintf( syms[nsyms].name, sizeof( syms[0].name ), "%.63s", name );
+			strcpy( syms[nsyms].mod, mod );
+			syms[nsyms].size = size;
+			syms[nsyms].type = type;
+			nsyms++;
+		}
+	}
+
+	if ( !nsyms )
+	{
+		fprintf( stderr, "no .data or .bss symbols with a size in the input, see the usage in tools/ram_usage.c\n" );
+		return 1;
+	}
+
+	qsort( mods, nmods, sizeof( mods[0] ), by_total );
+	qsort( syms, nsyms, sizeof( syms[0] ), by_size );
+
+	printf( "%-24s %6s %6s %6s\n", "module", "data", "bss", "total" );
+	for ( i = 0; i < nmods; i++ )
+		printf( "%-24s %6lu %6lu %6lu\n", mods[i].name, mods[i].data, mods[i].bss, mods[i].data + mods[i].bss );
+	printf( "%-24s %6lu %6lu %6lu\n\n", "total", data, bss, data + bss );
+	printf( "%lu of %d bytes static, %ld left for the stack\n\n", data + bss, RAM_SIZE, (long) RAM_SIZE - (long) (data + bss) );
+
+	printf( "largest variables\n" );
+	for ( i = 0; i < nsyms && i < TOP_SYMS; i++ )
+		printf( "%6lu %c %-32s %s\n", syms[i].size, syms[i].type, syms[i].name, syms[i].mod );
+
+	return 0;
+}
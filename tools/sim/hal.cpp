@@ -0,0 +1,632 @@
+/*
+  The simulated MCU: clock, interrupts, pins, ADC, Timer0/Timer1, UART, watchdog, LCD and EEPROM, see sim.cpp.
+
+  SimNow is the time in us. It moves on when the firmware calls into the core, each call costs about what it takes on
+  the target, and when it sleeps. The hardware events up to the new time are raised then, and their interrupts run
+  when the I bit is set and no other handler is running, in the priority order of the AVR vectors. A raised flag
+  stays pending while the interrupts are off and a second event of the same source in that time is lost, as on the
+  chip. Code that spins on a memory location without calling into the core doesn't see time move, the simulation
+  reports that after a second of real time instead of hanging.
+
+  A handler takes ISR_US for its entry and reti and whatever its calls into the core take, the millis() tick of the
+  core SimTickIsrUs. TCNT0 counts the time since the last tick, after a wake up it shows how long the tick handler
+  and what ran after it took.
+*/
+#include <stdio.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include <LiquidCrystal.h>
+#include <EEPROM.h>
+#include <avr/wdt.h>
+#include <avr/sleep.h>
+#include "sim.h"
+
+#define NEVER UINT64_MAX
+#define T0_TICK_US 1024         // Timer0 overflow at clk/64, the millis() tick
+#define ISR_US 2                // entry and reti of an interrupt handler
+#define T1_OVF_US 32768         // Timer1 overflow at clk/8
+#define ADC_CONV_US 104         // 13 ADC clocks at 125Khz
+#define LCD_BYTE_US 250         // LiquidCrystal sends a byte in 4 bit mode with 100us enable pulses
+#define LCD_HOME_US 2000
+#define LCD_QUIET_US 5000       // the display is printed once it has been left alone this long
+
+uint64_t SimNow;
+bool SimQuiet;
+unsigned SimTickIsrUs = 4;      // the TIMER0_OVF_vect of the core, about 60 cycles
+
+// interrupt handlers of the firmware, weak as some build options and the checks of tools/check leave them unused
+extern "C" __attribute__(( weak )) void TWI_vect( void ) {}
+extern "C" __attribute__(( weak )) void ADC_vect( void ) {}
+extern "C" __attribute__(( weak )) void TIMER1_OVF_vect( void ) {}
+extern "C" __attribute__(( weak )) void PCINT1_vect( void ) {}
+extern "C" __attribute__(( weak )) void USART_UDRE_vect( void ) {}
+
+// in the priority order of the AVR vectors
+enum { IRQ_INT0, IRQ_INT1, IRQ_PCINT1, IRQ_T1OVF, IRQ_T0OVF, IRQ_UDRE, IRQ_ADC, IRQ_TWI, IRQ_N };
+
+static bool Pending[IRQ_N];
+static bool InIsr;
+static unsigned long HookCnt;
+
+static void (*ExtInt[2])( void );
+static int ExtMode[2];
+
+static uint8_t Level[20];       // pin levels, inputs and outputs
+
+static uint64_t T0Ticks;
+static uint64_t T1Ovfs;         // Timer1 overflows since reset, it runs from reset on in here
+static unsigned long T0Millis, T0Ovf;     // timer0_millis and timer0_overflow_count of the core
+static unsigned char T0Fract;
+static uint64_t AdcDone = NEVER;
+static uint8_t AdcCh;
+static uint64_t NextEdge = NEVER;
+
+static uint64_t WdtTimeout, WdtLast;
+
+static uint64_t UartDone = NEVER;       // end of the stop bit of the byte in the shift register
+static uint8_t UartShift;
+static int UartBuf = -1;                // the byte waiting in UDR0, -1 while UDR0 is empty
+const char *SimUartFile;
+static FILE *UartOut;
+unsigned long SimUartBytes, SimUartOverruns;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  registers ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static void SregWrite( uint8_t v ) { SREG.set( v ); SimIrqCheck(); }
+void SimSei( void ) { SREG.set( SREG.raw() | 0x80 ); }   // the pending interrupts run at the next call into the core
+static uint8_t PincRead( void ) { return ( Level[14] << PC0 ) | ( Level[16] << PC2 ) | ( 1 << PC4 ) | ( 1 << PC5 ); }
+static uint8_t Tifr1Read( void ) { return Pending[IRQ_T1OVF] << TOV1; }
+static uint8_t Tcnt0Read( void ) { return ( SimNow % T0_TICK_US ) / 4; }
+static uint16_t Tcnt1Read( void ) { return ( SimNow * 2 ) & 0xffff; }
+static uint8_t Ucsr0aRead( void ) { return ( UCSR0A.raw() & ( 1 << U2X0 )) | ( UartBuf < 0 ) << UDRE0; }
+static void Ucsr0bWrite( uint8_t v ) { UCSR0B.set( v ); SimIrqCheck(); }
+static void Udr0Write( uint8_t v );
+
+SimReg<uint8_t> SREG( NULL, SregWrite );
+SimReg<uint8_t> PINC( PincRead, NULL );
+SimReg<uint8_t> TIFR1( Tifr1Read, NULL );
+SimReg<uint8_t> TCNT0( Tcnt0Read, NULL );
+SimReg<uint16_t> TCNT1( Tcnt1Read, NULL );
+SimReg<uint8_t> UCSR0A( Ucsr0aRead, NULL );
+SimReg<uint8_t> UCSR0B( NULL, Ucsr0bWrite );
+SimReg<uint8_t> UDR0( NULL, Udr0Write );
+
+uint8_t PCICR, PCMSK1, PORTC;
+uint8_t ADMUX, ADCSRA, ADCSRB;
+uint16_t ADC;
+uint8_t TCCR1A, TCCR1B, TIMSK1;
+uint8_t UCSR0C;
+uint16_t UBRR0;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  UART ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// 8N1, the start, 8 data and the stop bit at the rate UBRR0 and U2X0 give
+static uint64_t
+UartByteUs( void )
+{
+  return ( UBRR0 + 1UL ) * ( UCSR0A.raw() & ( 1 << U2X0 ) ? 8 : 16 ) * 10 / 16;
+}
+
+// UDR0 takes the next byte while the shift register sends the last one, a write while it is full is lost
+static void
+Udr0Write( uint8_t v )
+{
+  if ( !( UCSR0B.raw() & ( 1 << TXEN0 )))
+    return;
+  if ( UartDone == NEVER )
+  {
+    UartShift = v;
+    UartDone = SimNow + UartByteUs();
+  }
+  else if ( UartBuf < 0 )
+    UartBuf = v;
+  else
+    SimUartOverruns++;
+}
+
+// The byte in the shift register is out, the one waiting in UDR0 follows right away
+static void
+UartSent( void )
+{
+  if ( SimUartFile && !UartOut && !( UartOut = fopen( SimUartFile, "wb" )))
+  {
+    perror( SimUartFile );
+    exit( 2 );
+  }
+  if ( UartOut )
+    putc( UartShift, UartOut );
+  SimUartBytes++;
+  if ( UartBuf < 0 )
+  {
+    UartDone = NEVER;
+    return;
+  }
+  UartShift = UartBuf;
+  UartBuf = -1;
+  UartDone += UartByteUs();
+}
+
+// the data register empty interrupt stays pending for as long as UDR0 is empty and it is enabled
+static bool UdrePending( void ) { return ( UCSR0B.raw() & ( 1 << UDRIE0 )) && UartBuf < 0; }
+
+void
+SimUartClose( void )
+{
+  if ( UartOut )
+    fclose( UartOut );
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  interrupts and time ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static void
+T0Overflow( void )        // what the core's TIMER0_OVF_vect does for millis()
+{
+  T0Ovf++;
+  T0Millis++;
+  T0Fract += 3;
+  if ( T0Fract >= 125 )
+  {
+    T0Fract -= 125;
+    T0Millis++;
+  }
+}
+
+// Runs the pending interrupts, highest priority first, as long as the I bit allows it
+void
+SimIrqCheck( void )
+{
+  int i;
+
+  if ( InIsr )
+    return;
+
+  while ( SREG.raw() & 0x80 )
+  {
+    Pending[IRQ_TWI] = SimTwiPending();
+    Pending[IRQ_UDRE] = UdrePending();
+    for ( i = 0; i < IRQ_N && !Pending[i]; i++ )
+      ;
+    if ( i == IRQ_N )
+      return;
+
+    Pending[i] = false;
+    InIsr = true;
+    SREG.set( SREG.raw() & ~0x80 );
+    SimNow += ISR_US;
+    switch ( i )
+    {
+      case IRQ_INT0: ExtInt[0](); break;
+      case IRQ_INT1: ExtInt[1](); break;
+      case IRQ_PCINT1: PCINT1_vect(); break;
+      case IRQ_T1OVF: TIMER1_OVF_vect(); break;
+      case IRQ_T0OVF: T0Overflow(); SimNow += SimTickIsrUs; break;
+      case IRQ_UDRE: USART_UDRE_vect(); break;
+      case IRQ_ADC: ADC_vect(); break;
+      case IRQ_TWI: TWI_vect(); break;
+    }
+    SREG.set( SREG.raw() | 0x80 );
+    InIsr = false;
+  }
+}
+
+static uint64_t
+NextEvent( void )
+{
+  uint64_t t = ( T0Ticks + 1 ) * T0_TICK_US;
+  uint64_t s = SimScriptNext();
+  double rate;
+
+  if ( AdcDone < t )
+    t = AdcDone;
+  if ( UartDone < t )
+    t = UartDone;
+  if ( TCCR1B & ( 1 << CS11 ))
+    t = min( t, ( T1Ovfs + 1 ) * T1_OVF_US );
+  if ( NextEdge == NEVER && ( rate = SimEdgeRate()) > 0 )
+    NextEdge = SimNow + (uint64_t) ( 1e6 / rate );
+  return min( min( t, NextEdge ), s );
+}
+
+// Raises the hardware events that are due at SimNow
+static void
+Events( void )
+{
+  double rate;
+
+  if ( SimNow >= ( T0Ticks + 1 ) * T0_TICK_US )
+  {
+    T0Ticks++;
+    Pending[IRQ_T0OVF] = true;
+    if (( ADCSRA & ( 1 << ADEN )) && ( ADCSRA & ( 1 << ADATE )) && ( ADCSRB & 7 ) == 4 && AdcDone == NEVER )
+    {
+      AdcCh = ADMUX & 0x0f;     // the channel is latched when the conversion starts
+      AdcDone = SimNow + ADC_CONV_US;
+    }
+  }
+  if ( SimNow >= AdcDone )
+  {
+    ADC = SimAnalog( AdcCh );
+    AdcDone = NEVER;
+    if ( ADCSRA & ( 1 << ADIE ))
+      Pending[IRQ_ADC] = true;
+  }
+  if ( SimNow >= UartDone )
+    UartSent();
+  if ( SimNow >= ( T1Ovfs + 1 ) * T1_OVF_US )
+  {
+    T1Ovfs = SimNow / T1_OVF_US;
+    if (( TCCR1B & ( 1 << CS11 )) && ( TIMSK1 & ( 1 << TOIE1 )))
+      Pending[IRQ_T1OVF] = true;
+  }
+  if ( SimNow >= NextEdge )
+  {
+    Level[16] ^= 1;
+    if (( PCICR & ( 1 << PCIE1 )) && ( PCMSK1 & ( 1 << PCINT10 )))
+      Pending[IRQ_PCINT1] = true;
+    rate = SimEdgeRate();
+    NextEdge = rate > 0 ? SimNow + (uint64_t) ( 1e6 / rate ) : NEVER;
+  }
+  if ( SimNow >= SimScriptNext())
+    SimScriptRun();
+}
+
+static void
+Watchdog( void )
+{
+  if ( WdtTimeout && SimNow - WdtLast > WdtTimeout )
+  {
+    SimLcdFlush();
+    printf( "%10.3f  watchdog reset, not serviced for %llu ms\n", SimNow / 1e6,
+            (unsigned long long) ( SimNow - WdtLast ) / 1000 );
+    exit( 3 );
+  }
+}
+
+static void LcdIdle( void );
+
+// Moves the time on by us, raising and running the interrupts on the way
+void
+SimAdvance( uint64_t us )
+{
+  uint64_t end = SimNow + us;
+  uint64_t t;
+
+  HookCnt++;
+  while (( t = NextEvent()) <= end )
+  {
+    SimNow = max( SimNow, t );  // the handlers of an earlier event may have run past it
+    Events();
+    SimIrqCheck();
+  }
+  SimNow = max( SimNow, end );
+  SimIrqCheck();
+  Watchdog();
+  LcdIdle();
+}
+
+static void
+Stuck( int sig )
+{
+  static unsigned long seen;
+
+  if ( HookCnt == seen )
+  {
+    static const char msg[] = "firmware spins without calling into the core, the watchdog would reset it\n";
+    write( 1, msg, sizeof( msg ) - 1 );
+    _exit( 3 );
+  }
+  seen = HookCnt;
+}
+
+void
+SimStart( void )
+{
+  struct itimerval it = { { 1, 0 }, { 1, 0 } };
+
+  memset( Level, 1, sizeof( Level ));     // pulled up
+  Level[16] = 0;
+  SREG.set( 0x80 );       // init() of the core enables the interrupts before setup()
+  signal( SIGALRM, Stuck );
+  setitimer( ITIMER_REAL, &it, NULL );
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  core functions ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+unsigned long
+millis( void )
+{
+  SimAdvance( 1 );
+  return T0Millis;
+}
+
+unsigned long
+micros( void )
+{
+  uint64_t m;
+
+  SimAdvance( 1 );
+  m = T0Ovf;
+  if ( Pending[IRQ_T0OVF] && TCNT0 < 255 )
+    m++;
+  return (unsigned long) (( m << 8 ) + TCNT0 ) * 4;
+}
+
+void delay( unsigned long ms ) { SimAdvance( ms * 1000 ); }
+void delayMicroseconds( unsigned int us ) { SimAdvance( us ); }
+
+void
+sleep_cpu( void )
+{
+  int i;
+
+  HookCnt++;
+  if ( !( SREG.raw() & 0x80 ))
+  {
+    printf( "%10.3f  sleep with the interrupts off, nothing can wake the MCU\n", SimNow / 1e6 );
+    exit( 3 );
+  }
+  Pending[IRQ_TWI] = SimTwiPending();
+  Pending[IRQ_UDRE] = UdrePending();
+  for ( i = 0; i < IRQ_N; i++ )
+    if ( Pending[i] )     // an interrupt that came in before the sleep instruction wakes it right away
+    {
+      SimIrqCheck();
+      return;
+    }
+  SimLcdFlush();
+  SimAdvance( NextEvent() - SimNow );
+}
+
+void pinMode( uint8_t pin, uint8_t mode ) {}
+
+void
+digitalWrite( uint8_t pin, uint8_t val )
+{
+  SimAdvance( 4 );
+  Level[pin] = val ? 1 : 0;
+}
+
+int
+digitalRead( uint8_t pin )
+{
+  SimAdvance( 4 );
+  return Level[pin];
+}
+
+int
+analogRead( uint8_t pin )
+{
+  SimAdvance( 112 );
+  return SimAnalog( pin >= 14 ? pin - 14 : pin );
+}
+
+void
+attachInterrupt( uint8_t n, void (*fn)( void ), int mode )
+{
+  ExtInt[n] = fn;
+  ExtMode[n] = mode;
+}
+
+// Sets an input pin, an edge on INT0 (pin 2) or INT1 (pin 3) raises the interrupt as attached
+void
+SimPin( uint8_t pin, uint8_t level )
+{
+  int n = pin - 2;
+
+  if ( Level[pin] == level )
+    return;
+  Level[pin] = level;
+  if (( pin == 2 || pin == 3 ) && ExtInt[n] )
+    if ( ExtMode[n] == CHANGE || ( ExtMode[n] == FALLING && !level ) || ( ExtMode[n] == RISING && level ))
+      Pending[n == 0 ? IRQ_INT0 : IRQ_INT1] = true;
+  if ( pin >= 14 && pin <= 19 && ( PCICR & ( 1 << PCIE1 )) && ( PCMSK1 & ( 1 << ( pin - 14 ))))   // PCINT8..13
+    Pending[IRQ_PCINT1] = true;
+}
+
+uint8_t SimPinLevel( uint8_t pin ) { return Level[pin]; }
+
+void
+wdt_enable( unsigned char timeout )
+{
+  WdtTimeout = 16000ULL << timeout;
+  WdtLast = SimNow;
+}
+
+void wdt_reset( void ) { WdtLast = SimNow; }
+void wdt_disable( void ) { WdtTimeout = 0; }
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  Print ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+size_t
+Print::write( const uint8_t *buf, size_t len )
+{
+  size_t n = 0;
+
+  while ( len-- )
+    n += write( *buf++ );
+  return n;
+}
+
+size_t
+Print::print( unsigned long n, int base )
+{
+  char buf[8 * sizeof( long ) + 1];
+  char *s = buf + sizeof( buf ) - 1;
+
+  *s = 0;
+  do
+  {
+    *--s = "0123456789ABCDEF"[n % base];
+    n /= base;
+  } while ( n );
+  return write( s );
+}
+
+size_t
+Print::print( long n, int base )
+{
+  if ( n < 0 && base == 10 )
+    return print( '-' ) + print( (unsigned long) -n, base );
+  return print( (unsigned long) n, base );
+}
+
+size_t
+Print::print( double v, int digits )
+{
+  char buf[40];
+
+  if ( isnan( v ))
+    return write( "nan" );
+  if ( isinf( v ))
+    return write( "inf" );
+  if ( v > 4294967040.0 || v < -4294967040.0 )
+    return write( "ovf" );
+  snprintf( buf, sizeof( buf ), "%.*f", digits, v );
+  return write( buf );
+}
+
+HardwareSerial Serial;
+
+size_t
+HardwareSerial::write( uint8_t c )
+{
+  SimAdvance( 2 );        // into the TX buffer, the UART sends in the background
+  putchar( c );
+  return 1;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  LCD ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+#define LCD_VISIBLE 8
+
+static uint8_t DDRam[0x80];
+static uint8_t DDAddr;
+static uint64_t LcdLast;
+static bool LcdDirty;
+unsigned long SimLcdWrites;
+
+LiquidCrystal::LiquidCrystal( uint8_t rs, uint8_t en, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7 )
+{
+  memset( DDRam, ' ', sizeof( DDRam ));
+}
+
+static void
+LcdBusy( uint64_t us )
+{
+  SimAdvance( us );
+  LcdLast = SimNow;
+  LcdDirty = true;
+}
+
+void LiquidCrystal::begin( uint8_t cols, uint8_t rows ) { clear(); }
+
+void
+LiquidCrystal::clear( void )
+{
+  memset( DDRam, ' ', sizeof( DDRam ));
+  DDAddr = 0;
+  LcdBusy( LCD_HOME_US );
+}
+
+void
+LiquidCrystal::home( void )
+{
+  DDAddr = 0;
+  LcdBusy( LCD_HOME_US );
+}
+
+void
+LiquidCrystal::setCursor( uint8_t col, uint8_t row )
+{
+  DDAddr = ( row ? 0x40 : 0 ) + col;
+  LcdBusy( LCD_BYTE_US );
+}
+
+size_t
+LiquidCrystal::write( uint8_t c )
+{
+  DDRam[DDAddr & 0x7f] = c;
+  DDAddr = DDAddr == 0x27 ? 0x40 : ( DDAddr + 1 ) & 0x7f;
+  SimLcdWrites++;
+  LcdBusy( LCD_BYTE_US );
+  return 1;
+}
+
+// the character shown at col of row
+uint8_t
+SimLcdChar( uint8_t row, uint8_t col )
+{
+  return DDRam[( row ? 0x40 : 0 ) + col];
+}
+
+// Prints the visible part of the display and the LEDs when they changed
+void
+SimLcdFlush( void )
+{
+  static char last[80];
+  char line[80], *p = line;
+  int r, c;
+
+  LcdDirty = false;
+  for ( r = 0; r < 2; r++ )
+  {
+    *p++ = '|';
+    for ( c = 0; c < LCD_VISIBLE; c++ )
+    {
+      uint8_t ch = DDRam[( r ? 0x40 : 0 ) + c];
+
+      if ( ch == 0xdf )
+        p += sprintf( p, "\xc2\xb0" );      // degree sign in UTF-8
+      else
+        *p++ = ch >= ' ' && ch < 0x7f ? ch : '?';
+    }
+  }
+  p += sprintf( p, "|%s%s", Level[10] ? " red" : "", Level[17] ? " blue" : "" );
+
+  if ( strcmp( line, last ) == 0 )
+    return;
+  strcpy( last, line );
+  if ( !SimQuiet )
+    printf( "%10.3f  %s\n", SimNow / 1e6, line );
+}
+
+static void
+LcdIdle( void )
+{
+  if ( LcdDirty && SimNow - LcdLast >= LCD_QUIET_US )
+    SimLcdFlush();
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  EEPROM ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+uint8_t SimEEPROM[SIM_EEPROM_SIZE];
+const char *SimEEPROMFile;
+EEPROMClass EEPROM;
+
+void
+SimEEPROMLoad( void )
+{
+  FILE *f;
+
+  memset( SimEEPROM, 0xff, sizeof( SimEEPROM ));      // erased
+  if ( SimEEPROMFile && ( f = fopen( SimEEPROMFile, "rb" )))
+  {
+    fread( SimEEPROM, 1, sizeof( SimEEPROM ), f );
+    fclose( f );
+  }
+}
+
+void
+SimEEPROMSave( size_t n )
+{
+  FILE *f;
+
+  SimAdvance( 3400 * n );   // an EEPROM byte write takes 3.4ms
+  if ( SimEEPROMFile && ( f = fopen( SimEEPROMFile, "wb" )))
+  {
+    fwrite( SimEEPROM, 1, sizeof( SimEEPROM ), f );
+    fclose( f );
+  }
+}
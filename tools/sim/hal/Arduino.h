@@ -0,0 +1,84 @@
+/*
+ * Host stand-in for the parts of the Arduino core the sketch uses, see tools/sim/sim.cpp.
+ * Time only moves when the firmware calls into the core, sleeps or waits, the interrupts of the simulated hardware
+ * are dispatched at those points.
+ */
+
+#ifndef SIM_ARDUINO_H
+#define	SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#define F_CPU 16000000UL
+#define clockCyclesPerMicrosecond() ( F_CPU / 1000000L )
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis( void );
+unsigned long micros( void );
+void delay( unsigned long ms );
+void delayMicroseconds( unsigned int us );
+void pinMode( uint8_t pin, uint8_t mode );
+void digitalWrite( uint8_t pin, uint8_t val );
+int digitalRead( uint8_t pin );
+int analogRead( uint8_t pin );
+void attachInterrupt( uint8_t n, void (*fn)( void ), int mode );
+
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *) (s))
+
+class Print
+{
+  public:
+    virtual size_t write( uint8_t c ) = 0;
+    size_t write( const char *s ) { return write( (const uint8_t *) s, strlen( s )); }
+    virtual size_t write( const uint8_t *buf, size_t len );
+
+    size_t print( const __FlashStringHelper *s ) { return write( (const char *) s ); }
+    size_t print( const char *s ) { return write( s ); }
+    size_t print( char c ) { return write( (uint8_t) c ); }
+    size_t print( unsigned char n, int base = DEC ) { return print( (unsigned long) n, base ); }
+    size_t print( int n, int base = DEC ) { return print( (long) n, base ); }
+    size_t print( unsigned int n, int base = DEC ) { return print( (unsigned long) n, base ); }
+    size_t print( long n, int base = DEC );
+    size_t print( unsigned long n, int base = DEC );
+    size_t print( double n, int digits = 2 );
+    size_t println( void ) { return write( "\r\n" ); }
+    template <class T> size_t println( T v ) { size_t n = print( v ); return n + println(); }
+};
+
+// the serial port goes to stdout
+class HardwareSerial : public Print
+{
+  public:
+    void begin( unsigned long baud ) {}
+    virtual size_t write( uint8_t c );
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif	/* SIM_ARDUINO_H */
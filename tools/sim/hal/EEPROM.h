@@ -0,0 +1,34 @@
+/*
+ * Host stand-in for the EEPROM library, see tools/sim/sim.cpp. The 1Kb of the ATmega328P are kept in a file when
+ * the simulation is given one.
+ */
+
+#ifndef SIM_EEPROM_H
+#define	SIM_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define SIM_EEPROM_SIZE 1024
+
+extern uint8_t SimEEPROM[SIM_EEPROM_SIZE];
+extern void SimEEPROMSave( size_t n );
+
+class EEPROMClass
+{
+  public:
+    uint8_t read( int addr ) { return SimEEPROM[addr]; }
+    void write( int addr, uint8_t v ) { SimEEPROM[addr] = v; SimEEPROMSave( 1 ); }
+    template <class T> T &get( int addr, T &v ) { memcpy( &v, SimEEPROM + addr, sizeof( T )); return v; }
+    template <class T> const T &put( int addr, const T &v )
+    {
+      memcpy( SimEEPROM + addr, &v, sizeof( T ));
+      SimEEPROMSave( sizeof( T ));
+      return v;
+    }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif	/* SIM_EEPROM_H */
@@ -0,0 +1,24 @@
+/*
+ * Host stand-in for the LiquidCrystal library, see tools/sim/sim.cpp. The display RAM of a HD44780 with 2 lines
+ * of 40 characters, the simulation prints the visible part when it changes.
+ */
+
+#ifndef SIM_LIQUIDCRYSTAL_H
+#define	SIM_LIQUIDCRYSTAL_H
+
+#include "Arduino.h"
+
+class LiquidCrystal : public Print
+{
+  public:
+    LiquidCrystal( uint8_t rs, uint8_t en, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7 );
+
+    void begin( uint8_t cols, uint8_t rows );
+    void clear( void );
+    void home( void );
+    void setCursor( uint8_t col, uint8_t row );
+    virtual size_t write( uint8_t c );
+    using Print::write;
+};
+
+#endif	/* SIM_LIQUIDCRYSTAL_H */
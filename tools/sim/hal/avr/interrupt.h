@@ -0,0 +1,19 @@
+/*
+ * Host stand-in for avr/interrupt.h, see tools/sim/sim.cpp. The handlers are plain functions called by the
+ * simulation, cli() and sei() clear and set the I bit of the simulated SREG.
+ */
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define	SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) extern "C" void vector( void )
+
+// as on the chip the instruction after sei() runs before a pending interrupt, i.e. the sleep that waits for it
+void SimSei( void );
+
+#define cli() ( SREG = SREG & ~0x80 )
+#define sei() SimSei()
+
+#endif	/* SIM_AVR_INTERRUPT_H */
@@ -0,0 +1,84 @@
+/*
+ * Host stand-in for the ATmega328P registers the firmware touches, see tools/sim/sim.cpp.
+ * Plain registers are memory. The ones with a side effect on write, or whose value comes from the simulated time,
+ * are SimReg objects with hooks into the simulation.
+ */
+
+#ifndef SIM_AVR_IO_H
+#define	SIM_AVR_IO_H
+
+#include <stdint.h>
+
+template <class T> class SimReg
+{
+    T v;
+    T (*rd)( void );
+    void (*wr)( T );
+
+  public:
+    SimReg( T (*r)( void ), void (*w)( T )) : v( 0 ), rd( r ), wr( w ) {}
+    operator T() const { return rd ? rd() : v; }
+    SimReg &operator=( T x ) { if ( wr ) wr( x ); else v = x; return *this; }
+    SimReg &operator|=( T x ) { return *this = *this | x; }
+    SimReg &operator&=( T x ) { return *this = *this & x; }
+    T raw( void ) const { return v; }
+    void set( T x ) { v = x; }
+};
+
+extern SimReg<uint8_t> SREG;
+extern SimReg<uint8_t> TWCR, TWSR;
+extern SimReg<uint8_t> PINC, TIFR1, TCNT0, DDRC;
+extern SimReg<uint16_t> TCNT1;
+extern SimReg<uint8_t> UDR0, UCSR0A, UCSR0B;
+
+extern uint8_t TWBR, TWDR;
+extern uint8_t PCICR, PCMSK1, PORTC;
+extern uint8_t ADMUX, ADCSRA, ADCSRB;
+extern uint16_t ADC;
+extern uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern uint8_t UCSR0C;
+extern uint16_t UBRR0;
+
+// TWCR
+#define TWINT 7
+#define TWEA  6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC  3
+#define TWEN  2
+#define TWIE  0
+// TWSR
+#define TWPS1 1
+#define TWPS0 0
+
+#define PCIE1 1
+#define PCINT10 2
+#define PC0 0
+#define PC2 2
+#define PC4 4
+#define PC5 5
+
+#define REFS0 6
+#define ADEN  7
+#define ADSC  6
+#define ADATE 5
+#define ADIF  4
+#define ADIE  3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define ADTS2 2
+
+// UCSR0A, UCSR0B, UCSR0C
+#define UDRE0  5
+#define U2X0   1
+#define UDRIE0 5
+#define TXEN0  3
+#define UCSZ01 2
+#define UCSZ00 1
+
+#define CS11  1
+#define TOIE1 0
+#define TOV1  0
+
+#endif	/* SIM_AVR_IO_H */
@@ -0,0 +1,21 @@
+/*
+ * Host stand-in for avr/pgmspace.h, see tools/sim/sim.cpp. There is one address space on the host, flash reads are
+ * plain reads of the type pointed to.
+ */
+
+#ifndef SIM_AVR_PGMSPACE_H
+#define	SIM_AVR_PGMSPACE_H
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define pgm_read_word(p) (*(p))
+#define pgm_read_dword(p) (*(p))
+#define pgm_read_float(p) (*(p))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define memcpy_P memcpy
+
+#endif	/* SIM_AVR_PGMSPACE_H */
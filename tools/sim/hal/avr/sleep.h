@@ -0,0 +1,17 @@
+/*
+ * Host stand-in for avr/sleep.h, see tools/sim/sim.cpp. sleep_cpu() moves the simulated time on to the next
+ * interrupt and runs it.
+ */
+
+#ifndef SIM_AVR_SLEEP_H
+#define	SIM_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE 0
+
+void sleep_cpu( void );
+
+#define set_sleep_mode(mode) ((void) (mode))
+#define sleep_enable() ((void) 0)
+#define sleep_disable() ((void) 0)
+
+#endif	/* SIM_AVR_SLEEP_H */
@@ -0,0 +1,19 @@
+/*
+ * Host stand-in for avr/wdt.h, see tools/sim/sim.cpp. The simulation stops with a report when the watchdog would
+ * have reset the MCU.
+ */
+
+#ifndef SIM_AVR_WDT_H
+#define	SIM_AVR_WDT_H
+
+#define WDTO_15MS 0
+#define WDTO_1S 6
+#define WDTO_2S 7
+#define WDTO_4S 8
+#define WDTO_8S 9
+
+void wdt_enable( unsigned char timeout );
+void wdt_reset( void );
+void wdt_disable( void );
+
+#endif	/* SIM_AVR_WDT_H */
@@ -0,0 +1,26 @@
+/*
+ * Host stand-in for the TWI status codes of compat/twi.h, see tools/sim/sim.cpp.
+ */
+
+#ifndef SIM_COMPAT_TWI_H
+#define	SIM_COMPAT_TWI_H
+
+#include <avr/io.h>
+
+#define TW_START          0x08
+#define TW_REP_START      0x10
+#define TW_MT_SLA_ACK     0x18
+#define TW_MT_SLA_NACK    0x20
+#define TW_MT_DATA_ACK    0x28
+#define TW_MT_DATA_NACK   0x30
+#define TW_MT_ARB_LOST    0x38
+#define TW_MR_SLA_ACK     0x40
+#define TW_MR_SLA_NACK    0x48
+#define TW_MR_DATA_ACK    0x50
+#define TW_MR_DATA_NACK   0x58
+#define TW_BUS_ERROR      0x00
+
+#define TW_STATUS_MASK 0xF8
+#define TW_STATUS ( TWSR & TW_STATUS_MASK )
+
+#endif	/* SIM_COMPAT_TWI_H */
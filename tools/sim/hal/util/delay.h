@@ -0,0 +1,13 @@
+/*
+ * Host stand-in for util/delay.h, see tools/sim/sim.cpp.
+ */
+
+#ifndef SIM_UTIL_DELAY_H
+#define	SIM_UTIL_DELAY_H
+
+void delayMicroseconds( unsigned int us );
+
+#define _delay_us(us) delayMicroseconds( us )
+#define _delay_ms(ms) delayMicroseconds( (ms) * 1000 )
+
+#endif	/* SIM_UTIL_DELAY_H */
@@ -0,0 +1,86 @@
+/*
+  Host simulation of the whole instrument: the unmodified sketch runs against a model of the ATmega328P, the LCD,
+  the knob, the sensors on the I2C bus and the wind or RPM input, driven by a scenario script.
+
+  Build and run on the host from the sketch directory, with the build options of build_opts.h:
+	g++ -O2 -o air_sim -Itools/sim/hal -I. -include Arduino.h -x c++ Air_LCDuino.ino *.c -x none *.cpp tools/sim/hal.cpp tools/sim/twi.cpp tools/sim/world.cpp tools/sim/sim.cpp -lm
+	./air_sim [-t seconds] [-e eeprom.bin] [-u uart.bin] [-q] [scenario]
+
+  or with make -C tools sim, tools/Makefile also builds it for the other build options.
+  The .c files are built as C++ so the register hooks of twimaster.c work. The display is printed whenever its
+  content or the LEDs change, the run ends with a summary of the time spent asleep, the LCD and the I2C traffic, and
+  with WITH_PROFILE the profile of Prof.h, measured on the simulated Timer1.
+  -e keeps the EEPROM in a file across runs, -u writes what the UART sends to a file, the frames of WITH_TELEMETRY
+  for tools/telem_decode.c, at the rate of the line. -q prints only the summary.
+
+  A scenario has one event per line, the time in seconds followed by key=value pairs, # starts a comment:
+	0     temp=21.5 rh=45 hpa=1013.25 vbus=12.6
+	10    wind=12 dir=270         (or rpm=2400 with WITH_RPM)
+	20    knob=+2                 clicks of the knob, 30ms apart
+	25    press=200               button held for 200ms, 'double' for a double press
+	30    baro=off                a sensor stops answering on the bus, on to bring it back
+
+  The timing isn't cycle accurate. Each call into the Arduino core costs about what it takes on the target and the
+  interrupts run between those calls, which is close enough for the scheduling, the sensor state machines and the
+  user interface, not for instruction counts. int is 32 and long 64 bits on the host, overflows the AVR would have
+  don't show up here.
+*/
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "build_opts.h"
+#include "Sched.h"
+#include "Prof.h"
+#include "sim.h"
+
+extern void setup( void );
+extern void loop( void );
+
+int
+main( int argc, char **argv )
+{
+  double secs = 60;
+  clock_t c;
+  int opt;
+
+  while (( opt = getopt( argc, argv, "t:e:u:q" )) != -1 )
+    switch ( opt )
+    {
+      case 't': secs = atof( optarg ); break;
+      case 'e': SimEEPROMFile = optarg; break;
+      case 'u': SimUartFile = optarg; break;
+      case 'q': SimQuiet = true; break;
+      default:
+        fprintf( stderr, "usage: %s [-t seconds] [-e eeprom.bin] [-u uart.bin] [-q] [scenario]\n", argv[0] );
+        return 2;
+    }
+  if ( optind < argc )
+    SimLoad( argv[optind] );
+
+  c = clock();
+  SimEEPROMLoad();
+  SimStart();
+  SimScriptRun();
+  setup();
+  while ( SimNow < secs * 1e6 )
+    loop();
+  SimLcdFlush();
+  SimUartClose();
+  c = clock() - c;
+
+  printf( "\nsimulated %.1f s in %.2f s, %.0fx real time\n", SimNow / 1e6, (double) c / CLOCKS_PER_SEC,
+          SimNow / 1e6 / ( (double) c / CLOCKS_PER_SEC + 1e-9 ));
+  printf( "asleep %.1f%%, %lu naps, wake latency avg %lu us max %u us\n", SleepStats.sleep_us / ( SimNow / 100.0 ),
+          SleepStats.naps, SleepStats.naps ? SleepStats.wake_us / SleepStats.naps : 0, SleepStats.wake_max );
+  printf( "LCD bytes %lu\n", SimLcdWrites );
+  if ( SimUartBytes )
+    printf( "UART bytes %lu, %.0f per s, %lu lost to writes into a full UDR0\n", SimUartBytes,
+            SimUartBytes / ( SimNow / 1e6 ), SimUartOverruns );
+  SimTwiReport();
+#ifdef WITH_PROFILE
+  printf( "\n" );
+  Prof_Print( Serial );
+#endif
+  return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Interface between the parts of the host simulation, see sim.cpp.
+ */
+
+#ifndef SIM_H
+#define	SIM_H
+
+#include <stdint.h>
+
+// The world the sensors see, changed by the scenario script
+struct SimWorld
+{
+  double temp_c;
+  double rh;
+  double hpa;           // station pressure
+  double vbus;
+  double wind_mph;
+  double wind_dir;
+  double rpm;
+  bool baro, hygro, tmp100;     // device answers on the bus
+};
+
+extern struct SimWorld World;
+
+extern uint64_t SimNow;         // simulated time in us since reset
+extern bool SimQuiet;
+
+// hal.cpp
+extern unsigned SimTickIsrUs;                 // time the millis() tick handler takes, not counting entry and reti
+extern void SimAdvance( uint64_t us );
+extern void SimIrqCheck( void );
+extern void SimPin( uint8_t pin, uint8_t level );
+extern uint8_t SimPinLevel( uint8_t pin );
+extern void SimStart( void );
+extern void SimLcdFlush( void );
+extern unsigned long SimLcdWrites;
+extern uint8_t SimLcdChar( uint8_t row, uint8_t col );
+extern const char *SimEEPROMFile;
+extern void SimEEPROMLoad( void );
+extern const char *SimUartFile;
+extern unsigned long SimUartBytes, SimUartOverruns;
+extern void SimUartClose( void );
+
+// twi.cpp
+extern bool SimTwiPending( void );
+extern void SimTwiReport( void );
+extern double SimTwiBusUs( void );            // time the bus events took at their SCL clock
+extern unsigned long SimTwiScl( uint8_t addr );       // SCL of the last START to the 7 bit address, in Hz
+extern void SimBmpRaw( long ut, long up );    // fixed raw BMP085 results, up with the oversampling bits, ut -1 for none
+extern unsigned long SimBmpPressReads;         // pressure results read from the BMP085
+enum { SIM_TWI_OK, SIM_TWI_DATA_NACK, SIM_TWI_STUCK };
+extern void SimTwiFault( uint8_t addr, uint8_t fault );       // the 7 bit address misbehaves from now on, see twi.cpp
+extern bool SimTwiHeld( void );               // SDA held low by a device with SIM_TWI_STUCK
+
+// world.cpp
+extern void SimLoad( const char *file );      // reads a scenario script, see sim.cpp
+extern uint64_t SimScriptNext( void );        // when the next scripted event is due, UINT64_MAX for none
+extern void SimScriptRun( void );
+extern double SimEdgeRate( void );            // pin changes per second on PC2 from the wind cups or RPM sensor
+extern uint16_t SimAnalog( uint8_t ch );      // 10 bit ADC reading of channel ch
+
+#endif	/* SIM_H */
@@ -0,0 +1,499 @@
+/*
+  The TWI hardware and the sensors on the bus, see sim.cpp.
+
+  A write to TWCR that clears TWINT starts the next bus event, the model completes it right away and sets TWINT
+  again with the status in TWSR, so the bus itself takes no time. With TWIE set the TWI interrupt then runs as soon
+  as the I bit allows, the interrupt driven engine works its way through a transaction in one go. Reading TWCR takes
+  the time a pass of a loop polling it takes, so a wait for a bus event that doesn't come runs into its bound.
+
+  The device models answer the way the datasheets describe: the BMP085 with the example calibration of its datasheet,
+  raw values found by searching its compensation formula for the temperature and pressure of the world, the SI7021
+  NACKs a read before its conversion is done, the TMP100 returns the last result until its one shot conversion ends.
+  A device taken off the bus by the scenario NACKs its address.
+
+  SimTwiFault() makes a device misbehave: SIM_TWI_DATA_NACK ACKs its address and NACKs every byte written to it
+  after that, until the fault is cleared. SIM_TWI_STUCK holds SDA low from the next data byte sent to or read from
+  it, as a device that lost count of the clocks does. That byte, any STOP and any START never complete, TWINT isn't
+  set and TWSTO stays set, until the bus recovery has clocked SCL 9 times with the TWI off. The device is fine after.
+  The time the bus events would take at the SCL clock TWBR and TWSR give is added up, for the report and the checks.
+*/
+#include <stdio.h>
+#include "Arduino.h"
+#include <compat/twi.h>
+#include "sim.h"
+
+class I2cDev
+{
+  public:
+    const char *name;
+    uint8_t addr;               // 7 bit address
+    unsigned long txns, nacks;
+    unsigned long scl;          // Hz, of the last START addressed to it
+    uint8_t fault;              // SIM_TWI_
+
+    I2cDev( const char *n, uint8_t a ) : name( n ), addr( a ), txns( 0 ), nacks( 0 ), scl( 0 ), fault( SIM_TWI_OK ) {}
+    virtual bool present( void ) = 0;
+    virtual bool start( bool read ) = 0;    // addressed, false to NACK
+    virtual bool write( uint8_t b ) = 0;    // false to NACK
+    virtual uint8_t read( void ) = 0;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  BMP085 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+// example calibration of the datasheet
+static const short BmpCal[11] = { 408, -72, -14383, (short) 32741, (short) 32757, 23153, 6190, 4, -32768, -8711, 2868 };
+enum { AC1, AC2, AC3, AC4, AC5, AC6, B1, B2, MB, MC, MD };
+static const unsigned short BmpConvUs[4] = { 4500, 7500, 13500, 25500 };
+static long BmpUt = -1, BmpUp;  // raw results of SimBmpRaw(), -1 to find them from the world
+unsigned long SimBmpPressReads;
+
+class Bmp085 : public I2cDev
+{
+    uint8_t reg[256];
+    uint8_t ptr;
+    bool first;
+    uint8_t res[3];
+    uint64_t ready;
+
+    // temperature in 0.1 degC and B5 for a raw temperature, as in the datasheet
+    static long B5( long ut )
+    {
+      long x1 = ( ut - (unsigned short) BmpCal[AC6] ) * (unsigned short) BmpCal[AC5] >> 15;
+      long x2 = ( BmpCal[MC] * 2048L ) / ( x1 + BmpCal[MD] );
+
+      return x1 + x2;
+    }
+
+    static long Pa( long up, long b5, int oss )
+    {
+      long b6 = b5 - 4000, x1, x2, x3, b3, p;
+      unsigned long b4, b7;
+
+      x1 = ( BmpCal[B2] * ( b6 * b6 >> 12 )) >> 11;
+      x2 = BmpCal[AC2] * b6 >> 11;
+      x3 = x1 + x2;
+      b3 = ((( BmpCal[AC1] * 4L + x3 ) << oss ) + 2 ) >> 2;
+      x1 = BmpCal[AC3] * b6 >> 13;
+      x2 = ( BmpCal[B1] * ( b6 * b6 >> 12 )) >> 16;
+      x3 = (( x1 + x2 ) + 2 ) >> 2;
+      b4 = (unsigned short) BmpCal[AC4] * (unsigned long) ( x3 + 32768 ) >> 15;
+      b7 = (unsigned long) ( up - b3 ) * ( 50000 >> oss );
+      p = b7 < 0x80000000 ? ( b7 * 2 ) / b4 : ( b7 / b4 ) * 2;
+      x1 = ( p >> 8 ) * ( p >> 8 );
+      x1 = ( x1 * 3038 ) >> 16;
+      x2 = ( -7357 * p ) >> 16;
+      return p + (( x1 + x2 + 3791 ) >> 4 );
+    }
+
+    // smallest raw value whose result reaches want, both grow with the raw value
+    template <class F> static long Search( long lo, long hi, long want, F f )
+    {
+      while ( lo < hi )
+      {
+        long mid = ( lo + hi ) / 2;
+
+        if ( f( mid ) < want )
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      return lo;
+    }
+
+    long UT( void )
+    {
+      return Search( 0, 65535, lround( World.temp_c * 10 ), []( long ut ) { return ( B5( ut ) + 8 ) >> 4; } );
+    }
+
+    void convert( uint8_t cmd )
+    {
+      int oss = cmd >> 6;
+      long b5 = B5( UT());
+      long raw;
+
+      if ( cmd == 0x2e )
+      {
+        raw = ( BmpUt >= 0 ? BmpUt : UT()) << 8;
+        ready = SimNow + BmpConvUs[0];
+      }
+      else
+      {
+        raw = BmpUt >= 0 ? BmpUp : Search( 0, ( 1L << ( 16 + oss )) - 1, lround( World.hpa * 100 ),
+                                           [=]( long up ) { return Pa( up, b5, oss ); } );
+        raw <<= 8 - oss;
+        ready = SimNow + BmpConvUs[oss];
+      }
+      res[0] = raw >> 16;
+      res[1] = raw >> 8;
+      res[2] = raw;
+    }
+
+  public:
+    Bmp085( void ) : I2cDev( "BMP085", 0x77 ), ptr( 0 ), first( false ), ready( UINT64_MAX )
+    {
+      int i;
+
+      memset( reg, 0, sizeof( reg ));
+      for ( i = 0; i < 11; i++ )
+      {
+        reg[0xaa + 2 * i] = BmpCal[i] >> 8;
+        reg[0xab + 2 * i] = BmpCal[i];
+      }
+      reg[0xd0] = 0x55;         // chip id
+    }
+
+    bool present( void ) { return World.baro; }
+    bool start( bool read ) { first = !read; return true; }
+
+    bool write( uint8_t b )
+    {
+      if ( first )
+      {
+        ptr = b;
+        first = false;
+        return true;
+      }
+      reg[ptr] = b;
+      if ( ptr == 0xf4 )
+        convert( b );
+      ptr++;
+      return true;
+    }
+
+    uint8_t read( void )
+    {
+      if ( SimNow >= ready )    // the result registers keep the old value until the conversion is done
+      {
+        memcpy( reg + 0xf6, res, 3 );
+        ready = UINT64_MAX;
+      }
+      if ( ptr == 0xf8 )        // XLSB, only read with a pressure
+        SimBmpPressReads++;
+      return reg[ptr++];
+    }
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  SI7021 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+#define SI7021_CONV_US 20000    // 12 bit RH and 14 bit temperature, typical
+
+class Si7021 : public I2cDev
+{
+    bool first;
+    uint8_t cmd, user;
+    uint8_t out[3], pos;
+    unsigned short t_code;
+    uint64_t ready;
+
+    void setOut( unsigned short v )
+    {
+      out[0] = v >> 8;
+      out[1] = v;
+      out[2] = 0;
+      pos = 0;
+    }
+
+  public:
+    Si7021( void ) : I2cDev( "SI7021", 0x40 ), first( false ), cmd( 0 ), user( 0x3a ), pos( 0 ), t_code( 0 ), ready( 0 ) {}
+
+    bool present( void ) { return World.hygro; }
+
+    bool start( bool read )
+    {
+      first = !read;
+      return !read || SimNow >= ready;      // no hold master mode, NACKs the read during the conversion
+    }
+
+    bool write( uint8_t b )
+    {
+      double rh;
+
+      if ( !first )
+      {
+        if ( cmd == 0xe6 )
+          user = b;
+        return true;
+      }
+      first = false;
+      switch ( cmd = b )
+      {
+        case 0xf5:            // RH, the temperature is measured along with it
+          rh = constrain(( World.rh + 6 ) * 65536 / 125, 0, 65535 );
+          setOut(( (unsigned short) rh & 0xfffc ) | 0x02 );
+          t_code = (unsigned short) constrain(( World.temp_c + 46.85 ) * 65536 / 175.72, 0, 65535 ) & 0xfffc;
+          ready = SimNow + SI7021_CONV_US;
+          break;
+        case 0xe0:            // temperature of the last RH conversion
+          setOut( t_code );
+          break;
+        case 0xe7:
+          out[0] = user;
+          pos = 0;
+          break;
+        case 0xfe:            // reset
+          user = 0x3a;
+          ready = SimNow + 15000;
+          break;
+      }
+      return true;
+    }
+
+    uint8_t read( void ) { return pos < 3 ? out[pos++] : 0xff; }
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  TMP100 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+class Tmp100 : public I2cDev
+{
+    bool first, second;
+    uint8_t ptr, conf;
+    short temp, next;
+    uint64_t ready;
+
+  public:
+    Tmp100( void ) : I2cDev( "TMP100", 0x4a ), first( false ), second( false ), ptr( 0 ), conf( 0 ), temp( 0 ),
+                     next( 0 ), ready( UINT64_MAX ) {}
+
+    bool present( void ) { return World.tmp100; }
+    bool start( bool read ) { first = !read; second = false; return true; }
+
+    bool write( uint8_t b )
+    {
+      if ( first )
+      {
+        ptr = b & 3;
+        first = false;
+        second = true;
+        return true;
+      }
+      if ( ptr == 1 )
+      {
+        conf = b & 0x7f;
+        if ( b & 0x80 )         // one shot, 320ms at 12 bits
+        {
+          next = (short) ( lround( World.temp_c / 0.0625 ) * 16 );
+          ready = SimNow + ( 40000 << (( conf >> 5 ) & 3 ));
+        }
+      }
+      return true;
+    }
+
+    uint8_t read( void )
+    {
+      uint8_t v;
+
+      if ( SimNow >= ready )
+      {
+        temp = next;
+        ready = UINT64_MAX;
+      }
+      if ( ptr == 1 )
+        return conf;
+      v = second ? temp : temp >> 8;
+      second = !second;
+      return v;
+    }
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  TWI ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+static Bmp085 Baro;
+static Si7021 Hygro;
+static Tmp100 Temp;
+static I2cDev *Devs[] = { &Baro, &Hygro, &Temp };
+
+enum { BUS_IDLE, BUS_START, BUS_NACKED, BUS_MT, BUS_MR };
+static uint8_t Phase = BUS_IDLE;
+static uint8_t Status = 0xf8;       // no relevant state
+static I2cDev *Cur;
+static unsigned long Events;
+static double BusUs;
+static bool Held;                   // SDA held low by a device
+static uint8_t Clocks;              // SCL clocked by the bus recovery while it is held
+
+// SCL clock of the TWI settings
+static unsigned long
+Scl( void )
+{
+  return F_CPU / ( 16 + 2UL * TWBR * ( 1 << 2 * ( TWSR.raw() & 3 )));
+}
+
+static void
+Address( uint8_t sla )
+{
+  bool read = sla & 1;
+  unsigned i;
+
+  Cur = NULL;
+  for ( i = 0; i < sizeof( Devs ) / sizeof( Devs[0] ); i++ )
+    if ( Devs[i]->addr == sla >> 1 )
+      Cur = Devs[i];
+
+  if ( Cur && !read )
+    Cur->txns++;
+  if ( Cur )
+    Cur->scl = Scl();
+  if ( !Cur || !Cur->present() || !Cur->start( read ))
+  {
+    if ( Cur )
+      Cur->nacks++;
+    Status = read ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+    Phase = BUS_NACKED;
+    return;
+  }
+  Status = read ? TW_MR_SLA_ACK : TW_MT_SLA_ACK;
+  Phase = read ? BUS_MR : BUS_MT;
+}
+
+static void
+TwcrWrite( uint8_t v )
+{
+  uint8_t keep = v & ~(( 1 << TWINT ) | ( 1 << TWSTO ) | ( 1 << TWSTA ));
+
+  if ( !( v & ( 1 << TWEN )))   // TWI off, the pins go back to the port
+  {
+    Phase = BUS_IDLE;
+    TWCR.set( v & ~( 1 << TWINT ));
+    return;
+  }
+  if ( !( v & ( 1 << TWINT )))  // writing 0 to TWINT starts nothing
+  {
+    TWCR.set(( TWCR.raw() & ( 1 << TWINT )) | keep | ( v & ( 1 << TWSTA )));
+    return;
+  }
+  if ( Held )                   // nothing moves on the bus
+  {
+    TWCR.set( keep | ( v & (( 1 << TWSTA ) | ( 1 << TWSTO ))));
+    return;
+  }
+
+  Events++;
+  BusUs += 1e6 / Scl();         // START and STOP take about a bit each, a byte 9 with the ACK
+  if ( v & ( 1 << TWSTO ))
+  {
+    Phase = BUS_IDLE;
+    if ( !( v & ( 1 << TWSTA )))  // STOP doesn't set TWINT
+    {
+      TWCR.set( keep );
+      return;
+    }
+  }
+
+  if ( v & ( 1 << TWSTA ))
+  {
+    Status = Phase == BUS_IDLE ? TW_START : TW_REP_START;
+    Phase = BUS_START;
+  }
+  else
+  {
+    if (( Phase == BUS_MT || Phase == BUS_MR ) && Cur->fault == SIM_TWI_STUCK )
+    {
+      Cur->fault = SIM_TWI_OK;
+      Held = true;
+      Clocks = 0;
+      TWCR.set( keep );
+      return;
+    }
+    BusUs += 8e6 / Scl();
+    switch ( Phase )
+    {
+      case BUS_START:
+        Address( TWDR );
+        break;
+      case BUS_MT:
+        Status = Cur->fault != SIM_TWI_DATA_NACK && Cur->write( TWDR ) ? TW_MT_DATA_ACK : TW_MT_DATA_NACK;
+        break;
+      case BUS_MR:
+        TWDR = Cur->read();
+        Status = ( v & ( 1 << TWEA )) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+        break;
+      default:
+        Status = TW_BUS_ERROR;
+        break;
+    }
+  }
+
+  TWCR.set( keep | ( v & ( 1 << TWSTA )) | ( 1 << TWINT ));
+  SimIrqCheck();
+}
+
+// a pass of a loop polling TWCR takes about 8 cycles
+static uint8_t
+TwcrRead( void )
+{
+  static unsigned long reads;
+
+  if ( ++reads % 2 == 0 )
+    SimAdvance( 1 );
+  return TWCR.raw();
+}
+
+static uint8_t TwsrRead( void ) { return Status | ( TWSR.raw() & 3 ); }
+static void TwsrWrite( uint8_t v ) { TWSR.set( v & 3 ); }
+
+// SCL let go by the bit banging of the bus recovery, with the TWI off the port drives the pins
+static void
+DdrcWrite( uint8_t v )
+{
+  if ( Held && !( TWCR.raw() & ( 1 << TWEN )) && ( DDRC.raw() & ( 1 << PC5 )) && !( v & ( 1 << PC5 )) &&
+       ++Clocks == 9 )
+    Held = false;               // the device has sent the rest of its byte and sees the STOP
+  DDRC.set( v );
+}
+
+SimReg<uint8_t> TWCR( TwcrRead, TwcrWrite );
+SimReg<uint8_t> TWSR( TwsrRead, TwsrWrite );
+SimReg<uint8_t> DDRC( NULL, DdrcWrite );
+uint8_t TWBR, TWDR;
+
+// The TWI interrupt is a level, it is there as long as TWINT and TWIE are set
+bool
+SimTwiPending( void )
+{
+  uint8_t v = TWCR.raw();
+
+  return ( v & ( 1 << TWINT )) && ( v & ( 1 << TWIE )) && ( v & ( 1 << TWEN ));
+}
+
+double SimTwiBusUs( void ) { return BusUs; }
+
+void
+SimTwiFault( uint8_t addr, uint8_t fault )
+{
+  unsigned i;
+
+  for ( i = 0; i < sizeof( Devs ) / sizeof( Devs[0] ); i++ )
+    if ( Devs[i]->addr == addr )
+      Devs[i]->fault = fault;
+}
+
+bool SimTwiHeld( void ) { return Held; }
+
+void
+SimBmpRaw( long ut, long up )
+{
+  BmpUt = ut;
+  BmpUp = up;
+}
+
+unsigned long
+SimTwiScl( uint8_t addr )
+{
+  unsigned i;
+
+  for ( i = 0; i < sizeof( Devs ) / sizeof( Devs[0] ); i++ )
+    if ( Devs[i]->addr == addr )
+      return Devs[i]->scl;
+  return 0;
+}
+
+void
+SimTwiReport( void )
+{
+  unsigned i;
+
+  printf( "I2C bus events %lu, %.1f ms on the bus\n", Events, BusUs / 1000 );
+  for ( i = 0; i < sizeof( Devs ) / sizeof( Devs[0] ); i++ )
+    printf( "  %-7s transactions %8lu  NACKs %lu  SCL %lu Khz\n", Devs[i]->name, Devs[i]->txns, Devs[i]->nacks,
+            Devs[i]->scl / 1000 );
+}
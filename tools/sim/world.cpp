@@ -0,0 +1,192 @@
+/*
+  The world around the instrument for the host simulation, see sim.cpp: the scenario script, the readings the
+  sensors see, the edges of the wind cups or the RPM sensor and the analog inputs.
+*/
+#include <stdio.h>
+#include "Arduino.h"
+#include "build_opts.h"
+#include "sim.h"
+
+#define ANEMO_CONST 2.5         // as in Wind.cpp, mph per revolution per second
+#define ANEMO_COUNT_Rev 16      // edges per revolution
+#define VANE_MIN 70             // ADC counts of the vane at 0 and 359 deg, the default calibration of Wind.cpp
+#define VANE_MAX 660
+#define CLICK_MS 30
+#define MAX_EVENTS 4096
+
+struct SimWorld World = { 20.0, 50.0, 1013.25, 12.6, 0, 0, 0, true, true, true };
+
+enum { EV_TEMP, EV_RH, EV_HPA, EV_VBUS, EV_WIND, EV_DIR, EV_RPM, EV_BARO, EV_HYGRO, EV_TMP100, EV_PIN };
+
+struct Event
+{
+  uint64_t t;
+  int what;
+  double v;
+  uint8_t pin;
+  unsigned seq;         // keeps events of the same time in script order
+};
+
+static struct Event Script[MAX_EVENTS];
+static unsigned Events, Next;
+
+static void
+Add( uint64_t t, int what, double v, uint8_t pin = 0 )
+{
+  if ( Events == MAX_EVENTS )
+  {
+    fprintf( stderr, "more than %d events\n", MAX_EVENTS );
+    exit( 2 );
+  }
+  Script[Events] = (struct Event) { t, what, v, pin, Events };
+  Events++;
+}
+
+static int
+Before( const void *a, const void *b )
+{
+  const struct Event *x = (const struct Event *) a, *y = (const struct Event *) b;
+
+  if ( x->t != y->t )
+    return x->t < y->t ? -1 : 1;
+  return x->seq < y->seq ? -1 : 1;
+}
+
+static void
+Press( uint64_t t, unsigned ms )
+{
+  Add( t, EV_PIN, 0, 3 );
+  Add( t + ms * 1000ULL, EV_PIN, 1, 3 );
+}
+
+static bool
+Parse( uint64_t t, const char *key, const char *val )
+{
+  static const char *keys[] = { "temp", "rh", "hpa", "vbus", "wind", "dir", "rpm", "baro", "hygro", "tmp100" };
+  int i, n;
+
+  if ( !strcmp( key, "knob" ))
+  {
+    n = atoi( val );
+    for ( i = 0; i < abs( n ); i++ )     // B low while A falls turns up, Enc_DIRECTION is -1
+    {
+      Add( t, EV_PIN, n < 0, 14 );
+      Add( t, EV_PIN, 0, 2 );
+      Add( t + 5000, EV_PIN, 1, 2 );
+      t += CLICK_MS * 1000;
+    }
+    return true;
+  }
+  if ( !strcmp( key, "press" ))
+  {
+    Press( t, atoi( val ));
+    return true;
+  }
+  if ( !strcmp( key, "double" ))
+  {
+    Press( t, 100 );
+    Press( t + 250000, 100 );
+    return true;
+  }
+  for ( i = 0; i <= EV_TMP100; i++ )
+    if ( !strcmp( key, keys[i] ))
+    {
+      Add( t, i, i >= EV_BARO ? strcmp( val, "off" ) != 0 : atof( val ));
+      return true;
+    }
+  return false;
+}
+
+void
+SimLoad( const char *file )
+{
+  FILE *f = fopen( file, "r" );
+  char line[256], *tok, *eq;
+  unsigned lineno = 0;
+  uint64_t t;
+
+  if ( !f )
+  {
+    perror( file );
+    exit( 2 );
+  }
+  while ( fgets( line, sizeof( line ), f ))
+  {
+    lineno++;
+    if (( tok = strchr( line, '#' )))
+      *tok = 0;
+    if ( !( tok = strtok( line, " \t\r\n" )))
+      continue;
+    t = (uint64_t) ( atof( tok ) * 1e6 );
+    while (( tok = strtok( NULL, " \t\r\n" )))
+      if ( !( eq = strchr( tok, '=' )) && strcmp( tok, "double" ))
+      {
+        fprintf( stderr, "%s:%u: expected key=value, got %s\n", file, lineno, tok );
+        exit( 2 );
+      }
+      else
+      {
+        if ( eq )
+          *eq++ = 0;
+        if ( !Parse( t, tok, eq ? eq : "" ))
+        {
+          fprintf( stderr, "%s:%u: unknown key %s\n", file, lineno, tok );
+          exit( 2 );
+        }
+      }
+  }
+  fclose( f );
+  qsort( Script, Events, sizeof( Script[0] ), Before );
+}
+
+uint64_t SimScriptNext( void ) { return Next < Events ? Script[Next].t : UINT64_MAX; }
+
+void
+SimScriptRun( void )
+{
+  double *w[] = { &World.temp_c, &World.rh, &World.hpa, &World.vbus, &World.wind_mph, &World.wind_dir, &World.rpm };
+  bool *dev[] = { &World.baro, &World.hygro, &World.tmp100 };
+
+  while ( Next < Events && Script[Next].t <= SimNow )
+  {
+    struct Event &e = Script[Next++];
+
+    if ( e.what == EV_PIN )
+      SimPin( e.pin, e.v != 0 );
+    else if ( e.what >= EV_BARO )
+      *dev[e.what - EV_BARO] = e.v != 0;
+    else
+      *w[e.what] = e.v;
+  }
+}
+
+// pin changes per second on PC2
+double
+SimEdgeRate( void )
+{
+#if defined(WITH_WIND)
+  return World.wind_mph / ANEMO_CONST * ANEMO_COUNT_Rev;
+#elif defined(WITH_RPM)
+  return World.rpm / 60 * RPM_PULSES_PER_REV * 2;
+#else
+  return 0;
+#endif
+}
+
+// weak, a check can model the analog inputs itself
+__attribute__(( weak )) uint16_t
+SimAnalog( uint8_t ch )
+{
+  double v = 0;
+
+  switch ( ch )
+  {
+    case 6:         // wind vane
+      v = VANE_MIN + fmod( World.wind_dir, 360 ) / 360 * ( VANE_MAX - VANE_MIN );
+      break;
+    case 7:         // supply through the 14K / 6.8K divider
+      v = World.vbus * 6.8 / ( 14 + 6.8 ) / 5.0 * 1024;
+      break;
+  }
+  return constrain( (int) v, 0, 1023 );
+}
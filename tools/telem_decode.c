@@ -0,0 +1,200 @@
+/*
+  Decodes the telemetry frames of WITH_TELEMETRY, see Telem.h, into one CSV line per frame: the time in seconds from
+  the time stamp of the frame, the frame type and its values. The summary at the end, on stderr, counts the frames,
+  the bytes per second, the frames with a bad CRC and the ones lost on the way, from the gaps in the sequence numbers.
+  Frames the instrument dropped because its buffer was full don't leave a gap, the status frame counts them.
+
+  Build and run on the host:
+	cc -o telem_decode tools/telem_decode.c
+	stty -F /dev/ttyUSB0 115200 raw -echo
+	./telem_decode < /dev/ttyUSB0 > log.csv
+
+  or on what tools/sim sends, ./air_sim -u uart.bin followed by ./telem_decode uart.bin
+  A stream picked up in the middle, or a byte lost on the line, is resynced on the next sync byte with a good CRC.
+*/
+#include <stdio.h>
+#include <string.h>
+
+// as in Telem.h
+#define TELEM_SYNC 0xa5
+#define TELEM_HEAD 6
+#define TELEM_MAX  ( TELEM_HEAD + 255 + 1 )
+
+enum { TELEM_BARO = 1, TELEM_HYGRO, TELEM_TEMP, TELEM_WIND, TELEM_RPM, TELEM_VBUS, TELEM_STATUS, TELEM_PROF };
+
+// the regions of Prof.h, the one of the wind or the RPM task depends on the build
+static const char *prof_name[] = {
+	"Loop", "Baro", "Hygr", "Temp", "Disp", "Wind/RPM", "Knob", "Btn", "PCI", "T1ov", "ADC", "TWI"
+};
+
+static unsigned char buf[2 * TELEM_MAX];
+static unsigned long frames, bytes, crc_errs, lost, skipped;
+static unsigned long t_first, t_last;
+static unsigned short ms_last;
+
+static unsigned char
+crc8_ccitt( unsigned char crc, unsigned char c )
+{
+	int i;
+
+	crc ^= c;
+	for ( i = 0; i < 8; i++ )
+		crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+	return crc;
+}
+
+static unsigned
+get16( const unsigned char *p )
+{
+	return p[0] | p[1] << 8;
+}
+
+static unsigned long
+get32( const unsigned char *p )
+{
+	return get16( p ) | (unsigned long) get16( p + 2 ) << 16;
+}
+
+static float
+getf( const unsigned char *p )
+{
+	unsigned long u = get32( p );
+	unsigned int v = u;
+	float f;
+
+	memcpy( &f, &v, sizeof( f ) );
+	return f;
+}
+
+// payload of a good frame, a payload shorter than its type has is printed raw
+static void
+print_frame( unsigned long t, unsigned char type, const unsigned char *p, unsigned char len )
+{
+	static const unsigned char need[] = { 0, 8, 8, 4, 3, 2, 4, 14, 13 };
+	unsigned long n;
+
+	printf( "%.3f,", t / 1000.0 );
+	if ( type >= sizeof( need ) || type == 0 || len < need[type] )
+	{
+		printf( "type%u", type );
+		while ( len-- )
+			printf( ",%u", *p++ );
+		printf( "\n" );
+		return;
+	}
+
+	switch ( type )
+	{
+	case TELEM_BARO:
+		printf( "baro,%.2f,%.2f\n", getf( p ), getf( p + 4 ) );
+		break;
+	case TELEM_HYGRO:
+		printf( "hygro,%.2f,%.2f\n", getf( p ), getf( p + 4 ) );
+		break;
+	case TELEM_TEMP:
+		printf( "temp,%.4f\n", getf( p ) );
+		break;
+	case TELEM_WIND:
+		printf( "wind,%u,%d\n", p[0], (short) get16( p + 1 ) );
+		break;
+	case TELEM_RPM:
+		printf( "rpm,%d\n", (short) get16( p ) );
+		break;
+	case TELEM_VBUS:
+		printf( "vbus,%.3f\n", getf( p ) );
+		break;
+	case TELEM_STATUS:
+		printf( "status,%lu,%lu,%u,%u,%u\n", get32( p ), get32( p + 4 ), get16( p + 8 ), get16( p + 10 ),
+			get16( p + 12 ) );
+		break;
+	case TELEM_PROF:
+		n = get32( p + 9 );
+		printf( "prof,%s,%lu", p[0] < sizeof( prof_name ) / sizeof( prof_name[0] ) ? prof_name[p[0]] : "?", n );
+		if ( n )	// in us, 0.5us ticks of Timer1
+			printf( ",%.1f,%.1f,%.1f", get16( p + 1 ) / 2.0, get32( p + 5 ) / 2.0 / n, get16( p + 3 ) / 2.0 );
+		printf( "\n" );
+		break;
+	}
+}
+
+// the time stamp has 16 bits of ms, it is taken to move on by less than a wrap from one frame to the next
+static unsigned long
+frame_time( unsigned short ms )
+{
+	if ( frames )
+		t_last += (unsigned short) (ms - ms_last);
+	else
+		t_first = t_last = ms;
+	ms_last = ms;
+	return t_last;
+}
+
+/*
+  Takes the frames from the start of buf. Returns the bytes used up, 0 when the frame at the start isn't complete
+  yet. Without a sync byte or with a bad CRC only the first byte is dropped, a sync byte inside it may start the
+  next good frame.
+*/
+static int
+parse( int have )
+{
+	static int seq = -1;
+	unsigned char crc = 0;
+	int len, i;
+
+	if ( buf[0] != TELEM_SYNC )
+	{
+		skipped++;
+		return 1;
+	}
+	if ( have < TELEM_HEAD || have < TELEM_HEAD + buf[2] + 1 )
+		return 0;
+
+	len = buf[2];
+	for ( i = 1; i < TELEM_HEAD + len; i++ )
+		crc = crc8_ccitt( crc, buf[i] );
+	if ( crc != buf[TELEM_HEAD + len] )
+	{
+		crc_errs++;
+		skipped++;
+		return 1;
+	}
+
+	if ( seq >= 0 )
+		lost += (unsigned char) (buf[3] - seq - 1);
+	seq = buf[3];
+	print_frame( frame_time( get16( buf + 4 ) ), buf[1], buf + TELEM_HEAD, len );
+	frames++;
+	bytes += TELEM_HEAD + len + 1;
+	return TELEM_HEAD + len + 1;
+}
+
+int
+main( int argc, char **argv )
+{
+	FILE *in = stdin;
+	int have = 0, n, used;
+
+	if ( argc > 1 && !(in = fopen( argv[1], "rb" )) )
+	{
+		perror( argv[1] );
+		return 1;
+	}
+
+	while ( (n = fread( buf + have, 1, sizeof( buf ) - have, in )) > 0 || have )
+	{
+		have += n;
+		while ( have && (used = parse( have )) )
+		{
+			have -= used;
+			memmove( buf, buf + used, have );
+		}
+		if ( n <= 0 )		// end of the input, what is left is an incomplete frame
+			break;
+		fflush( stdout );
+	}
+
+	fprintf( stderr, "%lu frames, %lu bytes in %.1f s, %.0f bytes per s, %lu bad CRC, %lu lost, %lu bytes skipped\n",
+		 frames, bytes, (t_last - t_first) / 1000.0,
+		 t_last > t_first ? bytes * 1000.0 / (t_last - t_first) : 0.0, crc_errs, lost, skipped + have );
+	return lost || crc_errs ? 1 : 0;
+}
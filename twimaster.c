@@ -8,8 +8,10 @@
 **************************************************************************/
 #include <inttypes.h>
 #include <compat/twi.h>
+#include <avr/interrupt.h>
 
 #include "i2cmaster.h"
+#include "Prof.h"
 
 
 /* define CPU frequency in hz here if not defined in Makefile */
@@ -17,8 +19,49 @@
 #define F_CPU 1600000UL
 #endif
 
-/* I2C clock in Hz */
-//#define SCL_CLOCK  100000L
+#include <util/delay.h>
+
+/* I2C clock in Hz for devices that have not registered a clock of their own */
+#define SCL_CLOCK  30000L
+
+/* TWBR must be 10 or higher for stable operation in master mode */
+#define TWBR_MIN   10
+
+/* Clock profiles registered by the device drivers, see i2c_register_device() */
+#define I2C_MAX_DEVICES 4
+
+static struct
+{
+  unsigned char addr;
+  unsigned char twbr;
+  unsigned char twps;
+} i2c_dev[I2C_MAX_DEVICES];
+
+static unsigned char i2c_ndev = 0;
+static unsigned char def_twbr, def_twps;    // bus default, set by i2c_init()
+
+/* Upper bound for polling TWINT/TWSTO, about 2ms -- one pass of the wait loop takes ~8 cycles.
+   At the slowest clock a byte takes ~300us, so this only expires if a device holds the bus */
+#define I2C_POLL_LOOPS  ((uint16_t)(F_CPU / 4000UL))
+
+/* Same bound for waiting on a queued transaction, I2C_TXN_TIMEOUT ms */
+#define I2C_TXN_LOOPS   (F_CPU / 8000UL * I2C_TXN_TIMEOUT)
+
+/* Pins used by the TWI hardware on the ATmega328P, needed for bus recovery */
+#define I2C_DDR   DDRC
+#define I2C_PORT  PORTC
+#define I2C_PIN   PINC
+#define I2C_SDA   (1 << PC4)
+#define I2C_SCL   (1 << PC5)
+#define I2C_HALF_BIT_US 5     // bit banged recovery runs at ~100Khz
+
+/* TWCR value to continue the transfer with the TWI interrupt enabled */
+#define TWCR_GO   ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+
+/* Transaction queue of the interrupt driven engine -- txn_head is the one on the wire */
+static i2c_txn_t * volatile txn_head = 0;
+static i2c_txn_t *txn_tail;
+static unsigned char txn_pos;     // byte index within the current write or read phase
 
 
 /*************************************************************************
@@ -28,30 +71,172 @@
 // TODO: Add check to see that the BUS is aavailable and Idle,
 void i2c_init(void)
 {
-  /* initialize TWI clock, TWPS = 0 => prescaler = 1 */
-
-  TWSR = 0;                         /* no prescaler */
-  //TWBR = ((F_CPU / SCL_CLOCK) - 16) / 2; /* must be > 10 for stable operation */
-  // Run slow
-  TWBR = 0xff;  // this is about 30Khz
+  i2c_set_clock( SCL_CLOCK );
 
 }/* i2c_init */
 
 
+/*************************************************************************
+ Computes the TWBR and TWPS settings for the fastest SCL clock that does not
+ exceed scl_hz.   SCL = F_CPU / (16 + 2 * TWBR * 4^TWPS)
+
+ Return:  the resulting SCL frequency in Hz
+*************************************************************************/
+unsigned long i2c_clock_calc( unsigned long scl_hz, unsigned char *twbr, unsigned char *twps )
+{
+  unsigned long div;
+  unsigned long br;
+  uint8_t ps;
+
+  if ( scl_hz == 0 )      // as fast as it goes, TWBR_MIN below limits it to the fastest stable setting
+    scl_hz = F_CPU;
+
+  div = (F_CPU + scl_hz - 1) / scl_hz;        // round up so the clock is never faster than asked for
+  div = div > 16 ? div - 16 : 0;
+
+  for ( ps = 0; ps < 4; ps++ )
+  {
+    br = (div + (2UL << (2 * ps)) - 1) >> (1 + 2 * ps);   // div / (2 * 4^ps), rounded up
+    if ( br <= 0xff )
+      break;
+  }
+
+  if ( ps == 4 )          // slower than the hardware can go, use the slowest setting
+  {
+    ps = 3;
+    br = 0xff;
+  }
+
+  if ( br < TWBR_MIN )
+    br = TWBR_MIN;
+
+  *twbr = br;
+  *twps = ps;
+
+  return F_CPU / (16 + (br << (1 + 2 * ps)));
+
+}/* i2c_clock_calc */
+
+
+/*************************************************************************
+ Sets the bus clock used for devices without a registered clock profile
+*************************************************************************/
+void i2c_set_clock( unsigned long scl_hz )
+{
+  i2c_clock_calc( scl_hz, &def_twbr, &def_twps );
+
+  TWSR = def_twps;
+  TWBR = def_twbr;
+
+}/* i2c_set_clock */
+
+
+/*************************************************************************
+ Registers the highest SCL clock a device supports. Transfers to this device
+ are clocked at that speed from then on, independent of the other devices.
+
+ Return:  0 = registered, 1 = device table full, the device will use the bus default
+*************************************************************************/
+unsigned char i2c_register_device( unsigned char addr, unsigned long max_scl_hz )
+{
+  uint8_t i;
+
+  addr &= ~I2C_READ;
+
+  for ( i = 0; i < i2c_ndev; i++ )    // re-registration replaces the old profile
+    if ( i2c_dev[i].addr == addr )
+      break;
+
+  if ( i == I2C_MAX_DEVICES )
+    return 1;
+
+  i2c_clock_calc( max_scl_hz, &i2c_dev[i].twbr, &i2c_dev[i].twps );
+  i2c_dev[i].addr = addr;
+
+  if ( i == i2c_ndev )
+    i2c_ndev++;
+
+  return 0;
+
+}/* i2c_register_device */
+
+
+/*************************************************************************
+ Switches the bus clock to the profile of the addressed device.
+ Only called while the bus is idle, i.e. right before a START.
+*************************************************************************/
+static void twi_clock_for( unsigned char addr )
+{
+  uint8_t i;
+
+  addr &= ~I2C_READ;
+
+  for ( i = 0; i < i2c_ndev; i++ )
+    if ( i2c_dev[i].addr == addr )
+    {
+      TWSR = i2c_dev[i].twps;
+      TWBR = i2c_dev[i].twbr;
+      return;
+    }
+
+  TWSR = def_twps;
+  TWBR = def_twbr;
+
+}/* twi_clock_for */
+
+
+/*************************************************************************
+ Waits for the TWI hardware to finish the current bus event
+ Return:  0 = done, 1 = timed out
+*************************************************************************/
+static unsigned char twi_wait_int(void)
+{
+  uint16_t n = I2C_POLL_LOOPS;
+
+  while (!(TWCR & (1 << TWINT)))
+    if ( --n == 0 )
+      return 1;
+
+  return 0;
+
+}/* twi_wait_int */
+
+
+/*************************************************************************
+ Waits for a STOP condition to be executed
+ Return:  0 = done, 1 = timed out
+*************************************************************************/
+static unsigned char twi_wait_stop(void)
+{
+  uint16_t n = I2C_POLL_LOOPS;
+
+  while (TWCR & (1 << TWSTO))
+    if ( --n == 0 )
+      return 1;
+
+  return 0;
+
+}/* twi_wait_stop */
+
+
 /*************************************************************************
   Issues a start condition and sends address and transfer direction.
-  return 0 = device accessible, 1= failed to access device
+  return 0 = device accessible, 1= failed to access device,
+         2 = no start condition, I2C_ERR_TIMEOUT = bus held by a device
 *************************************************************************/
 unsigned char i2c_start(unsigned char address)
 {
   uint8_t   twst;
 
+  i2c_wait_idle();    // let the interrupt driven engine finish with the bus first
+  twi_clock_for( address );
+
   // send START condition
   TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
 
   // wait until transmission completed
-  while (!(TWCR & (1 << TWINT)))
-    ;
+  if ( twi_wait_int() )
+    return I2C_ERR_TIMEOUT;
 
   // check value of TWI Status Register. Mask prescaler bits.
   twst = TW_STATUS & 0xF8;
@@ -64,8 +249,8 @@ unsigned char i2c_start(unsigned char address)
   TWCR = (1 << TWINT) | (1 << TWEN);
 
   // wail until transmission completed and ACK/NACK has been received
-  while (!(TWCR & (1 << TWINT)))
-    ;
+  if ( twi_wait_int() )
+    return I2C_ERR_TIMEOUT;
 
   // check value of TWI Status Register. Mask prescaler bits.
   twst = TW_STATUS & 0xF8;
@@ -83,20 +268,26 @@ unsigned char i2c_start(unsigned char address)
  If device is busy, use ack polling to wait until device is ready
 
  Input:   address and transfer direction of I2C device
+ Return:  0 device accessible
+          I2C_ERR_TIMEOUT device still busy after I2C_START_WAIT_TRIES attempts
+          or bus held by a device
 *************************************************************************/
-void i2c_start_wait(unsigned char address)
+unsigned char i2c_start_wait(unsigned char address)
 {
   uint8_t   twst;
+  uint8_t   tries = I2C_START_WAIT_TRIES;
 
+  i2c_wait_idle();
+  twi_clock_for( address );
 
-  while ( 1 )
+  while ( tries-- )
   {
     // send START condition
     TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
 
     // wait until transmission completed
-    while (!(TWCR & (1 << TWINT)))
-      ;
+    if ( twi_wait_int() )
+      return I2C_ERR_TIMEOUT;
 
     // check value of TWI Status Register. Mask prescaler bits.
     twst = TW_STATUS & 0xF8;
@@ -108,8 +299,8 @@ void i2c_start_wait(unsigned char address)
     TWCR = (1 << TWINT) | (1 << TWEN);
 
     // wail until transmission completed
-    while (!(TWCR & (1 << TWINT)))
-      ;
+    if ( twi_wait_int() )
+      return I2C_ERR_TIMEOUT;
 
     // check value of TWI Status Register. Mask prescaler bits.
     twst = TW_STATUS & 0xF8;
@@ -119,15 +310,17 @@ void i2c_start_wait(unsigned char address)
       TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
 
       // wait until stop condition is executed and bus released
-      while (TWCR & (1 << TWSTO))
-        ;
+      if ( twi_wait_stop() )
+        return I2C_ERR_TIMEOUT;
 
       continue;
     }
     //if( twst != TW_MT_SLA_ACK) return 1;
-    break;
+    return 0;
   }
 
+  return I2C_ERR_TIMEOUT;
+
 }/* i2c_start_wait */
 
 
@@ -148,15 +341,19 @@ unsigned char i2c_rep_start(unsigned char address)
 
 /*************************************************************************
  Terminates the data transfer and releases the I2C bus
+ Return:  0 bus released
+          I2C_ERR_TIMEOUT stop condition could not be executed
 *************************************************************************/
-void i2c_stop(void)
+unsigned char i2c_stop(void)
 {
   /* send stop condition */
   TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
 
   // wait until stop condition is executed and bus released
-  while (TWCR & (1 << TWSTO))
-    ;
+  if ( twi_wait_stop() )
+    return I2C_ERR_TIMEOUT;
+
+  return 0;
 
 }/* i2c_stop */
 
@@ -167,6 +364,7 @@ void i2c_stop(void)
   Input:    byte to be transfered
   Return:   0 write successful
             1 write failed
+            I2C_ERR_TIMEOUT bus held by a device
 *************************************************************************/
 unsigned char i2c_write( unsigned char data )
 {
@@ -177,8 +375,8 @@ unsigned char i2c_write( unsigned char data )
   TWCR = (1 << TWINT) | (1 << TWEN);
 
   // wait until transmission completed
-  while (!(TWCR & (1 << TWINT)))
-    ;
+  if ( twi_wait_int() )
+    return I2C_ERR_TIMEOUT;
 
   // check value of TWI Status Register. Mask prescaler bits
   twst = TW_STATUS & 0xF8;
@@ -200,8 +398,8 @@ unsigned char i2c_readAck(void)
 {
   TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWEA);
   
-  while (!(TWCR & (1 << TWINT)))
-    ;
+  if ( twi_wait_int() )
+    return 0xff;      // bus held by a device, the following i2c_stop() reports the timeout
 
   return TWDR;
 
@@ -217,10 +415,296 @@ unsigned char i2c_readNak(void)
 {
   TWCR = (1 << TWINT) | (1 << TWEN);
   
-  while (!(TWCR & (1 << TWINT)))
-    ;
+  if ( twi_wait_int() )
+    return 0xff;      // bus held by a device, the following i2c_stop() reports the timeout
 
   return TWDR;
 
 }/* i2c_readNak */
 
+
+
+/*************************************************************************
+ Completes the transaction on the wire and chains the next queued one.
+ Called from the TWI interrupt only.
+*************************************************************************/
+static void txn_finish( unsigned char status )
+{
+  i2c_txn_t *t = txn_head;
+
+  txn_head = t->next;
+
+  if ( txn_head )
+  {
+    twi_clock_for( txn_head->addr );
+    TWCR = TWCR_GO | (1 << TWSTO) | (1 << TWSTA);   // STOP followed by START for the next transaction
+  }
+  else
+    TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO); // release the bus, engine goes idle
+
+  t->status = status;
+  if ( t->done )
+    t->done( t );
+
+}/* txn_finish */
+
+
+/*************************************************************************
+ TWI interrupt -- advances the transaction on the wire by one bus event
+*************************************************************************/
+ISR(TWI_vect)
+{
+  i2c_txn_t *t = txn_head;
+  PROF_BEGIN( PROF_ISR_TWI );
+
+  switch ( TW_STATUS & 0xF8 )
+  {
+    case TW_START:          // address the device, write phase first if there is one, a probe writes nothing
+      txn_pos = 0;
+      TWDR = (t->wlen || !t->rlen) ? (t->addr & ~I2C_READ) : (t->addr | I2C_READ);
+      TWCR = TWCR_GO;
+      break;
+
+    case TW_REP_START:      // write phase is done, address the device for reading
+      txn_pos = 0;
+      TWDR = t->addr | I2C_READ;
+      TWCR = TWCR_GO;
+      break;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+      if ( txn_pos < t->wlen )
+      {
+        TWDR = t->wbuf[txn_pos++];
+        TWCR = TWCR_GO;
+      }
+      else if ( t->rlen )
+        TWCR = TWCR_GO | (1 << TWSTA);    // repeated start to switch to reading
+      else
+        txn_finish( I2C_OK );
+      break;
+
+    case TW_MR_DATA_ACK:
+      t->rbuf[txn_pos++] = TWDR;
+      // fall through
+    case TW_MR_SLA_ACK:
+      if ( txn_pos + 1 < t->rlen )
+        TWCR = TWCR_GO | (1 << TWEA);     // more bytes to come, ACK the next one
+      else
+        TWCR = TWCR_GO;                   // NACK the last byte
+      break;
+
+    case TW_MR_DATA_NACK:   // the last byte
+      t->rbuf[txn_pos] = TWDR;
+      txn_finish( I2C_OK );
+      break;
+
+    case TW_MT_SLA_NACK:
+    case TW_MR_SLA_NACK:
+      txn_finish( I2C_ERR_ADDR );
+      break;
+
+    case TW_MT_DATA_NACK:
+      txn_finish( I2C_ERR_DATA );
+      break;
+
+    default:                // arbitration lost or bus error
+      txn_finish( I2C_ERR_START );
+      break;
+  }
+  PROF_END( PROF_ISR_TWI );
+
+}/* ISR(TWI_vect) */
+
+
+/*************************************************************************
+ Queues a transaction and starts the engine if it is idle.
+ Returns without waiting for the bus.
+*************************************************************************/
+void i2c_submit( i2c_txn_t *t )
+{
+  uint8_t sreg;
+
+  if ( t->status == I2C_BUSY )    // still queued or on the wire
+    return;
+
+  t->status = I2C_BUSY;
+  t->next = 0;
+
+  sreg = SREG;
+  cli();
+
+  if ( txn_head )                 // engine is running, it will pick this one up when its turn comes
+  {
+    txn_tail->next = t;
+    txn_tail = t;
+    SREG = sreg;
+    return;
+  }
+
+  txn_head = txn_tail = t;
+  SREG = sreg;
+
+  // wait for a STOP from a previous transfer to go out, then send START
+  twi_wait_stop();
+  twi_clock_for( t->addr );
+  TWCR = TWCR_GO | (1 << TWSTA);
+
+}/* i2c_submit */
+
+
+/*************************************************************************
+ Queues a transaction and waits up to I2C_TXN_TIMEOUT for it to complete
+
+ Return:  I2C_OK or one of the I2C_ERR_ codes
+*************************************************************************/
+unsigned char i2c_transfer( i2c_txn_t *t )
+{
+  uint32_t n = I2C_TXN_LOOPS;
+
+  i2c_submit( t );
+
+  while ( t->status == I2C_BUSY )
+    if ( --n == 0 )
+    {
+      i2c_abort();
+      break;
+    }
+
+  return t->status;
+
+}/* i2c_transfer */
+
+
+/*************************************************************************
+ Sets up a transaction that sends a register address, then reads len bytes
+*************************************************************************/
+void i2c_txn_read( i2c_txn_t *t, unsigned char reg, unsigned char *buf, unsigned char len )
+{
+  t->cmd[0] = reg;
+  t->wbuf = t->cmd;
+  t->wlen = 1;
+  t->rbuf = buf;
+  t->rlen = len;
+
+}/* i2c_txn_read */
+
+
+/*************************************************************************
+ Sets up a transaction that writes one register
+*************************************************************************/
+void i2c_txn_write( i2c_txn_t *t, unsigned char reg, unsigned char val )
+{
+  t->cmd[0] = reg;
+  t->cmd[1] = val;
+  t->wbuf = t->cmd;
+  t->wlen = 2;
+  t->rlen = 0;
+
+}/* i2c_txn_write */
+
+
+/*************************************************************************
+ Reads len registers starting at reg in one burst and waits for the result
+
+ Return:  I2C_OK or one of the I2C_ERR_ codes
+*************************************************************************/
+unsigned char i2c_read_block( unsigned char addr, unsigned char reg, unsigned char *buf, unsigned char len )
+{
+  i2c_txn_t t;
+
+  t.addr = addr;
+  t.status = I2C_OK;
+  t.done = 0;
+  i2c_txn_read( &t, reg, buf, len );
+
+  return i2c_transfer( &t );
+
+}/* i2c_read_block */
+
+
+/*************************************************************************
+ Waits until the transaction queue is empty and the bus has been released.
+ Gives up on the queue with i2c_abort() after I2C_TXN_TIMEOUT.
+*************************************************************************/
+void i2c_wait_idle( void )
+{
+  uint32_t n = I2C_TXN_LOOPS;
+
+  while ( txn_head )
+    if ( --n == 0 )
+    {
+      i2c_abort();
+      return;
+    }
+
+  twi_wait_stop();
+
+}/* i2c_wait_idle */
+
+
+/*************************************************************************
+ Abandons all queued transactions, marking them I2C_ERR_TIMEOUT, and
+ recovers the bus. Used when a transaction did not complete in time.
+*************************************************************************/
+void i2c_abort( void )
+{
+  i2c_txn_t *t;
+  uint8_t sreg = SREG;
+
+  cli();
+  TWCR = 0;                       // stop the TWI hardware and its interrupt
+
+  t = txn_head;
+  txn_head = 0;
+  SREG = sreg;
+
+  for ( ; t; t = t->next )
+    t->status = I2C_ERR_TIMEOUT;
+
+  i2c_recover();
+
+}/* i2c_abort */
+
+
+/*************************************************************************
+ Frees a bus where a device is holding SDA low, i.e. after a reset in the
+ middle of a read: clocks out 9 SCL pulses by hand, issues a STOP and
+ re-initializes the TWI hardware. Does nothing while the engine has
+ transactions queued, txn_finish() has started the next one already and
+ the bus is evidently moving. If it is stuck after all that transaction
+ times out and i2c_abort() empties the queue before it recovers.
+*************************************************************************/
+void i2c_recover( void )
+{
+  uint8_t i;
+
+  if ( txn_head )
+    return;
+
+  TWCR = 0;                       // release the pins from the TWI hardware
+
+  // open drain: port bits low, a pin is driven low by making it an output
+  I2C_PORT &= ~(I2C_SDA | I2C_SCL);
+  I2C_DDR &= ~(I2C_SDA | I2C_SCL);
+
+  for ( i = 0; i < 9; i++ )       // lets a slave finish the byte it is sending
+  {
+    I2C_DDR |= I2C_SCL;
+    _delay_us( I2C_HALF_BIT_US );
+    I2C_DDR &= ~I2C_SCL;
+    _delay_us( I2C_HALF_BIT_US );
+  }
+
+  // STOP condition: SDA rising while SCL is high
+  I2C_DDR |= I2C_SCL;
+  I2C_DDR |= I2C_SDA;
+  _delay_us( I2C_HALF_BIT_US );
+  I2C_DDR &= ~I2C_SCL;
+  _delay_us( I2C_HALF_BIT_US );
+  I2C_DDR &= ~I2C_SDA;
+  _delay_us( I2C_HALF_BIT_US );
+
+  i2c_init();
+
+}/* i2c_recover */